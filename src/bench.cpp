@@ -0,0 +1,1357 @@
+// bench.cpp – pipeline benchmarks on a local audio fixture: speed, resources and accuracy
+// Build: g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// Usage:   ./bench scale <audio-file> <path-to-whisper-model> [--workers 1,2,4] [--threads 0]
+//                  [--chunk-len 600] [--repeat N] [--csv PATH] [--profile PATH] [--backend mock[:RTF]]
+//                  [--reference TEXT_FILE] [--max-wer RATE] [--pack-speech 0,1] [--adaptive-ctx 0,1]
+//                  [--jobs 1,4]
+//          ./bench eval <hypothesis> <reference> | --list PAIRS.tsv [--workers N]
+//          ./bench gate <audio-file> <path-to-whisper-model> --baseline PATH [--write-baseline]
+//                  [--trials 5] [--warmup 1] [--tolerance 0.10 | --tolerance NAME=RATE,…]
+//                  [--workers N] [--threads N] [--chunk-len SEC] [--backend mock[:RTF]]
+//          ./bench soak <path-to-whisper-model> [--hours 10] [--backend mock[:RTF]] [--workers N] [--threads N]
+//                  [--chunk-len 600] [--fixture PATH] [--output PATH] [--csv PATH] [--sample-sec 2]
+//                  [--max-rss-growth-mb 64] [--max-slowdown 0.2] [--max-disk-mb 256]
+//          ./bench selftest [--testdata DIR]
+// scale: one run per (workers, threads, chunk length) point, each in its own
+//        process so peak RSS and CPU time are that point's alone. Writes CSV
+//        (stdout or --csv) and the fastest point as a host profile (--profile),
+//        which transcribe / transcribe-mp4 read with --profile PATH.
+// --backend mock[:RTF] stands in for whisper-cli (see MockBackend in pipeline.h): with mock:0 the
+//        makespan is pure orchestration – splitting, decoding, WAV I/O, parsing and scheduling.
+// --reference scores each point's transcript (WER and CER columns); with --max-wer the best
+//        point is the fastest one within that word error rate.
+// --pack-speech 0,1 runs each point without and with VAD speech packing (speech_pack.h); the
+//        encoder_windows column counts the 30 s windows whisper encodes, encoder_util the speech
+//        share of them (packed runs only – unpacked audio has no VAD pass).
+// --adaptive-ctx 0,1 runs each point with the full 1500-position encoder context and with one
+//        sized to each input (whisper-cli -ac, see adaptive_audio_ctx in pipeline.h); ctx_share is
+//        the encoder positions computed over those a full context would have computed. Pair it
+//        with --reference to see what the smaller context costs in WER.
+// --jobs N runs N copies of the fixture at once as separate jobs, like transcribe --daemon --jobs N
+//        (throughput counts all copies), to find how many jobs the host takes before they slow
+//        each other down.
+// eval: WER and CER of a hypothesis against a reference (transcript output or plain text). With
+//        --list, one "<hypothesis>\t<reference>" pair of paths per line; prints each pair and the
+//        corpus totals (edits summed over reference tokens summed).
+// gate: runs one configuration --trials times and compares the medians of throughput, makespan,
+//        per-stage mean latency and peak RSS with --baseline. A metric regresses when it is worse
+//        by more than its tolerance and by more than 3× the combined trial noise (MAD of baseline
+//        and run); any regression exits 1. --write-baseline records the run as the new baseline,
+//        tolerances included – per-metric tolerances in the committed file may be edited by hand.
+// soak: generates --hours (at most ~37 h, the 32-bit RIFF size limit) of deterministic speech-like
+//        16 kHz WAV (kept at --fixture if given, and reused when it is already there), transcribes
+//        it end to end and streams the transcript to --output in order. Samples RSS, temporary
+//        disk use and progress every --sample-sec (CSV with --csv) and exits 1 if median RSS over
+//        the last quarter of the audio is more than --max-rss-growth-mb above that of the early
+//        run, if late throughput falls more than --max-slowdown below early throughput, or if
+//        temporary files ever exceed --max-disk-mb.
+// selftest: checks the hand-rolled pieces against plain references on inputs built in memory –
+//        bit-parallel edit distance against DP (reference lengths around the 64-token block edge),
+//        plan_chunks bounds and MP3 preroll, WebM Xiph/fixed/EBML lacing, every SIMD path the host
+//        runs against scalar (float kernels to rounding, edit distance bit for bit) – and the MP3
+//        decoder on the committed fixtures in --testdata DIR (default: testdata/ next to this
+//        file): short LAME encodes at MPEG-1 44.1 kHz stereo, MPEG-2 22.05 kHz stereo and
+//        MPEG-2.5 8 kHz mono (M/S stereo, a click for short blocks), each with the 16-bit PCM
+//        libavcodec decodes from it. Exits 1 on any mismatch.
+// --simd scalar|sse4|avx2|avx512|neon (any subcommand) forces the DSP kernel path, to compare paths
+//        on one host; the path in use is printed to stderr before the run.
+// --pcm-storage s16|f16 (any subcommand) sets the sample format of pooled decoded audio.
+// Example: ./bench scale fixture.mp3 ./whisper.cpp/models/ggml-tiny.en.bin --workers 1,2,4 --threads 1,2,4
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DR_WAV_IMPLEMENTATION
+#include "pipeline.h"
+#include "wer.h"
+
+namespace fs = std::filesystem;
+
+static bool read_text(const std::string &path, std::string &text)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    text = ss.str();
+    return true;
+}
+
+/* "1,2,4" → {1, 2, 4} */
+static std::vector<double> parse_list(const std::string &text, double def)
+{
+    std::vector<double> out;
+    std::stringstream in(text);
+    for (std::string item; std::getline(in, item, ',');)
+        if (!item.empty())
+            out.push_back(std::atof(item.c_str()));
+    if (out.empty())
+        out.push_back(def);
+    return out;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Scaling curve – makespan, throughput, CPU and memory over a grid
+  of worker counts, whisper threads and chunk lengths
+──────────────────────────────────────────────────────────────*/
+struct ScalePoint
+{
+    std::size_t workers = 1;
+    int threads = 0; // whisper-cli -t; 0 = its default
+    int chunk_len = 600;
+    bool pack_speech = false;
+    bool adaptive_ctx = false;
+    std::size_t jobs = 1; // concurrent copies of the fixture, each its own job
+};
+
+struct ScaleResult
+{
+    std::size_t chunks = 0, gaps = 0;
+    double audio_sec = 0.0, makespan_sec = 0.0, cpu_sec = 0.0, peak_rss_mb = 0.0;
+    double wer = -1.0, cer = -1.0; // < 0: no reference
+    std::size_t encoder_windows = 0; // 30 s windows whisper had to encode
+    double encoder_util = -1.0;      // speech share of those windows; < 0: not measured (no VAD without packing)
+    double encoder_ctx_share = 1.0;  // encoder positions computed over a full 1500-position context
+    double stage_mean_us[std::size_t(Stage::Count)] = {}; // per chunk; inference per audio second
+
+    double throughput() const { return makespan_sec > 0.0 ? audio_sec / makespan_sec : 0.0; }
+};
+
+/* Runs in a forked child: rusage then covers this point and its whisper-cli runs only. */
+static ScaleResult run_scale_point(const std::string &audio_file, const WhisperOptions &base, const ScalePoint &p,
+                                   const std::string &reference)
+{
+    ScaleResult r;
+    const auto t0 = std::chrono::steady_clock::now();
+    const auto chunks = split_audio(audio_file, p.chunk_len);
+    WhisperOptions opts = base;
+    opts.threads = p.threads;
+    opts.pack_speech = p.pack_speech;
+    opts.adaptive_ctx = p.adaptive_ctx;
+    const RetryPolicy policy;
+    std::atomic<std::size_t> gaps{0};
+    std::vector<std::vector<std::string>> lines(chunks.size()); // the first job's, for WER
+
+    /* Each job on its own thread with its own workers, as the daemon's runners do */
+    const auto run_job = [&](std::size_t job) {
+        run_workers(p.workers, chunks.size(), [&](std::size_t, std::size_t i) {
+            char wav[80];
+            std::snprintf(wav, sizeof(wav), "bench_%d_%zu_%03zu.wav", int(getpid()), job, chunks[i].index);
+            std::vector<std::string> out;
+            if (!transcribe_chunk_robust(chunks[i], wav, opts, policy, out))
+                ++gaps;
+            if (job == 0)
+                lines[i] = std::move(out);
+        });
+    };
+    std::vector<std::thread> jobs;
+    for (std::size_t j = 1; j < p.jobs; ++j)
+        jobs.emplace_back(run_job, j);
+    run_job(0);
+    for (auto &t : jobs)
+        t.join();
+    for (const auto &c : chunks)
+        release_chunk_source(c);
+
+    r.makespan_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    r.chunks = chunks.size() * p.jobs;
+    r.gaps = gaps;
+    for (const auto &c : chunks)
+    {
+        r.audio_sec += c.duration() * double(p.jobs);
+        r.encoder_windows += std::size_t(std::ceil(c.duration() / PackStats::kWindowSec - 1e-9)) * p.jobs;
+    }
+    if (p.pack_speech)
+    {
+        const PackStats &ps = pack_stats();
+        r.encoder_windows = ps.windows.load();
+        r.encoder_util = r.encoder_windows ? double(ps.speech_ms.load()) / 1000.0 /
+                                                 (double(r.encoder_windows) * PackStats::kWindowSec)
+                                           : 0.0;
+    }
+    r.encoder_ctx_share = encoder_ctx_share();
+    r.cpu_sec = cpu_seconds();
+    r.peak_rss_mb = double(std::max(sample_rss().peak_kb, children_peak_rss_kb())) / 1024.0;
+    for (Stage s : {Stage::Segmentation, Stage::Decode, Stage::Inference})
+        r.stage_mean_us[std::size_t(s)] = stage_histogram(s).summary().mean;
+
+    if (!reference.empty())
+    {
+        std::string hypothesis;
+        for (const auto &chunk : lines)
+            for (const auto &line : chunk)
+                hypothesis += line + '\n';
+        r.wer = word_error_rate(hypothesis, reference).rate();
+        r.cer = char_error_rate(hypothesis, reference).rate();
+    }
+    return r;
+}
+
+/* Fork, run the point with stdout silenced, read the result back over a pipe. */
+static bool measure_scale_point(const std::string &audio_file, const WhisperOptions &base, const ScalePoint &p,
+                                const std::string &reference, ScaleResult &r)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return false;
+    const pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0)
+    {
+        close(fds[0]);
+        if (FILE *null = std::fopen("/dev/null", "w"))
+            dup2(fileno(null), STDOUT_FILENO);
+        int status = 1;
+        try
+        {
+            const ScaleResult res = run_scale_point(audio_file, base, p, reference);
+            status = write(fds[1], &res, sizeof(res)) == ssize_t(sizeof(res)) ? 0 : 1;
+        }
+        catch (const JobError &e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+        ::_exit(status);
+    }
+    close(fds[1]);
+    const bool got = read(fds[0], &r, sizeof(r)) == ssize_t(sizeof(r));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return got && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static int bench_scale(const CliArgs &args)
+{
+    if (args.positional.size() < 3)
+    {
+        std::cerr << "Usage: bench scale <audio-file> <path-to-whisper-model> [--workers 1,2,4] [--threads 0]"
+                     " [--chunk-len 600] [--repeat N] [--csv PATH] [--profile PATH] [--backend mock[:RTF]]"
+                     " [--reference TEXT_FILE] [--max-wer RATE] [--pack-speech 0,1]"
+                     " [--adaptive-ctx 0,1] [--jobs 1,4]" << std::endl;
+        return 1;
+    }
+    const std::string audio_file = args.positional[1];
+    const std::string model = args.positional[2];
+    const auto repeat = static_cast<std::size_t>(std::max(1.0, args.num("--repeat", 1)));
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    WhisperOptions base;
+    base.model = model;
+    std::string backend_error;
+    base.backend = make_inference_backend(args.get("--backend"), backend_error);
+    if (!base.backend)
+    {
+        std::cerr << backend_error << std::endl;
+        return 1;
+    }
+    std::string reference;
+    if (args.has("--reference") && !read_text(args.get("--reference"), reference))
+    {
+        std::cerr << "Could not read " << args.get("--reference") << std::endl;
+        return 1;
+    }
+    const double max_wer = args.num("--max-wer", -1.0);
+
+    std::ofstream csv_file;
+    if (args.has("--csv"))
+        csv_file.open(args.get("--csv"));
+    std::ostream &csv = args.has("--csv") ? csv_file : std::cout;
+    csv << "backend,workers,threads,chunk_len_sec,chunks,gaps,audio_sec,makespan_sec,throughput_x,cpu_sec,"
+           "cpu_util,peak_rss_mb,wer,cer,pack_speech,encoder_windows,encoder_util,adaptive_ctx,ctx_share,jobs\n";
+
+    ScalePoint best;
+    ScaleResult best_r;
+    /* Every combination of the listed values, workers varying fastest */
+    std::vector<ScalePoint> grid;
+    for (double jobs : parse_list(args.get("--jobs"), 1))
+        for (double pack : parse_list(args.get("--pack-speech"), 0))
+            for (double adaptive : parse_list(args.get("--adaptive-ctx"), 0))
+                for (double chunk_len : parse_list(args.get("--chunk-len"), 600))
+                    for (double threads : parse_list(args.get("--threads"), 0))
+                        for (double workers : parse_list(args.get("--workers"), 1))
+                        {
+                            ScalePoint p;
+                            p.workers = std::max<std::size_t>(1, std::size_t(workers));
+                            p.threads = int(threads);
+                            p.chunk_len = std::max(1, int(chunk_len));
+                            p.pack_speech = pack != 0.0;
+                            p.adaptive_ctx = adaptive != 0.0;
+                            p.jobs = std::max<std::size_t>(1, std::size_t(jobs));
+                            grid.push_back(p);
+                        }
+
+    for (const ScalePoint &p : grid)
+    {
+        /* Median makespan over the trials; the other columns come from that trial */
+        std::vector<ScaleResult> trials;
+        for (std::size_t t = 0; t < repeat; ++t)
+        {
+            ScaleResult r;
+            if (measure_scale_point(audio_file, base, p, reference, r))
+                trials.push_back(r);
+        }
+        if (trials.empty())
+        {
+            std::cerr << "workers=" << p.workers << " threads=" << p.threads << " chunk_len=" << p.chunk_len
+                      << ": run failed" << std::endl;
+            continue;
+        }
+        std::sort(trials.begin(), trials.end(),
+                  [](const ScaleResult &a, const ScaleResult &b) { return a.makespan_sec < b.makespan_sec; });
+        const ScaleResult &r = trials[trials.size() / 2];
+
+        char row[384];
+        char wer[32] = ",";
+        if (r.wer >= 0.0)
+            std::snprintf(wer, sizeof(wer), "%.4f,%.4f", r.wer, r.cer);
+        char util[16] = "";
+        if (r.encoder_util >= 0.0)
+            std::snprintf(util, sizeof(util), "%.4f", r.encoder_util);
+        std::snprintf(row, sizeof(row),
+                      "%s,%zu,%d,%d,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%s,%d,%zu,%s,%d,%.4f,%zu\n",
+                      base.backend->name().c_str(), p.workers, p.threads, p.chunk_len, r.chunks, r.gaps,
+                      r.audio_sec, r.makespan_sec, r.throughput(), r.cpu_sec,
+                      r.cpu_sec / (r.makespan_sec * cores), r.peak_rss_mb, wer, int(p.pack_speech),
+                      r.encoder_windows, util, int(p.adaptive_ctx), r.encoder_ctx_share, p.jobs);
+        csv << row << std::flush;
+        std::cerr << row;
+
+        const bool accurate = max_wer < 0.0 || (r.wer >= 0.0 && r.wer <= max_wer);
+        if (!r.gaps && accurate && r.throughput() > best_r.throughput())
+            best = p, best_r = r;
+    }
+
+    if (best_r.throughput() <= 0.0)
+    {
+        std::cerr << (max_wer < 0.0 ? "No point completed without gaps."
+                                    : "No point completed without gaps within --max-wer.") << std::endl;
+        return 1;
+    }
+    std::cerr << "\nBest: --workers " << best.workers << " --threads " << best.threads << " --chunk-len "
+              << best.chunk_len << (best.pack_speech ? " --pack-speech" : "")
+              << (best.adaptive_ctx ? " --adaptive-ctx" : "")
+              << (best.jobs > 1 ? " --jobs " + std::to_string(best.jobs) : std::string()) << " ("
+              << std::fixed << std::setprecision(1)
+              << best_r.throughput() << "x realtime, " << best_r.peak_rss_mb << " MB peak";
+    if (best_r.wer >= 0.0)
+        std::cerr << ", WER " << 100.0 * best_r.wer << "%";
+    std::cerr << ")" << std::endl;
+
+    if (args.has("--profile"))
+    {
+        char host[256] = {};
+        gethostname(host, sizeof(host) - 1);
+        const std::time_t now = std::time(nullptr);
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%d", std::localtime(&now));
+        HostProfile profile;
+        profile.workers = best.workers;
+        profile.threads = best.threads;
+        profile.chunk_len = best.chunk_len;
+        profile.note = std::string("bench scale on ") + host + ", " + date + ", " + fs::path(model).filename().string();
+        if (!save_host_profile(args.get("--profile"), profile))
+        {
+            std::cerr << "Could not write " << args.get("--profile") << std::endl;
+            return 1;
+        }
+        std::cerr << "Host profile written to " << args.get("--profile") << std::endl;
+    }
+    return 0;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Eval – WER / CER of transcripts against references
+──────────────────────────────────────────────────────────────*/
+static int bench_eval(const CliArgs &args)
+{
+    std::vector<std::pair<std::string, std::string>> pairs;
+    if (args.has("--list"))
+    {
+        std::ifstream in(args.get("--list"));
+        if (!in)
+        {
+            std::cerr << "Could not read " << args.get("--list") << std::endl;
+            return 1;
+        }
+        for (std::string line; std::getline(in, line);)
+        {
+            const auto tab = line.find('\t');
+            if (!line.empty() && line[0] != '#' && tab != std::string::npos)
+                pairs.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+        }
+    }
+    else if (args.positional.size() >= 3)
+        pairs.emplace_back(args.positional[1], args.positional[2]);
+    if (pairs.empty())
+    {
+        std::cerr << "Usage: bench eval <hypothesis> <reference> | --list PAIRS.tsv [--workers N]" << std::endl;
+        return 1;
+    }
+
+    struct Scored
+    {
+        bool ok = false;
+        ErrorRate wer, cer;
+    };
+    std::vector<Scored> scored(pairs.size());
+    run_workers(static_cast<std::size_t>(args.num("--workers", std::thread::hardware_concurrency())), pairs.size(),
+                [&](std::size_t, std::size_t i) {
+                    std::string hyp, ref;
+                    if (!read_text(pairs[i].first, hyp) || !read_text(pairs[i].second, ref))
+                        return;
+                    scored[i] = {true, word_error_rate(hyp, ref), char_error_rate(hyp, ref)};
+                });
+
+    ErrorRate wer, cer;
+    std::size_t failed = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (std::size_t i = 0; i < pairs.size(); ++i)
+    {
+        if (!scored[i].ok)
+        {
+            std::cerr << "Could not read " << pairs[i].first << " or " << pairs[i].second << std::endl;
+            ++failed;
+            continue;
+        }
+        wer.add(scored[i].wer);
+        cer.add(scored[i].cer);
+        if (pairs.size() > 1)
+            std::cout << pairs[i].first << "\tWER " << 100.0 * scored[i].wer.rate() << "%\tCER "
+                      << 100.0 * scored[i].cer.rate() << "%\n";
+    }
+    std::cout << "WER " << 100.0 * wer.rate() << "% (" << wer.edits << " edits / " << wer.ref_tokens
+              << " words)\nCER " << 100.0 * cer.rate() << "% (" << cer.edits << " edits / " << cer.ref_tokens
+              << " characters)" << std::endl;
+    return failed ? 1 : 0;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Gate – repeated trials of one configuration against a stored
+  baseline; medians are compared, the spread between trials sets
+  how large a difference counts as real
+──────────────────────────────────────────────────────────────*/
+struct GateMetric
+{
+    std::string name;
+    bool higher_is_better = false;
+    double median = 0.0;
+    double noise = 0.0;     // 1.4826 × MAD / median: a robust relative standard deviation
+    double tolerance = 0.0; // relative change allowed regardless of noise
+};
+
+static GateMetric summarize_metric(const std::string &name, bool higher_is_better, std::vector<double> v)
+{
+    GateMetric m;
+    m.name = name;
+    m.higher_is_better = higher_is_better;
+    std::sort(v.begin(), v.end());
+    m.median = v[v.size() / 2];
+    for (double &x : v)
+        x = std::fabs(x - m.median);
+    std::sort(v.begin(), v.end());
+    m.noise = m.median > 0.0 ? 1.4826 * v[v.size() / 2] / m.median : 0.0;
+    return m;
+}
+
+/* "0.1" applies to every metric; "decode_ms=0.25,throughput_x=0.05" to the ones named */
+static double tolerance_for(const std::string &spec, const std::string &name, double def)
+{
+    std::stringstream in(spec);
+    for (std::string item; std::getline(in, item, ',');)
+    {
+        const auto eq = item.find('=');
+        if (eq == std::string::npos)
+            def = std::atof(item.c_str());
+        else if (item.compare(0, eq, name) == 0)
+            return std::atof(item.c_str() + eq + 1);
+    }
+    return def;
+}
+
+static std::string gate_json(const std::string &config, std::size_t trials, const std::vector<GateMetric> &metrics)
+{
+    std::string out = "{\n  \"config\": " + config + ",\n  \"trials\": " + std::to_string(trials) +
+                      ",\n  \"metrics\": {";
+    for (std::size_t i = 0; i < metrics.size(); ++i)
+    {
+        const GateMetric &m = metrics[i];
+        char buf[256];
+        std::snprintf(buf, sizeof(buf),
+                      "%s\n    \"%s\": {\"median\": %.6g, \"noise\": %.4f, \"tolerance\": %.4f, "
+                      "\"higher_is_better\": %s}",
+                      i ? "," : "", m.name.c_str(), m.median, m.noise, m.tolerance,
+                      m.higher_is_better ? "true" : "false");
+        out += buf;
+    }
+    return out + "\n  }\n}\n";
+}
+
+/* Reads back what gate_json writes: "<name>": {"median": …, "noise": …, "tolerance": …} */
+static bool load_gate_baseline(const std::string &path, std::string &config, std::vector<GateMetric> &metrics)
+{
+    std::string text;
+    if (!read_text(path, text))
+        return false;
+    const auto field = [](const std::string &obj, const char *key, double &v) {
+        const auto at = obj.find(std::string("\"") + key + "\":");
+        if (at == std::string::npos)
+            return false;
+        v = std::atof(obj.c_str() + at + std::strlen(key) + 3);
+        return true;
+    };
+    const auto c0 = text.find("\"config\":");
+    if (c0 != std::string::npos)
+    {
+        const auto open = text.find('{', c0), close = text.find('}', c0);
+        if (open != std::string::npos && close != std::string::npos)
+            config = text.substr(open, close - open + 1);
+    }
+    const auto m0 = text.find("\"metrics\":");
+    if (m0 == std::string::npos)
+        return false;
+    for (std::size_t at = text.find('"', text.find('{', m0)); at != std::string::npos; at = text.find('"', at))
+    {
+        const auto name_end = text.find('"', at + 1);
+        const auto open = text.find('{', name_end), close = text.find('}', name_end);
+        if (name_end == std::string::npos || open == std::string::npos || close == std::string::npos)
+            break;
+        const std::string obj = text.substr(open, close - open + 1);
+        GateMetric m;
+        m.name = text.substr(at + 1, name_end - at - 1);
+        if (!field(obj, "median", m.median))
+            return false;
+        field(obj, "noise", m.noise);
+        field(obj, "tolerance", m.tolerance);
+        m.higher_is_better = obj.find("\"higher_is_better\": true") != std::string::npos;
+        metrics.push_back(m);
+        at = close + 1;
+    }
+    return !metrics.empty();
+}
+
+static int bench_gate(const CliArgs &args)
+{
+    if (args.positional.size() < 3 || !args.has("--baseline"))
+    {
+        std::cerr << "Usage: bench gate <audio-file> <path-to-whisper-model> --baseline PATH [--write-baseline]"
+                     " [--trials 5] [--warmup 1] [--tolerance 0.10 | NAME=RATE,…] [--workers N] [--threads N]"
+                     " [--chunk-len SEC] [--backend mock[:RTF]]" << std::endl;
+        return 1;
+    }
+    const std::string audio_file = args.positional[1];
+    const std::string baseline_path = args.get("--baseline");
+    const auto trials = static_cast<std::size_t>(std::max(1.0, args.num("--trials", 5)));
+    const auto warmup = static_cast<std::size_t>(std::max(0.0, args.num("--warmup", 1)));
+    const std::string tolerance = args.has("--tolerance") ? args.get("--tolerance") : "0.10";
+
+    WhisperOptions base;
+    base.model = args.positional[2];
+    std::string backend_error;
+    base.backend = make_inference_backend(args.get("--backend"), backend_error);
+    if (!base.backend)
+    {
+        std::cerr << backend_error << std::endl;
+        return 1;
+    }
+    ScalePoint p;
+    p.workers = std::max<std::size_t>(1, static_cast<std::size_t>(args.num("--workers", 1)));
+    p.threads = static_cast<int>(args.num("--threads", 0));
+    p.chunk_len = std::max(1, static_cast<int>(args.num("--chunk-len", 600)));
+    const std::string config = "{\"audio\": " + json_string(fs::path(audio_file).filename().string()) +
+                               ", \"model\": " + json_string(fs::path(base.model).filename().string()) +
+                               ", \"backend\": " + json_string(base.backend->name()) +
+                               ", \"workers\": " + std::to_string(p.workers) +
+                               ", \"threads\": " + std::to_string(p.threads) +
+                               ", \"chunk_len\": " + std::to_string(p.chunk_len) + "}";
+
+    /* Warm-up runs fill the page cache and are thrown away */
+    std::vector<ScaleResult> runs;
+    for (std::size_t t = 0; t < warmup + trials; ++t)
+    {
+        ScaleResult r;
+        if (!measure_scale_point(audio_file, base, p, "", r))
+        {
+            std::cerr << "Trial " << t + 1 << " failed" << std::endl;
+            return 1;
+        }
+        if (r.gaps)
+        {
+            std::cerr << "Trial " << t + 1 << " left " << r.gaps << " gap(s); timings would not be comparable"
+                      << std::endl;
+            return 1;
+        }
+        if (t >= warmup)
+            runs.push_back(r);
+    }
+
+    std::vector<GateMetric> metrics;
+    const auto add = [&](const std::string &name, bool higher_is_better,
+                         const std::function<double(const ScaleResult &)> &get) {
+        std::vector<double> v;
+        for (const auto &r : runs)
+            v.push_back(get(r));
+        if (v.front() > 0.0)
+            metrics.push_back(summarize_metric(name, higher_is_better, v));
+    };
+    add("throughput_x", true, [](const ScaleResult &r) { return r.throughput(); });
+    add("makespan_sec", false, [](const ScaleResult &r) { return r.makespan_sec; });
+    add("peak_rss_mb", false, [](const ScaleResult &r) { return r.peak_rss_mb; });
+    for (Stage s : {Stage::Segmentation, Stage::Decode, Stage::Inference})
+        add(std::string(stage_name(s)) + (s == Stage::Inference ? "_ms_per_audio_s" : "_ms"), false,
+            [s](const ScaleResult &r) { return r.stage_mean_us[std::size_t(s)] / 1000.0; });
+    for (auto &m : metrics)
+        m.tolerance = tolerance_for(tolerance, m.name, 0.10);
+
+    if (args.has("--write-baseline"))
+    {
+        std::ofstream out(baseline_path);
+        out << gate_json(config, trials, metrics);
+        if (!out)
+        {
+            std::cerr << "Could not write " << baseline_path << std::endl;
+            return 1;
+        }
+        std::cerr << "Baseline written to " << baseline_path << std::endl;
+        return 0;
+    }
+
+    std::string base_config;
+    std::vector<GateMetric> baseline;
+    if (!load_gate_baseline(baseline_path, base_config, baseline))
+    {
+        std::cerr << "Could not read baseline " << baseline_path << " (create it with --write-baseline)" << std::endl;
+        return 1;
+    }
+    if (!base_config.empty() && base_config != config)
+        std::cerr << "warning: baseline was recorded with " << base_config << ",\n         this run is " << config
+                  << std::endl;
+
+    std::size_t regressions = 0;
+    std::printf("%-28s %12s %12s %9s %9s  %s\n", "metric", "baseline", "run", "change", "allowed", "verdict");
+    for (const GateMetric &b : baseline)
+    {
+        const auto cur = std::find_if(metrics.begin(), metrics.end(),
+                                      [&](const GateMetric &m) { return m.name == b.name; });
+        if (cur == metrics.end() || b.median <= 0.0)
+            continue;
+        /* Positive change = worse, whichever direction that is for the metric */
+        const double change = (b.higher_is_better ? b.median - cur->median : cur->median - b.median) / b.median;
+        const double tol = args.has("--tolerance") ? cur->tolerance : b.tolerance;
+        const double allowed = std::max(tol, 3.0 * std::sqrt(b.noise * b.noise + cur->noise * cur->noise));
+        const bool worse = change > allowed;
+        regressions += worse;
+        std::printf("%-28s %12.4g %12.4g %+8.1f%% %8.1f%%  %s\n", b.name.c_str(), b.median, cur->median,
+                    100.0 * (cur->median - b.median) / b.median, 100.0 * allowed,
+                    worse ? "REGRESSION" : change < -allowed ? "improved" : "ok");
+    }
+    std::fflush(stdout);
+    if (regressions)
+    {
+        std::cerr << regressions << " metric(s) regressed beyond tolerance and noise" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Soak – hours of synthetic audio end to end, watching memory,
+  temporary disk and throughput drift over time
+──────────────────────────────────────────────────────────────*/
+
+/* Speech-like and deterministic: voiced bursts (three harmonics of a random f0
+   under a 4 Hz syllable envelope) separated by pauses on a faint noise floor. */
+static bool write_synthetic_wav(const std::string &path, double seconds, std::uint64_t seed)
+{
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_PCM;
+    format.channels = 1;
+    format.sampleRate = 16000;
+    format.bitsPerSample = 16;
+    drwav wav;
+    if (!drwav_init_file_write(&wav, path.c_str(), &format, nullptr))
+        return false;
+
+    std::uint64_t state = seed;
+    const auto rnd = [&state] {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return double(state >> 11) * (1.0 / 9007199254740992.0);
+    };
+    const std::uint64_t total = std::uint64_t(std::llround(seconds * 16000.0));
+    std::vector<drwav_int16> block(16000);
+    bool voiced = true;
+    std::uint64_t left = 0, in_burst = 0;
+    double f0 = 150.0, phase = 0.0;
+    bool ok = true;
+    for (std::uint64_t n = 0; ok && n < total;)
+    {
+        const std::size_t len = std::size_t(std::min<std::uint64_t>(block.size(), total - n));
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            if (!left)
+            {
+                voiced = !voiced;
+                left = std::uint64_t((voiced ? 0.5 + 3.5 * rnd() : 0.2 + 1.3 * rnd()) * 16000.0);
+                f0 = 100.0 + 150.0 * rnd();
+                in_burst = 0;
+            }
+            --left;
+            double s = (rnd() - 0.5) * 0.004;
+            if (voiced)
+            {
+                phase = std::fmod(phase + 2.0 * M_PI * f0 / 16000.0, 2.0 * M_PI);
+                const double env = 0.5 - 0.5 * std::cos(2.0 * M_PI * 4.0 * double(in_burst++) / 16000.0);
+                s += 0.25 * env * (std::sin(phase) + 0.5 * std::sin(2.0 * phase) + 0.25 * std::sin(3.0 * phase));
+            }
+            block[i] = drwav_int16(std::lround(std::max(-1.0, std::min(1.0, s)) * 32767.0));
+        }
+        ok = drwav_write_pcm_frames(&wav, len, block.data()) == len;
+        n += len;
+    }
+    drwav_uninit(&wav);
+    return ok;
+}
+
+struct SoakSample
+{
+    double t_sec = 0.0, audio_done_sec = 0.0, rss_mb = 0.0, temp_mb = 0.0;
+    std::size_t chunks_done = 0;
+};
+
+static double dir_mb(const fs::path &dir, const std::vector<fs::path> &skip)
+{
+    std::uint64_t bytes = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+        if (std::find(skip.begin(), skip.end(), it->path()) == skip.end())
+            bytes += it->is_regular_file(ec) ? it->file_size(ec) : 0;
+    return double(bytes) / 1048576.0;
+}
+
+static int bench_soak(const CliArgs &args)
+{
+    if (args.positional.size() < 2)
+    {
+        std::cerr << "Usage: bench soak <path-to-whisper-model> [--hours 10] [--backend mock[:RTF]] [--workers N]"
+                     " [--threads N] [--chunk-len 600] [--fixture PATH] [--output PATH] [--csv PATH]"
+                     " [--sample-sec 2] [--max-rss-growth-mb 64] [--max-slowdown 0.2] [--max-disk-mb 256]"
+                  << std::endl;
+        return 1;
+    }
+    const double hours = std::max(0.01, args.num("--hours", 10));
+    /* RIFF chunk sizes are 32-bit: 16 kHz s16 mono fills them after ~37.3 h */
+    const double max_hours = double(0xFFFFFFFFu - 36u) / (16000.0 * 2.0) / 3600.0;
+    if (hours > max_hours)
+    {
+        char limit[32];
+        std::snprintf(limit, sizeof(limit), "%.1f", max_hours);
+        std::cerr << "--hours " << hours << " is more than a WAV fixture can hold (" << limit
+                  << " h at 16 kHz s16)" << std::endl;
+        return 1;
+    }
+    const auto workers = std::max<std::size_t>(1, static_cast<std::size_t>(args.num("--workers", 1)));
+    const int chunk_len = std::max(1, static_cast<int>(args.num("--chunk-len", 600)));
+    const double sample_sec = std::max(0.1, args.num("--sample-sec", 2));
+    const double max_growth_mb = args.num("--max-rss-growth-mb", 64);
+    const double max_slowdown = args.num("--max-slowdown", 0.2);
+    const double max_disk_mb = args.num("--max-disk-mb", 256);
+
+    WhisperOptions opts;
+    opts.model = args.positional[1];
+    opts.threads = static_cast<int>(args.num("--threads", 0));
+    std::string backend_error;
+    opts.backend = make_inference_backend(args.get("--backend"), backend_error);
+    if (!opts.backend)
+    {
+        std::cerr << backend_error << std::endl;
+        return 1;
+    }
+
+    const fs::path work = fs::absolute(".bench-soak-" + std::to_string(getpid()));
+    fs::create_directories(work);
+    const fs::path fixture = args.has("--fixture") ? fs::absolute(args.get("--fixture")) : work / "synthetic.wav";
+    const fs::path output = args.has("--output") ? fs::absolute(args.get("--output")) : work / "transcript.txt";
+    const double seconds = hours * 3600.0;
+    const std::uintmax_t expect_bytes = 44 + std::uintmax_t(std::llround(seconds * 16000.0)) * 2;
+    std::error_code ec;
+    if (fs::file_size(fixture, ec) != expect_bytes)
+    {
+        std::cerr << "Generating " << hours << " h of synthetic audio at " << fixture.string() << std::endl;
+        if (!write_synthetic_wav(fixture.string(), seconds, 0x5EED))
+        {
+            std::cerr << "Could not write " << fixture.string() << std::endl;
+            fs::remove_all(work);
+            return 1;
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto t0 = clock::now();
+    const auto since = [&t0] { return std::chrono::duration<double>(clock::now() - t0).count(); };
+    const auto chunks = split_audio(fixture.string(), chunk_len);
+
+    /* Transcript goes out in chunk order as soon as each prefix is complete */
+    std::mutex m;
+    std::ofstream transcript(output);
+    std::map<std::size_t, std::vector<std::string>> pending;
+    std::size_t next_out = 0, done = 0, gaps = 0;
+    double audio_done = 0.0;
+    std::vector<std::pair<double, double>> finished; // (time, audio seconds) in completion order
+
+    std::vector<SoakSample> samples;
+    std::atomic<bool> running{true};
+    const auto sample = [&] {
+        SoakSample s;
+        s.t_sec = since();
+        s.rss_mb = double(sample_rss().rss_kb) / 1024.0;
+        s.temp_mb = dir_mb(work, {fixture, output});
+        std::lock_guard<std::mutex> g(m);
+        s.chunks_done = done;
+        s.audio_done_sec = audio_done;
+        samples.push_back(s);
+    };
+    std::thread monitor([&] {
+        while (running)
+        {
+            sample();
+            for (int i = 0; running && i < int(sample_sec * 10); ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
+    const RetryPolicy policy;
+    run_workers(workers, chunks.size(), [&](std::size_t, std::size_t i) {
+        const AudioChunk &c = chunks[i];
+        char name[32];
+        std::snprintf(name, sizeof(name), "chunk_%05zu.wav", c.index);
+        std::vector<std::string> lines;
+        const bool ok = transcribe_chunk_robust(c, (work / name).string(), opts, policy, lines);
+
+        /* Chunk-relative timestamps → global, as the tools do */
+        Segment seg;
+        for (auto &line : lines)
+            if (parse_segment_line(line, seg))
+            {
+                seg.t0 += c.global_start();
+                seg.t1 += c.global_start();
+                line = format_segment_line(seg);
+            }
+
+        std::lock_guard<std::mutex> g(m);
+        gaps += !ok;
+        ++done;
+        audio_done += c.duration();
+        finished.emplace_back(since(), c.duration());
+        pending.emplace(i, std::move(lines));
+        for (auto it = pending.find(next_out); it != pending.end(); it = pending.find(++next_out))
+        {
+            for (const auto &line : it->second)
+                transcript << line << '\n';
+            pending.erase(it);
+        }
+    });
+    running = false;
+    monitor.join();
+    sample();
+    transcript.close();
+    const double wall = since();
+
+    if (args.has("--csv"))
+    {
+        std::ofstream csv(args.get("--csv"));
+        csv << "t_sec,chunks_done,audio_done_sec,rss_mb,temp_mb\n";
+        for (const auto &s : samples)
+        {
+            char row[128];
+            std::snprintf(row, sizeof(row), "%.1f,%zu,%.1f,%.1f,%.1f\n", s.t_sec, s.chunks_done, s.audio_done_sec,
+                          s.rss_mb, s.temp_mb);
+            csv << row;
+        }
+    }
+
+    /* Memory: median RSS late in the run against early on, once buffers have warmed up (10–35 %
+       of the audio vs the last 25 %); medians, because chunk buffers come and go between samples */
+    const auto median_rss = [&](double from, double to) {
+        std::vector<double> v;
+        for (const auto &s : samples)
+            if (s.audio_done_sec >= from * audio_done && s.audio_done_sec <= to * audio_done)
+                v.push_back(s.rss_mb);
+        if (v.empty())
+            return samples.back().rss_mb;
+        std::sort(v.begin(), v.end());
+        return v[v.size() / 2];
+    };
+    const double rss_early = median_rss(0.10, 0.35), rss_late = median_rss(0.75, 1.0);
+    double rss_max = 0.0, temp_max = 0.0;
+    for (const auto &s : samples)
+    {
+        rss_max = std::max(rss_max, s.rss_mb);
+        temp_max = std::max(temp_max, s.temp_mb);
+    }
+
+    /* Throughput: tenths of the run by completion order; the first tenth is start-up. Each tenth
+       needs a chunk per worker, or concurrent completions make the rates meaningless. */
+    double early = 0.0, late = 0.0;
+    const std::size_t n = finished.size();
+    const bool enough = n >= 10 * workers;
+    if (enough)
+    {
+        std::vector<double> window;
+        for (std::size_t w = 0; w < 10; ++w)
+        {
+            const std::size_t lo = n * w / 10, hi = n * (w + 1) / 10;
+            const double start = lo ? finished[lo - 1].first : 0.0;
+            double audio = 0.0;
+            for (std::size_t i = lo; i < hi; ++i)
+                audio += finished[i].second;
+            const double span = finished[hi - 1].first - start;
+            window.push_back(span > 0.0 ? audio / span : 0.0);
+        }
+        early = (window[1] + window[2] + window[3]) / 3.0;
+        late = (window[7] + window[8] + window[9]) / 3.0;
+    }
+    const double slowdown = early > 0.0 ? 1.0 - late / early : 0.0;
+
+    std::cerr << std::fixed << std::setprecision(1) << "\nsoak: " << audio_done / 3600.0 << " h of audio, "
+              << chunks.size() << " chunks (" << gaps << " gaps) in " << wall << " s, "
+              << (wall > 0.0 ? audio_done / wall : 0.0) << "x realtime, " << opts.backend->name() << "\n"
+              << "  rss        " << rss_early << " MB early → " << rss_late << " MB late (+" << rss_late - rss_early
+              << " MB, limit " << max_growth_mb << "), " << rss_max << " MB max\n"
+              << "  temp disk  " << temp_max << " MB max (limit " << max_disk_mb << ")\n";
+    if (enough)
+        std::cerr << "  throughput " << early << "x early → " << late << "x late (" << -100.0 * slowdown
+                  << " %, limit -" << 100.0 * max_slowdown << " %)\n";
+    else
+        std::cerr << "  throughput not checked: fewer than 10 chunks per worker\n";
+
+    std::vector<std::string> failures;
+    if (rss_late - rss_early > max_growth_mb)
+        failures.push_back("memory grew while the run progressed");
+    if (temp_max > max_disk_mb)
+        failures.push_back("temporary files exceeded the disk cap");
+    if (enough && slowdown > max_slowdown)
+        failures.push_back("throughput fell over the run");
+    if (gaps)
+        failures.push_back(std::to_string(gaps) + " chunk(s) failed");
+    for (const auto &f : failures)
+        std::cerr << "FAIL: " << f << "\n";
+    if (failures.empty())
+        std::cerr << "PASS" << std::endl;
+
+    fs::remove_all(work, ec); // the fixture and transcript too, unless they were given elsewhere
+    return failures.empty() ? 0 : 1;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Selftest – the hand-rolled parsers and kernels against plain
+  reference implementations, on inputs built in memory
+──────────────────────────────────────────────────────────────*/
+
+/* Textbook O(m·n) Levenshtein, the yardstick for the bit-parallel edit_distance */
+static std::size_t edit_distance_dp(const std::vector<std::uint32_t> &hyp, const std::vector<std::uint32_t> &ref)
+{
+    std::vector<std::size_t> row(ref.size() + 1);
+    for (std::size_t j = 0; j <= ref.size(); ++j)
+        row[j] = j;
+    for (std::size_t i = 1; i <= hyp.size(); ++i)
+    {
+        std::size_t diag = row[0];
+        row[0] = i;
+        for (std::size_t j = 1; j <= ref.size(); ++j)
+        {
+            const std::size_t up = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diag + (hyp[i - 1] == ref[j - 1] ? 0 : 1)});
+            diag = up;
+        }
+    }
+    return row[ref.size()];
+}
+
+/* Reference lengths on and around the 64-token block edges, random edits on top */
+static std::string selftest_edit_distance()
+{
+    std::uint64_t state = 0x5EED;
+    const auto rnd = [&state](std::size_t n) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return std::size_t((state >> 33) % n);
+    };
+    std::size_t pairs = 0;
+    for (std::size_t m : {0, 1, 2, 63, 64, 65, 127, 128, 129, 200})
+        for (std::size_t trial = 0; trial < 50; ++trial)
+        {
+            const std::size_t vocab = 2 + rnd(trial % 2 ? 4 : 40); // small vocabularies repeat tokens
+            std::vector<std::uint32_t> ref(m), hyp;
+            for (auto &t : ref)
+                t = std::uint32_t(rnd(vocab));
+            for (std::size_t i = 0; i < m || (m == 0 && hyp.size() < trial % 5); ++i)
+                switch (rnd(8))
+                {
+                case 0: break;                                                  // deletion
+                case 1: hyp.push_back(std::uint32_t(vocab + rnd(3))); break;    // substitution, unseen token
+                case 2: hyp.push_back(std::uint32_t(rnd(vocab))), --i; break;   // insertion
+                default: if (i < m) hyp.push_back(ref[i]);                       // match
+                }
+            const std::size_t fast = edit_distance(hyp, ref), slow = edit_distance_dp(hyp, ref);
+            if (fast != slow)
+                return "ref " + std::to_string(m) + " / hyp " + std::to_string(hyp.size()) + " tokens: " +
+                       std::to_string(fast) + " edits, DP says " + std::to_string(slow);
+            ++pairs;
+        }
+
+    /* The same boundaries through word_error_rate: 64 and 65 words, one word dropped */
+    for (std::size_t m : {64, 65})
+    {
+        std::string ref, hyp;
+        for (std::size_t i = 0; i < m; ++i)
+        {
+            const std::string w = "w" + std::to_string(i);
+            ref += w + ' ';
+            hyp += i == m / 2 ? "" : w + ' ';
+        }
+        const ErrorRate e = word_error_rate(hyp, ref);
+        if (e.edits != 1 || e.ref_tokens != m)
+            return std::to_string(m) + "-word reference: " + std::to_string(e.edits) + " edits, expected 1";
+    }
+    std::printf("edit distance     ok  %zu pairs agree with DP (reference 0–200 tokens)\n", pairs);
+    return "";
+}
+
+/* plan_chunks on a synthetic MP3 index: contiguous chunks, exact bounds, 10 frames of preroll */
+static std::string selftest_plan_chunks()
+{
+    FrameIndex index;
+    index.format = AudioFormat::Mp3;
+    index.sample_rate = 44100;
+    const double frame_sec = 1152.0 / 44100.0;
+    for (std::size_t i = 0; i < 4000; ++i)
+        index.entries.push_back({1000 + 417 * std::uint64_t(i), double(i) * frame_sec});
+    index.end_offset = 1000 + 417 * std::uint64_t(index.entries.size());
+    index.duration_sec = double(index.entries.size()) * frame_sec;
+
+    std::size_t checked = 0;
+    for (const auto &bounds : std::vector<std::pair<double, double>>{{0.0, -1.0}, {12.3, 77.7}, {0.1, 0.2}})
+    {
+        const auto chunks = plan_chunks(index, 10.0, bounds.first, bounds.second);
+        if (chunks.empty())
+            return "no chunks for " + std::to_string(bounds.first) + "–" + std::to_string(bounds.second);
+        const double stop = bounds.second < 0.0 ? index.duration_sec : bounds.second;
+        if (std::fabs(chunks.front().start_sec - bounds.first) > 1e-9 || std::fabs(chunks.back().end_sec - stop) > 1e-9)
+            return "chunks do not span " + std::to_string(bounds.first) + "–" + std::to_string(stop);
+        for (std::size_t k = 0; k < chunks.size(); ++k)
+        {
+            const ChunkRange &r = chunks[k];
+            const std::size_t pre = r.first > 10 ? r.first - 10 : 0;
+            if (k > 0 && (r.first != chunks[k - 1].last || r.start_sec != chunks[k - 1].end_sec))
+                return "chunk " + std::to_string(k) + " does not start where chunk " + std::to_string(k - 1) + " ends";
+            if (r.last <= r.first || r.begin != index.offset_of(r.first) || r.end != index.offset_of(r.last))
+                return "chunk " + std::to_string(k) + " byte range does not match its entries";
+            if (r.preroll_begin != index.offset_of(pre) || r.preroll_sec != index.time_of(pre) ||
+                r.preroll_sec > r.start_sec)
+                return "chunk " + std::to_string(k) + " preroll is not the 10 frames before it";
+            ++checked;
+        }
+    }
+    std::printf("plan_chunks       ok  %zu chunks contiguous, preroll 10 frames\n", checked);
+    return "";
+}
+
+/* WebmDemuxer on a file with one block per lacing mode; every frame must come back intact */
+static std::string selftest_webm_lacing()
+{
+    using Bytes = std::vector<std::uint8_t>;
+    const auto element = [](std::uint32_t id, const Bytes &payload) {
+        Bytes out;
+        for (int shift = 24; shift >= 0; shift -= 8)
+            if ((id >> shift) || shift == 0)
+                out.push_back(std::uint8_t(id >> shift));
+        out.push_back(0x01); // 8-byte size
+        for (int shift = 48; shift >= 0; shift -= 8)
+            out.push_back(std::uint8_t(payload.size() >> shift));
+        out.insert(out.end(), payload.begin(), payload.end());
+        return out;
+    };
+    const auto frame = [](std::size_t n, std::size_t tag) {
+        Bytes f(n);
+        for (std::size_t i = 0; i < n; ++i)
+            f[i] = std::uint8_t(tag * 31 + i);
+        return f;
+    };
+
+    /* Frame sizes per block: Xiph (255 boundary), fixed, EBML (2-byte vints, deltas both ways) */
+    const std::vector<std::vector<std::size_t>> sizes{{255, 3, 510, 40}, {7, 7, 7}, {300, 5, 200, 217, 17}};
+    std::vector<Bytes> expect;
+    Bytes cluster = element(ebml::kTimecode, {0});
+    for (std::size_t b = 0; b < sizes.size(); ++b)
+    {
+        const int lacing = b == 0 ? 1 : b == 1 ? 2 : 3;
+        Bytes block{0x81, 0x00, 0x00, std::uint8_t(0x80 | (lacing << 1)), std::uint8_t(sizes[b].size() - 1)};
+        const auto &sz = sizes[b];
+        for (std::size_t i = 0; i + 1 < sz.size(); ++i)
+        {
+            if (lacing == 1)
+            {
+                block.insert(block.end(), sz[i] / 255, 0xFF);
+                block.push_back(std::uint8_t(sz[i] % 255));
+            }
+            else if (lacing == 3)
+            {
+                const std::int64_t raw = i == 0 ? std::int64_t(sz[0]) : std::int64_t(sz[i]) - std::int64_t(sz[i - 1]) + 8191;
+                block.push_back(std::uint8_t(0x40 | (raw >> 8)));
+                block.push_back(std::uint8_t(raw));
+            }
+        }
+        for (std::size_t i = 0; i < sz.size(); ++i)
+        {
+            expect.push_back(frame(sz[i], expect.size()));
+            block.insert(block.end(), expect.back().begin(), expect.back().end());
+        }
+        const Bytes simple = element(ebml::kSimpleBlock, block);
+        cluster.insert(cluster.end(), simple.begin(), simple.end());
+    }
+
+    Bytes track = element(ebml::kTrackNumber, {1});
+    for (const Bytes &e : {element(ebml::kTrackType, {2}), element(ebml::kCodecId, {'A', '_', 'O', 'P', 'U', 'S'})})
+        track.insert(track.end(), e.begin(), e.end());
+    Bytes segment = element(ebml::kTracks, element(ebml::kTrackEntry, track));
+    const Bytes clusters = element(ebml::kCluster, cluster);
+    segment.insert(segment.end(), clusters.begin(), clusters.end());
+    Bytes file = element(ebml::kEbml, element(0x4282, {'w', 'e', 'b', 'm'}));
+    const Bytes seg = element(ebml::kSegment, segment);
+    file.insert(file.end(), seg.begin(), seg.end());
+
+    const std::string path = ".bench-selftest-" + std::to_string(getpid()) + ".webm";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(file.data()), std::streamsize(file.size()));
+    }
+    WebmDemuxer demux;
+    std::string error;
+    if (!demux.open(path))
+        error = "could not open the synthetic WebM";
+    WebmPacket pkt;
+    std::size_t got = 0;
+    while (error.empty() && demux.next_packet(pkt))
+    {
+        if (got >= expect.size() || pkt.data != expect[got])
+            error = "frame " + std::to_string(got) + " came back as " + std::to_string(pkt.data.size()) + " bytes";
+        ++got;
+    }
+    if (error.empty() && got != expect.size())
+        error = std::to_string(got) + " of " + std::to_string(expect.size()) + " frames came back";
+    std::remove(path.c_str());
+    if (error.empty())
+        std::printf("webm lacing       ok  %zu frames through Xiph, fixed and EBML lacing\n", got);
+    return error;
+}
+
+/* The committed MP3 fixtures (testdata/) through Mp3Layer3Decoder at their own rate and layout,
+   against 16-bit PCM that libavcodec decoded from the same files: every sample within 1 LSB */
+static std::string selftest_mp3_fixtures(const fs::path &dir)
+{
+    std::size_t samples = 0;
+    for (const char *name : {"mpeg1_44k_stereo", "mpeg2_22k_stereo", "mpeg25_8k_mono"})
+    {
+        const fs::path mp3 = dir / (std::string(name) + ".mp3"), wav = dir / (std::string(name) + ".wav");
+        std::ifstream in(mp3, std::ios::binary);
+        const std::vector<std::uint8_t> bytes((std::istreambuf_iterator<char>(in)), {});
+        unsigned channels = 0, rate = 0;
+        drwav_uint64 frames = 0;
+        drwav_int16 *ref = drwav_open_file_and_read_pcm_frames_s16(wav.string().c_str(), &channels, &rate, &frames, nullptr);
+        if (bytes.empty() || !ref)
+        {
+            drwav_free(ref, nullptr);
+            return "could not read " + mp3.string() + " and its .wav (--testdata DIR)";
+        }
+
+        Mp3Layer3Decoder dec;
+        float pcm[Mp3Layer3Decoder::kMaxFrameSamples * 2];
+        std::string error;
+        std::size_t pos = mp3_id3v2_size(bytes.data(), bytes.size()), at = 0;
+        Mp3FrameHeader h;
+        while (error.empty() && pos + 4 <= bytes.size() && mp3_parse_header(bytes.data() + pos, h) &&
+               pos + std::size_t(h.frame_bytes) <= bytes.size())
+        {
+            int got = 0;
+            if (unsigned(h.sample_rate) != rate || unsigned(h.channels) != channels)
+                error = "frame layout differs from the reference";
+            else if (!dec.decode(bytes.data() + pos, std::size_t(h.frame_bytes), pcm, got))
+                error = "frame at byte " + std::to_string(pos) + " did not decode";
+            for (std::size_t i = 0; error.empty() && i < std::size_t(got) * channels; ++i, ++at)
+            {
+                const double mine = std::clamp(double(pcm[i]) * 32768.0, -32768.0, 32767.0);
+                if (at >= frames * channels || std::fabs(mine - ref[at]) > 1.0)
+                    error = "sample " + std::to_string(at / channels) + " is " + std::to_string(mine) +
+                            (at < frames * channels ? ", reference " + std::to_string(ref[at]) : ", past the reference");
+            }
+            pos += std::size_t(h.frame_bytes);
+        }
+        drwav_free(ref, nullptr);
+        if (error.empty() && at != frames * channels)
+            error = std::to_string(at / channels) + " of " + std::to_string(frames) + " samples decoded";
+        if (!error.empty())
+            return std::string(name) + ": " + error;
+        samples += at;
+    }
+    std::printf("mp3 fixtures      ok  %zu samples within 1 LSB of libavcodec (MPEG-1, 2, 2.5)\n", samples);
+    return "";
+}
+
+/* Every path this host runs against scalar on the same random inputs: float kernels to rounding
+   (lengths around each vector width), levenshtein bit for bit (block counts around each lane count) */
+static std::string selftest_simd_paths()
+{
+    std::uint64_t state = 0x51AD;
+    const auto rnd = [&state] {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return state;
+    };
+    const auto sample = [&rnd] { return float(std::int64_t(rnd() >> 40) - (1 << 23)) / float(1 << 23); };
+    const SimdKernels &ref = *simd_path("scalar");
+    std::vector<float> a(1100), b(1100), out(1100), want(1100);
+    for (std::size_t i = 0; i < a.size(); ++i)
+        a[i] = sample(), b[i] = sample();
+
+    std::size_t compared = 0;
+    std::string names;
+    for (const std::string &name : simd_paths())
+    {
+        names += (names.empty() ? "" : ", ") + name;
+        const SimdKernels &k = *simd_path(name);
+        for (std::size_t n : {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 480, 1023})
+        {
+            float bound = 0.0f;
+            for (std::size_t i = 0; i < n; ++i)
+                bound += std::fabs(a[i] * b[i]);
+            const float tol = 1e-5f * (bound + 1.0f);
+            if (std::fabs(k.dot(a.data(), b.data(), n) - ref.dot(a.data(), b.data(), n)) > tol)
+                return name + " dot of " + std::to_string(n) + " differs from scalar";
+            if (std::fabs(k.sum_squares(a.data(), n) - ref.sum_squares(a.data(), n)) > 1e-5f * (float(n) + 1.0f))
+                return name + " sum_squares of " + std::to_string(n) + " differs from scalar";
+            for (int channels : {1, 2, 3})
+            {
+                if (n * std::size_t(channels) > a.size())
+                    continue;
+                k.downmix(a.data(), n, channels, 0.5f, out.data());
+                ref.downmix(a.data(), n, channels, 0.5f, want.data());
+                for (std::size_t i = 0; i < n; ++i)
+                    if (std::fabs(out[i] - want[i]) > 1e-6f)
+                        return name + " downmix of " + std::to_string(n) + " × " + std::to_string(channels) +
+                               " channels differs from scalar at frame " + std::to_string(i);
+            }
+            ++compared;
+        }
+
+        for (std::size_t blocks : {1, 2, 3, 4, 5, 7, 8, 9, 16, 19})
+            for (std::size_t n : {1, 2, 5, 8, 9, 100})
+            {
+                const std::size_t vocab = 5;
+                std::vector<std::uint64_t> peq(vocab * blocks), pv(blocks), mv(blocks);
+                std::vector<std::uint32_t> col(n);
+                std::vector<std::int8_t> carry(n);
+                for (auto &w : peq)
+                    w = rnd() & rnd();
+                for (std::size_t i = 0; i < blocks; ++i)
+                    pv[i] = rnd(), mv[i] = rnd() & ~pv[i];
+                for (std::size_t j = 0; j < n; ++j)
+                    col[j] = std::uint32_t(rnd() % vocab), carry[j] = std::int8_t(int(rnd() % 3) - 1);
+                std::vector<std::uint64_t> pv2 = pv, mv2 = mv;
+                std::vector<std::int8_t> carry2 = carry;
+                k.levenshtein(peq.data(), blocks, col.data(), n, pv.data(), mv.data(), carry.data());
+                ref.levenshtein(peq.data(), blocks, col.data(), n, pv2.data(), mv2.data(), carry2.data());
+                if (pv != pv2 || mv != mv2 || carry != carry2)
+                    return name + " levenshtein over " + std::to_string(blocks) + " blocks × " + std::to_string(n) +
+                           " columns differs from scalar";
+                ++compared;
+            }
+    }
+    std::printf("simd paths        ok  %zu cases per path agree with scalar (%s)\n", compared / simd_paths().size(),
+                names.c_str());
+    return "";
+}
+
+static int bench_selftest(const CliArgs &args)
+{
+    const fs::path testdata =
+        args.has("--testdata") ? fs::path(args.get("--testdata")) : fs::path(__FILE__).parent_path() / "testdata";
+    const std::vector<std::function<std::string()>> checks{
+        selftest_edit_distance, selftest_plan_chunks, selftest_webm_lacing, selftest_simd_paths,
+        [&] { return selftest_mp3_fixtures(testdata); }};
+    std::size_t failed = 0;
+    for (const auto &check : checks)
+    {
+        const std::string error = check();
+        if (!error.empty())
+        {
+            std::printf("FAIL  %s\n", error.c_str());
+            ++failed;
+        }
+    }
+    return failed ? 1 : 0;
+}
+
+/*───────────────────────────────────────────────────────────────*/
+int main(int argc, char *argv[])
+{
+    const CliArgs args = parse_args(argc, argv);
+    const std::string cmd = args.positional.empty() ? "" : args.positional[0];
+    std::string simd_error;
+    if (args.has("--simd") && !simd_force(args.get("--simd"), simd_error))
+    {
+        std::cerr << simd_error << std::endl;
+        return 1;
+    }
+    PcmStorage pcm_storage = PcmStorage::S16;
+    if (args.has("--pcm-storage") && !parse_pcm_storage(args.get("--pcm-storage"), pcm_storage))
+    {
+        std::cerr << "Unknown --pcm-storage " << args.get("--pcm-storage") << " (s16 or f16)" << std::endl;
+        return 1;
+    }
+    pcm_pool().set_storage(pcm_storage);
+    if (cmd == "scale" || cmd == "gate" || cmd == "soak")
+        std::cerr << "simd: " << simd().name << std::endl;
+    try
+    {
+        if (cmd == "scale")
+            return bench_scale(args);
+        if (cmd == "eval")
+            return bench_eval(args);
+        if (cmd == "gate")
+            return bench_gate(args);
+        if (cmd == "soak")
+            return bench_soak(args);
+        if (cmd == "selftest")
+            return bench_selftest(args);
+    }
+    catch (const JobError &e)
+    {
+        std::cerr << '\n' << e.what() << std::endl;
+        return e.status;
+    }
+    std::cerr << "Usage: " << argv[0] << " scale <audio-file> <path-to-whisper-model> [options]\n"
+              << "       " << argv[0] << " eval <hypothesis> <reference> | --list PAIRS.tsv\n"
+              << "       " << argv[0] << " gate <audio-file> <path-to-whisper-model> --baseline PATH [options]\n"
+              << "       " << argv[0] << " soak <path-to-whisper-model> [--hours 10] [--backend mock[:RTF]] [options]\n"
+              << "       " << argv[0] << " selftest [--testdata DIR]" << std::endl;
+    return 1;
+}
@@ -0,0 +1,391 @@
+/*
+frame_index.h – one-pass frame/cluster index of a compressed or PCM audio file
+
+Introduction
+============
+Scans the source once and records the byte offset and start time of every
+MP3 frame, ADTS (AAC) frame or WebM Cluster; a PCM WAV needs no scan and is
+indexed once per second from its header. With the index in hand a long file
+can be cut into chunks that are just byte ranges – nothing is copied to disk,
+and each range is decoded only when a worker picks it up:
+
+    ```cpp
+    #include "frame_index.h"
+
+    FrameIndex index;
+    if (build_frame_index("audio.mp3", index))
+        for (const ChunkRange &r : plan_chunks(index, 600.0))
+            ...  // Mp3Decoder::open("audio.mp3", r.preroll_begin, r.end)
+    ```
+
+Planning is O(index): chunk boundaries are snapped to the frame that starts
+closest to each multiple of the chunk length. A time range can be requested,
+in which case only the entries covering it are ever read.
+
+Every range also carries a pre-roll start a few entries earlier: Layer III
+frames may borrow bits from up to 511 bytes back, AAC needs one frame of MDCT
+overlap and Opus needs 80 ms of warm-up. The decoder starts at `preroll_begin`
+and the caller drops `start_sec - preroll_sec` worth of output.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "mp3_decoder.h"
+#include "webm_opus.h"
+
+enum class AudioFormat
+{
+    Unknown,
+    Mp3,
+    Adts,
+    Webm,
+    Wav, // uncompressed PCM / IEEE float
+};
+
+inline const char *audio_format_name(AudioFormat f)
+{
+    switch (f)
+    {
+    case AudioFormat::Mp3:
+        return "mp3";
+    case AudioFormat::Adts:
+        return "adts";
+    case AudioFormat::Webm:
+        return "webm";
+    case AudioFormat::Wav:
+        return "wav";
+    default:
+        return "unknown";
+    }
+}
+
+struct FrameIndex
+{
+    struct Entry
+    {
+        std::uint64_t offset; // byte offset of the frame / Cluster
+        double start_sec;     // presentation time of its first sample
+    };
+
+    AudioFormat format = AudioFormat::Unknown;
+    int sample_rate = 0; // source rate (0 for WebM: timestamps come from the container)
+    std::vector<Entry> entries;
+    std::uint64_t end_offset = 0; // one past the last indexed byte
+    double duration_sec = 0.0;
+
+    /* Last entry starting at or before `sec`. */
+    std::size_t find(double sec) const
+    {
+        auto it = std::upper_bound(entries.begin(), entries.end(), sec,
+                                   [](double s, const Entry &e) { return s < e.start_sec; });
+        return it == entries.begin() ? 0 : std::size_t(it - entries.begin()) - 1;
+    }
+
+    std::uint64_t offset_of(std::size_t i) const { return i < entries.size() ? entries[i].offset : end_offset; }
+    double time_of(std::size_t i) const { return i < entries.size() ? entries[i].start_sec : duration_sec; }
+};
+
+struct ChunkRange
+{
+    std::size_t first = 0, last = 0;         // entries [first, last)
+    std::uint64_t begin = 0, end = 0;        // bytes [begin, end)
+    std::uint64_t preroll_begin = 0;         // decoder start (≤ begin)
+    double start_sec = 0.0, end_sec = 0.0;
+    double preroll_sec = 0.0;                // time at preroll_begin
+};
+
+/*───────────────────────────────────────────────────────────────
+  ADTS header (ISO 14496-3 §1.A.2)
+──────────────────────────────────────────────────────────────*/
+struct AdtsFrameHeader
+{
+    int sample_rate = 0;
+    int channels = 0;
+    int samples = 0;
+    int frame_bytes = 0;
+};
+
+inline bool adts_parse_header(const std::uint8_t *p, AdtsFrameHeader &h)
+{
+    if (p[0] != 0xFF || (p[1] & 0xF6) != 0xF0)
+        return false;
+    static const int kRates[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                   22050, 16000, 12000, 11025, 8000, 7350};
+    const int sf = (p[2] >> 2) & 0xF;
+    if (sf > 12)
+        return false;
+    h.sample_rate = kRates[sf];
+    h.channels = ((p[2] & 1) << 2) | (p[3] >> 6);
+    h.frame_bytes = ((p[3] & 3) << 11) | (p[4] << 3) | (p[5] >> 5);
+    h.samples = 1024 * ((p[6] & 3) + 1);
+    return h.frame_bytes >= 7;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Format sniffing
+──────────────────────────────────────────────────────────────*/
+inline AudioFormat sniff_audio_format(const std::string &path, std::uint64_t *data_start = nullptr)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::uint8_t head[10] = {};
+    if (!in.read(reinterpret_cast<char *>(head), sizeof(head)))
+        return AudioFormat::Unknown;
+
+    if (head[0] == 0x1A && head[1] == 0x45 && head[2] == 0xDF && head[3] == 0xA3)
+        return AudioFormat::Webm;
+    if (std::memcmp(head, "RIFF", 4) == 0 && std::memcmp(head + 8, "WA", 2) == 0)
+        return AudioFormat::Wav;
+
+    std::uint64_t pos = mp3_id3v2_size(head, sizeof(head));
+    std::uint8_t p[8] = {};
+    in.seekg(std::streamoff(pos));
+    if (!in.read(reinterpret_cast<char *>(p), sizeof(p)))
+        return AudioFormat::Unknown;
+    if (data_start)
+        *data_start = pos;
+
+    AdtsFrameHeader ah;
+    Mp3FrameHeader mh;
+    if (adts_parse_header(p, ah))
+        return AudioFormat::Adts;
+    if (mp3_parse_header(p, mh))
+        return AudioFormat::Mp3;
+    return AudioFormat::Unknown;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Index builders
+──────────────────────────────────────────────────────────────*/
+namespace frame_index_detail
+{
+/* Xing/Info frames carry VBR metadata and decode to nothing. */
+inline bool is_xing_frame(const std::uint8_t *p, std::size_t avail, const Mp3FrameHeader &h)
+{
+    if (h.layer != 3)
+        return false;
+    const std::size_t side = h.version == 1 ? (h.channels == 1 ? 17 : 32) : (h.channels == 1 ? 9 : 17);
+    const std::size_t at = 4 + side + ((p[1] & 1) ? 0 : 2);
+    return at + 4 <= avail && (std::memcmp(p + at, "Xing", 4) == 0 || std::memcmp(p + at, "Info", 4) == 0);
+}
+
+inline bool scan_frames(const std::string &path, std::uint64_t start, FrameIndex &index)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in || !in.seekg(std::streamoff(start)))
+        return false;
+
+    const bool adts = index.format == AudioFormat::Adts;
+    std::vector<std::uint8_t> buf(1 << 20);
+    std::size_t len = 0, pos = 0;
+    std::uint64_t base = start; // file offset of buf[0]
+    std::uint64_t samples = 0;
+    bool synced = false;
+
+    for (;;)
+    {
+        if (len - pos < 8192 && in)
+        {
+            std::memmove(buf.data(), buf.data() + pos, len - pos);
+            base += pos;
+            len -= pos;
+            pos = 0;
+            in.read(reinterpret_cast<char *>(buf.data() + len), std::streamsize(buf.size() - len));
+            len += std::size_t(in.gcount());
+        }
+        if (len - pos < 8)
+            break;
+
+        const std::uint8_t *p = buf.data() + pos;
+        const std::size_t avail = len - pos;
+        int rate = 0, n_samples = 0, n_bytes = 0;
+        bool ok = false;
+        if (adts)
+        {
+            AdtsFrameHeader h;
+            if ((ok = adts_parse_header(p, h)))
+                rate = h.sample_rate, n_samples = h.samples, n_bytes = h.frame_bytes;
+        }
+        else
+        {
+            Mp3FrameHeader h;
+            if ((ok = mp3_parse_header(p, h)))
+            {
+                rate = h.sample_rate, n_bytes = h.frame_bytes;
+                n_samples = (index.entries.empty() && is_xing_frame(p, avail, h)) ? 0 : h.samples;
+            }
+        }
+
+        if (ok && !synced && std::size_t(n_bytes) + 8 <= avail)
+        {
+            /* Resync: require a matching header right after this frame. */
+            Mp3FrameHeader mh;
+            AdtsFrameHeader ah;
+            ok = adts ? adts_parse_header(p + n_bytes, ah) && ah.sample_rate == rate
+                      : mp3_parse_header(p + n_bytes, mh) && mh.sample_rate == rate;
+        }
+        if (!ok || (index.sample_rate && rate != index.sample_rate))
+        {
+            if (std::memcmp(p, "TAG", 3) == 0 || std::memcmp(p, "APETAGEX", 8) == 0)
+                break; // trailing ID3v1 / APE tag
+            synced = false;
+            ++pos;
+            continue;
+        }
+
+        synced = true;
+        index.sample_rate = rate;
+        if (n_samples)
+            index.entries.push_back({base + pos, double(samples) / rate});
+        samples += std::uint64_t(n_samples);
+        pos += std::size_t(n_bytes);
+        index.end_offset = base + std::min(pos, len);
+    }
+
+    index.duration_sec = index.sample_rate ? double(samples) / index.sample_rate : 0.0;
+    return !index.entries.empty();
+}
+
+/* RIFF chunks up to "data"; one entry per second of sample frames. */
+inline bool scan_wav(const std::string &path, FrameIndex &index)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    const std::uint64_t file_size = std::uint64_t(in.tellg());
+    in.seekg(12);
+    const auto le16 = [](const std::uint8_t *p) { return unsigned(p[0]) | unsigned(p[1]) << 8; };
+    const auto le32 = [](const std::uint8_t *p) {
+        return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16 | std::uint32_t(p[3]) << 24;
+    };
+    unsigned block_align = 0;
+    std::uint8_t head[8];
+    while (in.read(reinterpret_cast<char *>(head), sizeof(head)))
+    {
+        const std::uint64_t at = std::uint64_t(in.tellg());
+        const std::uint32_t size = le32(head + 4);
+        if (std::memcmp(head, "fmt ", 4) == 0)
+        {
+            std::uint8_t fmt[16];
+            if (size < sizeof(fmt) || !in.read(reinterpret_cast<char *>(fmt), sizeof(fmt)))
+                return false;
+            index.sample_rate = int(le32(fmt + 4));
+            block_align = le16(fmt + 12);
+        }
+        else if (std::memcmp(head, "data", 4) == 0)
+        {
+            if (!block_align || index.sample_rate <= 0)
+                return false;
+            /* Streamed WAVs leave the size at 0 or 0xFFFFFFFF: take the rest of the file */
+            const std::uint64_t end = size && size != 0xFFFFFFFFu ? std::min(file_size, at + size) : file_size;
+            const std::uint64_t frames = (end - at) / block_align;
+            const std::uint64_t step = std::uint64_t(index.sample_rate);
+            for (std::uint64_t f = 0; f < frames; f += step)
+                index.entries.push_back({at + f * block_align, double(f) / index.sample_rate});
+            index.end_offset = at + frames * block_align;
+            index.duration_sec = double(frames) / index.sample_rate;
+            return !index.entries.empty();
+        }
+        in.seekg(std::streamoff(at + size + (size & 1)));
+    }
+    return false;
+}
+
+inline bool scan_clusters(const std::string &path, FrameIndex &index)
+{
+    WebmDemuxer demux;
+    std::vector<WebmCluster> clusters;
+    if (!demux.open(path) || !demux.index_clusters(clusters))
+        return false;
+
+    index.entries.reserve(clusters.size());
+    for (const auto &c : clusters)
+        index.entries.push_back({c.offset, double(c.pts_ns) / 1e9});
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    index.end_offset = std::uint64_t(in.tellg());
+    index.duration_sec = demux.duration_sec() > 0.0 ? demux.duration_sec() : index.entries.back().start_sec;
+    return true;
+}
+} // namespace frame_index_detail
+
+/* Build the index in one scan of `path`; false if the format is not recognised. */
+inline bool build_frame_index(const std::string &path, FrameIndex &index)
+{
+    index = FrameIndex();
+    std::uint64_t start = 0;
+    index.format = sniff_audio_format(path, &start);
+    switch (index.format)
+    {
+    case AudioFormat::Mp3:
+    case AudioFormat::Adts:
+        return frame_index_detail::scan_frames(path, start, index);
+    case AudioFormat::Webm:
+        return frame_index_detail::scan_clusters(path, index);
+    case AudioFormat::Wav:
+        return frame_index_detail::scan_wav(path, index);
+    default:
+        return false;
+    }
+}
+
+/*───────────────────────────────────────────────────────────────
+  Chunk planning – O(index)
+──────────────────────────────────────────────────────────────*/
+/* Cut [from_sec, to_sec) – the whole file by default – into chunks of about
+   `chunk_len_sec`. Decoding always starts on an entry boundary, but the first
+   and last chunk carry the exact requested bounds in start_sec / end_sec. */
+inline std::vector<ChunkRange> plan_chunks(const FrameIndex &index, double chunk_len_sec,
+                                           double from_sec = 0.0, double to_sec = -1.0)
+{
+    std::vector<ChunkRange> chunks;
+    if (index.entries.empty())
+        return chunks;
+
+    const bool open_end = to_sec < 0.0 || to_sec >= index.duration_sec;
+    const double stop = open_end ? index.duration_sec : to_sec;
+    from_sec = std::max(0.0, from_sec);
+    if (from_sec >= stop)
+        return chunks;
+    const std::size_t end_entry = open_end ? index.entries.size()
+                                           : std::min(index.entries.size(), index.find(stop) + 1);
+
+    const std::size_t preroll = index.format == AudioFormat::Mp3    ? 10
+                                : index.format == AudioFormat::Adts ? 2
+                                : index.format == AudioFormat::Wav  ? 0
+                                                                    : 1;
+    std::size_t first = index.find(from_sec);
+    double start = from_sec;
+    for (int k = 1; first < end_entry; ++k)
+    {
+        std::size_t last = end_entry;
+        const double cut = from_sec + k * chunk_len_sec;
+        if (cut < stop)
+        {
+            last = index.find(cut);
+            if (last + 1 < end_entry && cut - index.time_of(last) > index.time_of(last + 1) - cut)
+                ++last;
+            last = std::min(std::max(last, first + 1), end_entry);
+        }
+
+        ChunkRange r;
+        r.first = first;
+        r.last = last;
+        r.begin = index.offset_of(first);
+        r.end = index.offset_of(last);
+        r.start_sec = start;
+        r.end_sec = last == end_entry ? stop : index.time_of(last);
+        const std::size_t pre = first > preroll ? first - preroll : 0;
+        r.preroll_begin = index.offset_of(pre);
+        r.preroll_sec = index.time_of(pre);
+        chunks.push_back(r);
+
+        first = last;
+        start = r.end_sec;
+    }
+    return chunks;
+}
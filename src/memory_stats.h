@@ -0,0 +1,262 @@
+/*
+memory_stats.h – resident-set sampling and per-stage allocation accounting
+
+Introduction
+============
+When a long job is OOM-killed, the question is which part grew: decoded PCM,
+transcript strings, or the model in the whisper-cli child. Each stage is
+wrapped in a scope that samples RSS on the way in and out and tags the thread's
+allocations with the stage:
+
+    ```cpp
+    #include "memory_stats.h"
+
+    {
+        MemScope mem(Stage::Decode);
+        decode(...);                    // RSS before/after, allocations tagged
+    }
+    std::string json = memory_json();   // {"peak_rss_mb":…,"children_peak_rss_mb":…,"stages":{…}}
+    ```
+
+RSS comes from /proc/self/status (VmRSS, VmHWM) and the largest waited-for
+child from getrusage(RUSAGE_CHILDREN) – that is where the model lives. Other
+platforms fall back to getrusage alone.
+
+Allocation accounting replaces the global operator new/delete and is therefore
+opt-in at build time:
+
+    g++ -DTRANSCRIBE_COUNT_ALLOCS … transcribe.cpp
+
+Each block then carries a 16-byte header holding its size and stage, so
+bytes freed on another thread or after the scope ends are credited back to the
+stage that allocated them. Define the macro in one translation unit only.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "metrics.h"
+
+struct RssSample
+{
+    std::uint64_t rss_kb = 0;  // resident now
+    std::uint64_t peak_kb = 0; // high-water mark of this process
+};
+
+inline RssSample sample_rss()
+{
+    RssSample s;
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            s.rss_kb = std::strtoull(line.c_str() + 6, nullptr, 10);
+        else if (line.compare(0, 6, "VmHWM:") == 0)
+            s.peak_kb = std::strtoull(line.c_str() + 6, nullptr, 10);
+    }
+    if (!s.peak_kb)
+    {
+        rusage ru{};
+        getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+        s.peak_kb = std::uint64_t(ru.ru_maxrss) / 1024; // bytes on macOS
+#else
+        s.peak_kb = std::uint64_t(ru.ru_maxrss);
+#endif
+    }
+    return s;
+}
+
+/* Peak RSS of the largest child waited for so far (whisper-cli, ffmpeg). */
+inline std::uint64_t children_peak_rss_kb()
+{
+    rusage ru{};
+    getrusage(RUSAGE_CHILDREN, &ru);
+#ifdef __APPLE__
+    return std::uint64_t(ru.ru_maxrss) / 1024;
+#else
+    return std::uint64_t(ru.ru_maxrss);
+#endif
+}
+
+struct StageMemory
+{
+    std::atomic<std::uint64_t> scopes{0};
+    std::atomic<std::int64_t> rss_growth_kb{0}; // summed RSS change across scopes
+    std::atomic<std::uint64_t> rss_exit_max_kb{0};
+    std::atomic<std::uint64_t> rss_exit_sum_kb{0};
+    std::atomic<std::uint64_t> allocated{0}; // bytes, counting builds only
+    std::atomic<std::int64_t> live{0};
+    std::atomic<std::int64_t> live_peak{0};
+};
+
+namespace memory_detail
+{
+constexpr std::size_t kSlots = std::size_t(Stage::Count) + 1; // last: outside any scope
+
+inline StageMemory *slots()
+{
+    static StageMemory s[kSlots];
+    return s;
+}
+
+inline std::uint8_t &current_slot()
+{
+    thread_local std::uint8_t slot = std::uint8_t(Stage::Count);
+    return slot;
+}
+
+inline void max_into(std::atomic<std::int64_t> &into, std::int64_t v)
+{
+    std::int64_t seen = into.load(std::memory_order_relaxed);
+    while (v > seen && !into.compare_exchange_weak(seen, v, std::memory_order_relaxed))
+    {
+    }
+}
+} // namespace memory_detail
+
+inline StageMemory &stage_memory(Stage s)
+{
+    return memory_detail::slots()[std::size_t(s)];
+}
+
+/* Samples RSS around its scope and tags this thread's allocations with `stage`. */
+class MemScope
+{
+public:
+    explicit MemScope(Stage stage)
+        : stage_(stage), prev_(memory_detail::current_slot()), before_(sample_rss().rss_kb)
+    {
+        memory_detail::current_slot() = std::uint8_t(stage);
+    }
+
+    ~MemScope()
+    {
+        memory_detail::current_slot() = prev_;
+        const std::uint64_t after = sample_rss().rss_kb;
+        StageMemory &m = stage_memory(stage_);
+        m.scopes.fetch_add(1, std::memory_order_relaxed);
+        m.rss_growth_kb.fetch_add(std::int64_t(after) - std::int64_t(before_), std::memory_order_relaxed);
+        m.rss_exit_sum_kb.fetch_add(after, std::memory_order_relaxed);
+        std::uint64_t seen = m.rss_exit_max_kb.load(std::memory_order_relaxed);
+        while (after > seen && !m.rss_exit_max_kb.compare_exchange_weak(seen, after, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    MemScope(const MemScope &) = delete;
+    MemScope &operator=(const MemScope &) = delete;
+
+private:
+    Stage stage_;
+    std::uint8_t prev_;
+    std::uint64_t before_;
+};
+
+#ifdef TRANSCRIBE_COUNT_ALLOCS
+namespace memory_detail
+{
+constexpr std::size_t kHeader = 16; // keeps the user pointer 16-byte aligned
+
+/* Kept out of line so callers never see new paired with free(). */
+#if defined(__GNUC__)
+#define MEMORY_STATS_NOINLINE __attribute__((noinline))
+#else
+#define MEMORY_STATS_NOINLINE
+#endif
+
+MEMORY_STATS_NOINLINE inline void *counted_alloc(std::size_t n)
+{
+    auto *p = static_cast<unsigned char *>(std::malloc(n + kHeader));
+    if (!p)
+        return nullptr;
+    const std::uint8_t slot = current_slot();
+    std::memcpy(p, &n, sizeof(n));
+    p[sizeof(n)] = slot;
+    StageMemory &m = slots()[slot];
+    m.allocated.fetch_add(n, std::memory_order_relaxed);
+    max_into(m.live_peak, m.live.fetch_add(std::int64_t(n), std::memory_order_relaxed) + std::int64_t(n));
+    return p + kHeader;
+}
+
+MEMORY_STATS_NOINLINE inline void counted_free(void *ptr)
+{
+    if (!ptr)
+        return;
+    auto *p = static_cast<unsigned char *>(ptr) - kHeader;
+    std::size_t n;
+    std::memcpy(&n, p, sizeof(n));
+    slots()[p[sizeof(n)]].live.fetch_sub(std::int64_t(n), std::memory_order_relaxed);
+    std::free(p);
+}
+} // namespace memory_detail
+
+void *operator new(std::size_t n)
+{
+    if (void *p = memory_detail::counted_alloc(n))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t n) { return operator new(n); }
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept { return memory_detail::counted_alloc(n); }
+void *operator new[](std::size_t n, const std::nothrow_t &) noexcept { return memory_detail::counted_alloc(n); }
+void operator delete(void *p) noexcept { memory_detail::counted_free(p); }
+void operator delete[](void *p) noexcept { memory_detail::counted_free(p); }
+void operator delete(void *p, std::size_t) noexcept { memory_detail::counted_free(p); }
+void operator delete[](void *p, std::size_t) noexcept { memory_detail::counted_free(p); }
+#endif
+
+/* {"rss_mb":…,"peak_rss_mb":…,"children_peak_rss_mb":…,"stages":{"<stage>":{…}}}
+   rss_mb is sampled when the report is written – the steady state after a run. */
+inline std::string memory_json()
+{
+    const RssSample now = sample_rss();
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "{\"rss_mb\":%.1f,\"peak_rss_mb\":%.1f,\"children_peak_rss_mb\":%.1f,"
+                                    "\"allocations_counted\":%s,\"stages\":{",
+                  double(now.rss_kb) / 1024.0, double(now.peak_kb) / 1024.0, double(children_peak_rss_kb()) / 1024.0,
+#ifdef TRANSCRIBE_COUNT_ALLOCS
+                  "true"
+#else
+                  "false"
+#endif
+    );
+    std::string out = buf;
+    bool first = true;
+    for (std::size_t i = 0; i < memory_detail::kSlots; ++i)
+    {
+        const StageMemory &m = memory_detail::slots()[i];
+        const std::uint64_t scopes = m.scopes.load();
+        if (!scopes && !m.allocated.load())
+            continue;
+        std::snprintf(buf, sizeof(buf),
+                      "%s\"%s\":{\"scopes\":%llu,\"rss_growth_mb\":%.1f,\"rss_exit_mean_mb\":%.1f,"
+                      "\"rss_exit_max_mb\":%.1f",
+                      first ? "" : ",", i < std::size_t(Stage::Count) ? stage_name(Stage(i)) : "other",
+                      static_cast<unsigned long long>(scopes), double(m.rss_growth_kb.load()) / 1024.0,
+                      scopes ? double(m.rss_exit_sum_kb.load()) / 1024.0 / double(scopes) : 0.0,
+                      double(m.rss_exit_max_kb.load()) / 1024.0);
+        out += buf;
+#ifdef TRANSCRIBE_COUNT_ALLOCS
+        std::snprintf(buf, sizeof(buf), ",\"allocated_mb\":%.1f,\"live_mb\":%.1f,\"live_peak_mb\":%.1f",
+                      double(m.allocated.load()) / 1048576.0, double(m.live.load()) / 1048576.0,
+                      double(m.live_peak.load()) / 1048576.0);
+        out += buf;
+#endif
+        out += "}";
+        first = false;
+    }
+    return out + "}}";
+}
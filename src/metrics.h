@@ -0,0 +1,270 @@
+/*
+metrics.h – per-stage latency histograms (HDR-style, lock-free recording)
+
+Introduction
+============
+Totals hide the one slow chunk that sets a job's latency, so every stage
+records each observation into a log-linear histogram and reports
+percentiles:
+
+    ```cpp
+    #include "metrics.h"
+
+    {
+        StageTimer t(Stage::Decode);
+        decode(...);
+    }                                   // recorded on scope exit
+    record_stage(Stage::Inference, us_per_audio_second);
+    std::string json = latency_json();  // {"decode":{"count":…,"p50":…,…},…}
+    ```
+
+Buckets have 32 linear sub-buckets per power of two, so any value is
+reported within ~3 % of what was recorded, from 1 µs to hours, in a fixed
+15 KiB per shard. Threads are dealt round-robin onto 8 shards of relaxed
+atomic counters, so up to 8 recording threads never share a cache line and
+more than that share a shard with every 8th other thread – still no locks,
+only occasional contention. Shards are summed when a snapshot is taken.
+
+The histograms live for the whole process, so a long-running process
+accumulates them across jobs.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+enum class Stage
+{
+    Download,     // throughput, bytes per second
+    Segmentation, // index + chunk plan, µs
+    Decode,       // one chunk to 16 kHz WAV, µs
+    Inference,    // whisper wall time per second of audio, µs
+    Postprocess,  // timestamps, cleaning, checkpointing per chunk, µs
+    Count
+};
+
+inline const char *stage_name(Stage s)
+{
+    switch (s)
+    {
+    case Stage::Download:
+        return "download";
+    case Stage::Segmentation:
+        return "segmentation";
+    case Stage::Decode:
+        return "decode";
+    case Stage::Inference:
+        return "inference";
+    case Stage::Postprocess:
+        return "postprocess";
+    default:
+        return "?";
+    }
+}
+
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBits = 5; // 32 sub-buckets per octave
+    static constexpr std::size_t kSub = std::size_t(1) << kSubBits;
+    static constexpr std::size_t kBuckets = kSub + (64 - kSubBits) * kSub;
+    static constexpr std::size_t kShards = 8;
+
+    struct Summary
+    {
+        std::uint64_t count = 0, max = 0;
+        double mean = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0;
+    };
+
+    void record(std::uint64_t value)
+    {
+        Shard &s = shards_[shard_index()];
+        s.counts[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(value, std::memory_order_relaxed);
+        std::uint64_t seen = s.max.load(std::memory_order_relaxed);
+        while (value > seen && !s.max.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /* All shards merged. */
+    struct Snapshot
+    {
+        std::array<std::uint64_t, kBuckets> counts{};
+        std::uint64_t count = 0, max = 0;
+        double sum = 0.0;
+    };
+
+    Snapshot snapshot() const
+    {
+        Snapshot snap;
+        for (const Shard &s : shards_)
+        {
+            for (std::size_t b = 0; b < kBuckets; ++b)
+                snap.counts[b] += s.counts[b].load(std::memory_order_relaxed);
+            snap.sum += double(s.sum.load(std::memory_order_relaxed));
+            snap.max = std::max(snap.max, s.max.load(std::memory_order_relaxed));
+        }
+        for (std::uint64_t c : snap.counts)
+            snap.count += c;
+        return snap;
+    }
+
+    Summary summary() const
+    {
+        const Snapshot snap = snapshot();
+        const auto &merged = snap.counts;
+        Summary out;
+        out.count = snap.count;
+        out.max = snap.max;
+        if (!out.count)
+            return out;
+        out.mean = snap.sum / double(out.count);
+
+        const auto at = [&](double q) {
+            const auto rank = std::uint64_t(q * double(out.count - 1)) + 1;
+            std::uint64_t seen = 0;
+            for (std::size_t b = 0; b < kBuckets; ++b)
+                if ((seen += merged[b]) >= rank)
+                    return std::min(bucket_mid(b), double(out.max));
+            return double(out.max);
+        };
+        out.p50 = at(0.50);
+        out.p90 = at(0.90);
+        out.p99 = at(0.99);
+        return out;
+    }
+
+    static std::size_t bucket_of(std::uint64_t v)
+    {
+        if (v < kSub)
+            return std::size_t(v);
+        int exp = 63;
+        while (!(v >> exp))
+            --exp;
+        const int shift = exp - kSubBits;
+        return kSub + std::size_t(shift) * kSub + std::size_t((v >> shift) & (kSub - 1));
+    }
+
+    static double bucket_mid(std::size_t b)
+    {
+        if (b < kSub)
+            return double(b);
+        const std::size_t shift = (b - kSub) / kSub;
+        const double lo = double((kSub + (b - kSub) % kSub) << shift);
+        return lo + double(std::uint64_t(1) << shift) / 2.0;
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<std::uint64_t>, kBuckets> counts{};
+        std::atomic<std::uint64_t> sum{0}, max{0};
+    };
+
+    static std::size_t shard_index()
+    {
+        static std::atomic<std::size_t> next{0};
+        thread_local const std::size_t mine = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return mine;
+    }
+
+    std::array<Shard, kShards> shards_{};
+};
+
+inline LatencyHistogram &stage_histogram(Stage s)
+{
+    static LatencyHistogram histograms[std::size_t(Stage::Count)];
+    return histograms[std::size_t(s)];
+}
+
+inline void record_stage(Stage s, std::uint64_t value)
+{
+    stage_histogram(s).record(value);
+}
+
+/* Event counters for a long-running process – bumped once per chunk or job,
+   never per sample, and read by the metrics exporter. */
+struct PipelineCounters
+{
+    std::atomic<std::int64_t> jobs_in_flight{0};
+    std::atomic<std::int64_t> queue_depth{0};
+    std::atomic<std::uint64_t> jobs_done{0}, jobs_failed{0};
+    std::atomic<std::uint64_t> chunks{0};               // transcribed (not from the checkpoint)
+    std::atomic<std::uint64_t> chunk_cache_hits{0};     // chunks reused from a checkpoint
+    std::atomic<std::uint64_t> chunk_cache_misses{0};
+    std::atomic<std::uint64_t> download_cache_hits{0};  // audio reused from an earlier run
+    std::atomic<std::uint64_t> download_cache_misses{0};
+    std::atomic<std::uint64_t> audio_ms{0};             // audio transcribed
+    std::atomic<std::uint64_t> model_loads{0}, model_load_us{0};
+    std::atomic<std::uint64_t> encoder_runs{0}, encoder_reduced{0}; // inference runs; with audio_ctx < 1500
+    std::atomic<std::uint64_t> encoder_positions{0}, encoder_full_positions{0}; // encoded vs at full context
+    std::atomic<std::uint64_t> errors[std::size_t(Stage::Count)] = {};
+};
+
+inline PipelineCounters &pipeline_counters()
+{
+    static PipelineCounters counters;
+    return counters;
+}
+
+inline void count_error(Stage s)
+{
+    pipeline_counters().errors[std::size_t(s)].fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Index of the run_workers worker running on this thread (0 outside a pool). */
+inline std::size_t &this_worker()
+{
+    thread_local std::size_t worker = 0;
+    return worker;
+}
+
+/* Records the wall time of its scope, in µs. */
+class StageTimer
+{
+public:
+    explicit StageTimer(Stage s) : stage_(s), t0_(std::chrono::steady_clock::now()) {}
+    ~StageTimer() { record_stage(stage_, elapsed_us()); }
+
+    std::uint64_t elapsed_us() const
+    {
+        return std::uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - t0_)
+                                 .count());
+    }
+
+private:
+    Stage stage_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+/* {"<stage>":{"unit":…,"count":…,"mean":…,"p50":…,"p90":…,"p99":…,"max":…},…}
+   Times are reported in ms, download throughput in bytes/s. */
+inline std::string latency_json()
+{
+    std::string out = "{";
+    for (std::size_t i = 0; i < std::size_t(Stage::Count); ++i)
+    {
+        const Stage s = Stage(i);
+        const auto h = stage_histogram(s).summary();
+        const bool rate = s == Stage::Download;
+        const double k = rate ? 1.0 : 1e-3;
+        char buf[320];
+        std::snprintf(buf, sizeof(buf),
+                      "%s\"%s\":{\"unit\":\"%s\",\"count\":%llu,\"mean\":%.3f,\"p50\":%.3f,"
+                      "\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+                      i ? "," : "", stage_name(s),
+                      rate ? "bytes/s" : s == Stage::Inference ? "ms per audio s" : "ms",
+                      static_cast<unsigned long long>(h.count), h.mean * k, h.p50 * k, h.p90 * k,
+                      h.p99 * k, double(h.max) * k);
+        out += buf;
+    }
+    return out + "}";
+}
@@ -0,0 +1,390 @@
+/*
+mp3_decoder.h – in-process MP3 decode stage (frame by frame → 16 kHz mono float)
+
+Introduction
+============
+Single header, no build flags, no libraries. The MP3 bitstream is walked here
+(ID3v2 skip, frame sync, header parsing) and each Layer III frame is decoded by
+mp3_layer3.h, so no host needs ffmpeg – or anything else – to decode a chunk.
+
+Each frame is decoded into a reusable float buffer and pushed straight through a
+fused downmix/resample step, so no intermediate stereo or full-rate copy of the
+audio is ever held:
+
+    ```cpp
+    #include "mp3_decoder.h"
+
+    Mp3Decoder dec;                           // 16 kHz mono output by default
+    std::vector<float> pcm;
+    if (dec.open("chunk_000.mp3"))
+        while (dec.decode_frame(pcm)) {}      // appends to pcm
+    if (dec.failed())
+        ...                                   // fall back to ffmpeg
+    ```
+
+`mp3_decode_file()` wraps the loop above. A stream the frame decoder does not
+handle (Layer I/II, intensity stereo) stops with failed() set, and the caller
+is expected to fall back to ffmpeg.
+
+Notes
+=====
+- Only Layer III / II / I frame headers are recognised; free-format streams are
+  rejected.
+- The Xing/Info/LAME frame produces no samples.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "mp3_layer3.h"
+#include "simd.h"
+
+/*───────────────────────────────────────────────────────────────
+  Frame header parsing (ISO 11172-3 / 13818-3)
+──────────────────────────────────────────────────────────────*/
+struct Mp3FrameHeader
+{
+    int version = 0;      // 1 = MPEG-1, 2 = MPEG-2, 25 = MPEG-2.5
+    int layer = 0;        // 1, 2 or 3
+    int bitrate_kbps = 0;
+    int sample_rate = 0;
+    int channels = 0;
+    int samples = 0;      // PCM samples per channel in this frame
+    int frame_bytes = 0;  // full frame length, header included
+};
+
+inline bool mp3_parse_header(const std::uint8_t *p, Mp3FrameHeader &h)
+{
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+        return false;
+
+    const int ver_bits = (p[1] >> 3) & 3;
+    const int layer_bits = (p[1] >> 1) & 3;
+    const int br_idx = (p[2] >> 4) & 15;
+    const int sr_idx = (p[2] >> 2) & 3;
+    const int padding = (p[2] >> 1) & 1;
+    const int mode = (p[3] >> 6) & 3;
+
+    if (ver_bits == 1 || layer_bits == 0 || br_idx == 0 || br_idx == 15 || sr_idx == 3)
+        return false;
+
+    static const int kBitrates[2][3][15] = {
+        {   // MPEG-1: layer I, II, III
+            {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+            {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+            {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+        },
+        {   // MPEG-2 / 2.5: layer I, II, III
+            {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+            {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+            {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+        },
+    };
+    static const int kRates[3] = {44100, 48000, 32000};
+
+    h.version = ver_bits == 3 ? 1 : (ver_bits == 2 ? 2 : 25);
+    h.layer = 4 - layer_bits;
+    h.bitrate_kbps = kBitrates[h.version == 1 ? 0 : 1][h.layer - 1][br_idx];
+    h.sample_rate = kRates[sr_idx] >> (h.version == 1 ? 0 : (h.version == 2 ? 1 : 2));
+    h.channels = mode == 3 ? 1 : 2;
+
+    if (h.layer == 1)
+    {
+        h.samples = 384;
+        h.frame_bytes = (12 * h.bitrate_kbps * 1000 / h.sample_rate + padding) * 4;
+    }
+    else
+    {
+        const bool lsf = h.layer == 3 && h.version != 1;
+        h.samples = lsf ? 576 : 1152;
+        h.frame_bytes = (lsf ? 72 : 144) * h.bitrate_kbps * 1000 / h.sample_rate + padding;
+    }
+    return h.frame_bytes > 4;
+}
+
+/* Size of a leading ID3v2 tag (0 if none). */
+inline std::size_t mp3_id3v2_size(const std::uint8_t *p, std::size_t n)
+{
+    if (n < 10 || std::memcmp(p, "ID3", 3) != 0)
+        return 0;
+    const std::size_t body = (std::size_t(p[6] & 0x7F) << 21) | (std::size_t(p[7] & 0x7F) << 14) |
+                             (std::size_t(p[8] & 0x7F) << 7) | std::size_t(p[9] & 0x7F);
+    return 10 + body + ((p[5] & 0x10) ? 10 : 0);
+}
+
+/*───────────────────────────────────────────────────────────────
+  Fused downmix + polyphase windowed-sinc resampler
+──────────────────────────────────────────────────────────────*/
+class StreamResampler
+{
+public:
+    void reset(int in_rate, int channels, int out_rate)
+    {
+        in_rate_ = in_rate;
+        out_rate_ = out_rate;
+        channels_ = std::max(1, channels);
+        k_ = &simd();
+
+        const int g = gcd(in_rate, out_rate);
+        L_ = out_rate / g;
+        M_ = in_rate / g;
+
+        coeffs_.assign(std::size_t(L_) * kTaps, 0.0f);
+        const double cutoff = 0.45 * std::min(1.0, double(out_rate) / in_rate);
+        for (int p = 0; p < L_; ++p)
+        {
+            const double frac = double(p) / L_;
+            double sum = 0.0;
+            for (int k = 0; k < kTaps; ++k)
+            {
+                const double t = (k - (kTaps / 2 - 1)) - frac;
+                const double x = 2.0 * cutoff * t;
+                const double sinc = std::abs(x) < 1e-9 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+                const double w = 0.5 + 0.5 * std::cos(M_PI * t / (kTaps / 2)); // Hann
+                coeffs_[std::size_t(p) * kTaps + k] = float(sinc * w);
+                sum += sinc * w;
+            }
+            for (int k = 0; k < kTaps; ++k)
+                coeffs_[std::size_t(p) * kTaps + k] = float(coeffs_[std::size_t(p) * kTaps + k] / sum);
+        }
+
+        hist_.assign(kTaps / 2 - 1, 0.0f);
+        ipos_ = 0;
+        phase_ = 0;
+        in_total_ = 0;
+        out_total_ = 0;
+    }
+
+    /* Downmix `frames` interleaved frames into the history and emit every
+       output sample that is fully covered by the filter. */
+    void push(const float *interleaved, std::size_t frames, std::vector<float> &out)
+    {
+        const float gain = 1.0f / channels_;
+        if (L_ == 1 && M_ == 1)
+        {
+            /* Pass-through: skip the filter, just hand over the downmix. */
+            const std::size_t base = out.size();
+            out.resize(base + frames);
+            k_->downmix(interleaved, frames, channels_, gain, out.data() + base);
+            return;
+        }
+
+        const std::size_t base = hist_.size();
+        hist_.resize(base + frames);
+        k_->downmix(interleaved, frames, channels_, gain, hist_.data() + base);
+        in_total_ += frames;
+        drain(out, false);
+    }
+
+    void flush(std::vector<float> &out)
+    {
+        if (L_ == 1 && M_ == 1)
+            return;
+        hist_.resize(hist_.size() + kTaps, 0.0f);
+        drain(out, true);
+    }
+
+private:
+    static constexpr int kTaps = 32;
+
+    static int gcd(int a, int b) { return b ? gcd(b, a % b) : a; }
+
+    void drain(std::vector<float> &out, bool final)
+    {
+        const std::uint64_t limit = (in_total_ * std::uint64_t(L_) + M_ - 1) / M_;
+        while (ipos_ + kTaps <= hist_.size() && (!final || out_total_ < limit))
+        {
+            out.push_back(k_->dot(hist_.data() + ipos_, coeffs_.data() + std::size_t(phase_) * kTaps, kTaps));
+            ++out_total_;
+
+            phase_ += M_;
+            ipos_ += phase_ / L_;
+            phase_ %= L_;
+        }
+        compact();
+    }
+
+    void compact()
+    {
+        if (ipos_ < (1u << 16))
+            return;
+        hist_.erase(hist_.begin(), hist_.begin() + ipos_);
+        ipos_ = 0;
+    }
+
+    int in_rate_ = 0, out_rate_ = 0, channels_ = 1;
+    int L_ = 1, M_ = 1, phase_ = 0;
+    std::vector<float> coeffs_;
+    std::vector<float> hist_;
+    std::size_t ipos_ = 0;
+    std::uint64_t in_total_ = 0, out_total_ = 0;
+    const SimdKernels *k_ = &simd();
+};
+
+/*───────────────────────────────────────────────────────────────
+  Mp3Decoder – buffered file reader + per-frame decode
+──────────────────────────────────────────────────────────────*/
+class Mp3Decoder
+{
+public:
+    explicit Mp3Decoder(int out_rate = 16000) : out_rate_(out_rate) {}
+    ~Mp3Decoder() { close(); }
+
+    Mp3Decoder(const Mp3Decoder &) = delete;
+    Mp3Decoder &operator=(const Mp3Decoder &) = delete;
+
+    /* Open `path`, optionally restricted to the byte range [begin, end) –
+       e.g. a chunk described by a FrameIndex (frame_index.h). */
+    bool open(const std::string &path, std::uint64_t begin = 0, std::uint64_t end = ~std::uint64_t(0))
+    {
+        close();
+        in_.open(path, std::ios::binary);
+        if (!in_ || !in_.seekg(std::streamoff(begin)))
+            return false;
+        remaining_ = end - begin;
+        layer3_.reset();
+
+        buf_.resize(kReadSize * 2);
+        pos_ = len_ = 0;
+        fill();
+        if (begin == 0)
+            pos_ = std::min(len_, mp3_id3v2_size(buf_.data(), len_));
+        rate_ = channels_ = 0;
+        eof_ = failed_ = false;
+        synced_ = false;
+        open_ = true;
+        return true;
+    }
+
+    void close()
+    {
+        open_ = false;
+        in_.close();
+    }
+
+    /* Decode one MP3 frame and append its resampled mono samples to `out`.
+       Returns false once the stream is exhausted (after flushing the filter)
+       or on a frame the decoder does not handle, which also sets failed(). */
+    bool decode_frame(std::vector<float> &out)
+    {
+        if (!open_ || eof_)
+            return false;
+
+        Mp3FrameHeader hdr;
+        const std::uint8_t *frame = next_frame(hdr);
+        int frames = 0;
+        if (frame && !layer3_.decode(frame, std::size_t(hdr.frame_bytes), pcm_, frames))
+            failed_ = true;
+        if (!frame || failed_)
+        {
+            if (rate_)
+                resampler_.flush(out);
+            eof_ = true;
+            return false;
+        }
+        if (hdr.sample_rate != rate_ || hdr.channels != channels_)
+        {
+            if (rate_)
+                resampler_.flush(out);
+            rate_ = hdr.sample_rate;
+            channels_ = hdr.channels;
+            resampler_.reset(rate_, channels_, out_rate_);
+        }
+        if (frames)
+            resampler_.push(pcm_, std::size_t(frames), out);
+        return true;
+    }
+
+    bool failed() const { return failed_; }
+    int source_rate() const { return rate_; }
+    int source_channels() const { return channels_; }
+
+private:
+    static constexpr std::size_t kReadSize = 1 << 16;
+
+    void fill()
+    {
+        if (pos_ > 0)
+        {
+            std::memmove(buf_.data(), buf_.data() + pos_, len_ - pos_);
+            len_ -= pos_;
+            pos_ = 0;
+        }
+        const std::size_t want = std::size_t(std::min<std::uint64_t>(buf_.size() - len_, remaining_));
+        in_.read(reinterpret_cast<char *>(buf_.data() + len_), std::streamsize(want));
+        const std::size_t got = std::size_t(in_.gcount());
+        len_ += got;
+        remaining_ -= got;
+    }
+
+    bool more() const { return in_ && remaining_ > 0; }
+
+    /* Locate the next valid frame (resyncing over junk) and return a pointer
+       to it; `hdr` receives the parsed header. */
+    const std::uint8_t *next_frame(Mp3FrameHeader &hdr)
+    {
+        for (;;)
+        {
+            if (len_ - pos_ < kReadSize / 2 && more())
+                fill();
+            if (len_ - pos_ < 4)
+                return nullptr;
+
+            const std::uint8_t *p = buf_.data() + pos_;
+            const std::size_t avail = len_ - pos_;
+            if (mp3_parse_header(p, hdr))
+            {
+                const std::size_t n = std::size_t(hdr.frame_bytes);
+                if (n > avail && !more())
+                    return nullptr; // truncated final frame
+
+                /* While hunting for sync, only trust a header that is followed
+                   by another one with the same rate (or by the end of data). */
+                Mp3FrameHeader next;
+                if (n <= avail && (synced_ || avail < n + 4 ||
+                                   (mp3_parse_header(p + n, next) && next.sample_rate == hdr.sample_rate)))
+                {
+                    synced_ = true;
+                    pos_ += n;
+                    return p;
+                }
+            }
+            synced_ = false;
+            ++pos_;
+        }
+    }
+
+    int out_rate_;
+    int rate_ = 0, channels_ = 0;
+    bool eof_ = false, failed_ = false;
+    bool synced_ = false;
+    bool open_ = false;
+    std::ifstream in_;
+    std::vector<std::uint8_t> buf_;
+    std::size_t pos_ = 0, len_ = 0;
+    std::uint64_t remaining_ = 0;
+    Mp3Layer3Decoder layer3_;
+    float pcm_[Mp3Layer3Decoder::kMaxFrameSamples * 2]; // reusable per-frame output, interleaved
+    StreamResampler resampler_;
+};
+
+/* Decode a whole MP3 file to mono float at `out_rate`. */
+inline bool mp3_decode_file(const std::string &path, std::vector<float> &pcm, int out_rate = 16000)
+{
+    Mp3Decoder dec(out_rate);
+    if (!dec.open(path))
+        return false;
+    pcm.clear();
+    while (dec.decode_frame(pcm))
+    {
+    }
+    return dec.source_rate() != 0 && !dec.failed();
+}
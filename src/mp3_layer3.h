@@ -0,0 +1,880 @@
+/*
+mp3_layer3.h – MPEG-1/2/2.5 Layer III frame decoder, no dependencies
+
+Introduction
+============
+Turns one Layer III frame at a time into float PCM in [-1, 1]. It has no
+library dependency and no build flags, so every host decodes MP3 in-process;
+mp3_decoder.h finds the frames and feeds them in:
+
+    ```cpp
+    #include "mp3_layer3.h"
+
+    Mp3Layer3Decoder dec;
+    float pcm[1152 * 2];                       // interleaved, one frame
+    int frames = 0;                            // per channel
+    if (!dec.decode(frame, frame_bytes, pcm, frames))
+        ...                                    // not a frame we decode: fall back
+    ```
+
+The bit reservoir (main_data_begin) is kept across calls. A frame whose main
+data reaches back past what the decoder has seen – the first frames after
+opening mid-stream – comes out as silence of the right length, which is what
+the pre-roll in frame_index.h is there to absorb. A corrupt frame is silence
+too; the stream carries on with the next one.
+
+The stages follow ISO 11172-3 / 13818-3 clause 2.4.3.4: Huffman decode,
+requantisation, short-block reordering, mid/side stereo, alias reduction,
+IMDCT with overlap-add and the polyphase synthesis filterbank. The tables
+are those of the standard's Annex B; the Huffman tables are listed in code
+order as (length, value) pairs and the codes rebuilt from them at first use.
+
+Notes
+=====
+- Intensity stereo and Layer I/II frames are rejected (decode() returns
+  false) so the caller can hand the stream to ffmpeg. Encoders producing
+  speech-rate MP3 (LAME, ffmpeg) use mid/side only.
+- A Xing/Info/VBRI tag frame produces no samples.
+- Output is not gapless: encoder delay and padding are kept, as ffmpeg
+  -ar 16000 would keep them for a stream cut from the middle of a file.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "simd.h"
+
+namespace mp3_detail
+{
+/*───────────────────────────────────────────────────────────────
+  Tables (ISO 11172-3 Annex B, ISO 13818-3 for the half rates)
+──────────────────────────────────────────────────────────────*/
+
+/* Huffman tables 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 15, 16 and 24 in
+   code order; value = x << 4 | y. Code lengths and values concatenated. */
+constexpr int kHuffTables = 15;
+constexpr std::uint16_t kHuffSize[kHuffTables] = {4, 9, 9, 16, 16, 36, 36, 36, 64, 64, 64, 256, 256, 256, 256};
+
+constexpr std::uint8_t kHuffLen[1378] = {
+    3, 3, 2, 1, 6, 6, 5, 5, 5, 3, 3, 3, 1, 6, 6, 5, 5, 5, 3, 2, 2, 2, 8, 8,
+    7, 6, 7, 7, 7, 7, 6, 6, 6, 6, 3, 3, 3, 1, 7, 7, 6, 6, 6, 5, 5, 5, 5, 4,
+    4, 4, 3, 2, 3, 3, 10, 10, 10, 10, 9, 9, 9, 9, 8, 8, 9, 9, 8, 9, 9, 8, 8, 7,
+    7, 7, 8, 8, 8, 8, 7, 7, 7, 7, 6, 5, 6, 6, 4, 3, 3, 1, 11, 11, 10, 9, 10, 10,
+    9, 9, 9, 8, 8, 9, 9, 9, 9, 8, 8, 8, 7, 8, 8, 8, 8, 8, 8, 8, 8, 6, 6, 6,
+    4, 4, 2, 3, 3, 2, 9, 9, 8, 8, 9, 9, 8, 8, 8, 8, 7, 7, 7, 8, 8, 7, 7, 7,
+    7, 6, 6, 6, 6, 5, 5, 6, 6, 5, 5, 4, 4, 4, 3, 3, 3, 3, 11, 11, 11, 11, 11, 11,
+    10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 9, 9, 10, 10, 9, 9, 10, 10, 9, 10, 10, 8, 8, 9,
+    9, 10, 10, 9, 9, 10, 10, 8, 8, 8, 9, 9, 9, 9, 9, 9, 8, 8, 8, 8, 8, 8, 7, 7,
+    7, 7, 6, 6, 6, 6, 4, 3, 3, 1, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 9, 9, 9,
+    10, 10, 10, 10, 8, 8, 9, 9, 7, 8, 8, 8, 8, 8, 9, 9, 9, 9, 8, 7, 8, 8, 7, 7,
+    8, 8, 8, 9, 9, 8, 8, 8, 8, 8, 8, 7, 7, 6, 6, 7, 7, 6, 5, 4, 5, 5, 3, 3,
+    3, 2, 10, 10, 9, 9, 9, 9, 9, 9, 9, 8, 8, 9, 9, 8, 8, 8, 8, 8, 8, 9, 9, 8,
+    8, 8, 8, 8, 9, 9, 7, 7, 7, 8, 8, 8, 8, 8, 8, 7, 7, 7, 7, 8, 8, 7, 7, 7,
+    6, 6, 6, 6, 7, 7, 6, 5, 5, 5, 4, 4, 5, 5, 4, 3, 3, 3, 19, 19, 18, 17, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 15, 15, 16, 16, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    16, 16, 15, 16, 16, 14, 14, 15, 15, 15, 15, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 15, 15,
+    14, 13, 14, 14, 13, 13, 14, 14, 13, 14, 14, 13, 14, 14, 13, 14, 14, 13, 13, 14, 14, 12, 12, 12,
+    13, 13, 13, 13, 13, 13, 12, 13, 13, 12, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12,
+    12, 13, 13, 12, 12, 12, 12, 13, 13, 13, 13, 12, 13, 13, 12, 11, 12, 12, 12, 12, 12, 12, 12, 12,
+    11, 11, 11, 11, 12, 12, 11, 11, 12, 12, 11, 12, 12, 12, 12, 11, 11, 12, 12, 11, 12, 12, 11, 12,
+    12, 11, 12, 12, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11, 10, 10, 10, 10, 11, 11, 10, 11, 11,
+    10, 11, 11, 11, 11, 10, 10, 11, 11, 10, 10, 11, 11, 11, 11, 11, 11, 9, 9, 10, 10, 10, 10, 10,
+    11, 11, 9, 9, 9, 10, 10, 9, 9, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 8, 9, 9, 9, 9,
+    9, 9, 10, 10, 9, 9, 9, 8, 8, 9, 9, 9, 9, 9, 9, 8, 7, 8, 8, 8, 8, 7, 7, 7,
+    7, 7, 6, 6, 6, 6, 4, 4, 3, 1, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 12, 13, 13,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 13,
+    13, 11, 11, 12, 12, 12, 12, 11, 11, 11, 11, 11, 11, 12, 12, 11, 11, 11, 11, 11, 11, 11, 11, 12,
+    12, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 12, 12, 11, 11, 11, 11, 11, 11, 10, 11, 11, 11, 11, 11, 11, 10, 10, 11, 11, 10, 10, 10,
+    10, 11, 11, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10, 10, 11, 11, 9, 10, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 9, 10, 10, 10, 10, 9, 10, 10, 9, 10, 10, 10, 10, 10, 10, 10,
+    10, 9, 9, 9, 9, 9, 9, 9, 10, 10, 9, 9, 9, 9, 9, 9, 10, 10, 9, 9, 9, 9, 9, 9,
+    8, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9, 8,
+    8, 8, 8, 8, 8, 9, 9, 8, 8, 8, 8, 8, 8, 8, 9, 9, 8, 7, 8, 8, 7, 7, 7, 7,
+    8, 8, 7, 7, 7, 7, 7, 6, 7, 7, 6, 6, 7, 7, 6, 6, 6, 5, 5, 5, 5, 5, 3, 4,
+    4, 3, 11, 11, 11, 11, 11, 11, 11, 11, 10, 11, 11, 11, 11, 10, 10, 10, 10, 10, 8, 10, 10, 9,
+    9, 9, 9, 10, 16, 17, 17, 15, 15, 16, 16, 14, 15, 15, 14, 14, 15, 15, 14, 14, 15, 15, 15, 15,
+    14, 15, 15, 14, 13, 8, 9, 9, 8, 8, 13, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 13, 13, 14,
+    14, 14, 14, 13, 14, 14, 13, 13, 13, 14, 14, 14, 14, 13, 13, 14, 14, 13, 14, 14, 12, 13, 13, 13,
+    13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 12, 13, 13, 12, 12, 13,
+    13, 11, 12, 12, 12, 12, 12, 12, 12, 13, 13, 11, 12, 12, 12, 12, 11, 12, 12, 12, 12, 12, 12, 12,
+    12, 11, 12, 12, 11, 11, 11, 11, 12, 12, 12, 12, 12, 12, 12, 12, 11, 12, 12, 11, 12, 12, 11, 12,
+    12, 11, 12, 12, 11, 10, 10, 11, 11, 11, 11, 11, 11, 10, 10, 11, 11, 10, 10, 11, 11, 11, 11, 11,
+    11, 11, 11, 10, 11, 11, 10, 10, 10, 11, 11, 10, 10, 11, 11, 10, 10, 11, 11, 10, 9, 9, 10, 10,
+    10, 10, 10, 10, 9, 9, 9, 10, 10, 9, 10, 10, 9, 9, 8, 9, 9, 9, 9, 9, 9, 9, 9, 8,
+    8, 9, 9, 8, 8, 7, 7, 8, 8, 7, 6, 6, 6, 6, 4, 4, 3, 1, 8, 8, 8, 8, 8, 8,
+    8, 8, 7, 8, 8, 7, 7, 8, 8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 9,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 4, 11, 11, 11, 11, 12, 12, 11, 10, 11, 11, 10, 10, 10, 10, 11, 11, 10, 10, 10,
+    10, 11, 11, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 11, 11, 10, 9, 10, 10, 10, 10, 11, 11, 10, 9,
+    9, 10, 10, 9, 10, 10, 10, 10, 9, 9, 10, 10, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+    10, 10, 9, 9, 9, 10, 10, 8, 9, 9, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 9,
+    9, 8, 8, 8, 8, 8, 8, 9, 9, 7, 8, 8, 7, 7, 7, 7, 7, 8, 8, 7, 7, 6, 6, 7,
+    7, 6, 5, 5, 6, 6, 4, 4, 4, 4,
+};
+
+constexpr std::uint8_t kHuffSym[1378] = {
+    0x11, 0x01, 0x10, 0x00, 0x22, 0x02, 0x12, 0x21, 0x20, 0x11, 0x01, 0x10, 0x00, 0x22, 0x02, 0x12,
+    0x21, 0x20, 0x10, 0x11, 0x01, 0x00, 0x33, 0x23, 0x32, 0x31, 0x13, 0x03, 0x30, 0x22, 0x12, 0x21,
+    0x02, 0x20, 0x11, 0x01, 0x10, 0x00, 0x33, 0x03, 0x23, 0x32, 0x30, 0x13, 0x31, 0x22, 0x02, 0x12,
+    0x21, 0x20, 0x01, 0x11, 0x10, 0x00, 0x55, 0x45, 0x54, 0x53, 0x35, 0x44, 0x25, 0x52, 0x15, 0x51,
+    0x05, 0x34, 0x50, 0x43, 0x33, 0x24, 0x42, 0x14, 0x41, 0x40, 0x04, 0x23, 0x32, 0x03, 0x13, 0x31,
+    0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00, 0x55, 0x54, 0x45, 0x53, 0x35, 0x44,
+    0x25, 0x52, 0x05, 0x15, 0x51, 0x34, 0x43, 0x50, 0x33, 0x24, 0x42, 0x14, 0x41, 0x04, 0x40, 0x23,
+    0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x02, 0x20, 0x12, 0x21, 0x11, 0x01, 0x10, 0x00, 0x55, 0x45,
+    0x35, 0x53, 0x54, 0x05, 0x44, 0x25, 0x52, 0x15, 0x51, 0x34, 0x43, 0x50, 0x04, 0x24, 0x42, 0x33,
+    0x40, 0x14, 0x41, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x02, 0x12, 0x21, 0x20, 0x11, 0x01,
+    0x10, 0x00, 0x77, 0x67, 0x76, 0x57, 0x75, 0x66, 0x47, 0x74, 0x56, 0x65, 0x37, 0x73, 0x46, 0x55,
+    0x54, 0x63, 0x27, 0x72, 0x64, 0x07, 0x70, 0x62, 0x45, 0x35, 0x06, 0x53, 0x44, 0x17, 0x71, 0x36,
+    0x26, 0x25, 0x52, 0x15, 0x51, 0x34, 0x43, 0x16, 0x61, 0x60, 0x05, 0x50, 0x24, 0x42, 0x33, 0x04,
+    0x14, 0x41, 0x40, 0x23, 0x32, 0x03, 0x13, 0x31, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01,
+    0x10, 0x00, 0x77, 0x67, 0x76, 0x75, 0x66, 0x47, 0x74, 0x57, 0x55, 0x56, 0x65, 0x37, 0x73, 0x46,
+    0x45, 0x54, 0x35, 0x53, 0x27, 0x72, 0x64, 0x07, 0x71, 0x17, 0x70, 0x36, 0x63, 0x60, 0x44, 0x25,
+    0x52, 0x05, 0x15, 0x62, 0x26, 0x06, 0x16, 0x61, 0x51, 0x34, 0x50, 0x43, 0x33, 0x24, 0x42, 0x14,
+    0x41, 0x04, 0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x21, 0x12, 0x02, 0x20, 0x11, 0x01,
+    0x10, 0x00, 0x77, 0x67, 0x76, 0x57, 0x75, 0x66, 0x47, 0x74, 0x65, 0x56, 0x37, 0x73, 0x55, 0x27,
+    0x72, 0x46, 0x64, 0x17, 0x71, 0x07, 0x70, 0x36, 0x63, 0x45, 0x54, 0x44, 0x06, 0x05, 0x26, 0x62,
+    0x61, 0x16, 0x60, 0x35, 0x53, 0x25, 0x52, 0x15, 0x51, 0x34, 0x43, 0x50, 0x04, 0x24, 0x42, 0x14,
+    0x33, 0x41, 0x23, 0x32, 0x40, 0x03, 0x30, 0x13, 0x31, 0x22, 0x12, 0x21, 0x02, 0x20, 0x00, 0x11,
+    0x01, 0x10, 0xfe, 0xfc, 0xfd, 0xed, 0xff, 0xef, 0xdf, 0xee, 0xcf, 0xde, 0xbf, 0xfb, 0xce, 0xdc,
+    0xaf, 0xe9, 0xec, 0xdd, 0xfa, 0xcd, 0xbe, 0xeb, 0x9f, 0xf9, 0xea, 0xbd, 0xdb, 0x8f, 0xf8, 0xcc,
+    0xae, 0x9e, 0x8e, 0x7f, 0x7e, 0xf7, 0xda, 0xad, 0xbc, 0xcb, 0xf6, 0x6f, 0xe8, 0x5f, 0x9d, 0xd9,
+    0xf5, 0xe7, 0xac, 0xbb, 0x4f, 0xf4, 0xca, 0xe6, 0xf3, 0x3f, 0x8d, 0xd8, 0x2f, 0xf2, 0x6e, 0x9c,
+    0x0f, 0xc9, 0x5e, 0xab, 0x7d, 0xd7, 0x4e, 0xc8, 0xd6, 0x3e, 0xb9, 0x9b, 0xaa, 0x1f, 0xf1, 0xf0,
+    0xba, 0xe5, 0xe4, 0x8c, 0x6d, 0xe3, 0xe2, 0x2e, 0x0e, 0x1e, 0xe1, 0xe0, 0x5d, 0xd5, 0x7c, 0xc7,
+    0x4d, 0x8b, 0xb8, 0xd4, 0x9a, 0xa9, 0x6c, 0xc6, 0x3d, 0xd3, 0x7b, 0x2d, 0xd2, 0x1d, 0xb7, 0x5c,
+    0xc5, 0x99, 0x7a, 0xc3, 0xa7, 0x97, 0x4b, 0xd1, 0x0d, 0xd0, 0x8a, 0xa8, 0x4c, 0xc4, 0x6b, 0xb6,
+    0x3c, 0x2c, 0xc2, 0x5b, 0xb5, 0x89, 0x1c, 0xc1, 0x98, 0x0c, 0xc0, 0xb4, 0x6a, 0xa6, 0x79, 0x3b,
+    0xb3, 0x88, 0x5a, 0x2b, 0xa5, 0x69, 0xa4, 0x78, 0x87, 0x94, 0x77, 0x76, 0xb2, 0x1b, 0xb1, 0x0b,
+    0xb0, 0x96, 0x4a, 0x3a, 0xa3, 0x59, 0x95, 0x2a, 0xa2, 0x1a, 0xa1, 0x0a, 0x68, 0xa0, 0x86, 0x49,
+    0x93, 0x39, 0x58, 0x85, 0x67, 0x29, 0x92, 0x57, 0x75, 0x38, 0x83, 0x66, 0x47, 0x74, 0x56, 0x65,
+    0x73, 0x19, 0x91, 0x09, 0x90, 0x48, 0x84, 0x72, 0x46, 0x64, 0x28, 0x82, 0x18, 0x37, 0x27, 0x17,
+    0x71, 0x55, 0x07, 0x70, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x35, 0x81, 0x08, 0x80, 0x16, 0x61,
+    0x06, 0x60, 0x53, 0x44, 0x25, 0x52, 0x05, 0x15, 0x51, 0x34, 0x43, 0x50, 0x24, 0x42, 0x33, 0x14,
+    0x41, 0x04, 0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01,
+    0x10, 0x00, 0xff, 0xef, 0xfe, 0xdf, 0xee, 0xfd, 0xcf, 0xfc, 0xde, 0xed, 0xbf, 0xfb, 0xce, 0xec,
+    0xdd, 0xaf, 0xfa, 0xbe, 0xeb, 0xcd, 0xdc, 0x9f, 0xf9, 0xea, 0xbd, 0xdb, 0x8f, 0xf8, 0xcc, 0x9e,
+    0xe9, 0x7f, 0xf7, 0xad, 0xda, 0xbc, 0x6f, 0xae, 0x0f, 0xcb, 0xf6, 0x8e, 0xe8, 0x5f, 0x9d, 0xf5,
+    0x7e, 0xe7, 0xac, 0xca, 0xbb, 0xd9, 0x8d, 0x4f, 0xf4, 0x3f, 0xf3, 0xd8, 0xe6, 0x2f, 0xf2, 0x6e,
+    0xf0, 0x1f, 0xf1, 0x9c, 0xc9, 0x5e, 0xab, 0xba, 0xe5, 0x7d, 0xd7, 0x4e, 0xe4, 0x8c, 0xc8, 0x3e,
+    0x6d, 0xd6, 0xe3, 0x9b, 0xb9, 0x2e, 0xaa, 0xe2, 0x1e, 0xe1, 0x0e, 0xe0, 0x5d, 0xd5, 0x7c, 0xc7,
+    0x4d, 0x8b, 0xd4, 0xb8, 0x9a, 0xa9, 0x6c, 0xc6, 0x3d, 0xd3, 0xd2, 0x2d, 0x0d, 0x1d, 0x7b, 0xb7,
+    0xd1, 0x5c, 0xd0, 0xc5, 0x8a, 0xa8, 0x4c, 0xc4, 0x6b, 0xb6, 0x99, 0x0c, 0x3c, 0xc3, 0x7a, 0xa7,
+    0xa6, 0xc0, 0x0b, 0xc2, 0x2c, 0x5b, 0xb5, 0x1c, 0x89, 0x98, 0xc1, 0x4b, 0xb4, 0x6a, 0x3b, 0x79,
+    0xb3, 0x97, 0x88, 0x2b, 0x5a, 0xb2, 0xa5, 0x1b, 0xb1, 0xb0, 0x69, 0x96, 0x4a, 0xa4, 0x78, 0x87,
+    0x3a, 0xa3, 0x59, 0x95, 0x2a, 0xa2, 0x1a, 0xa1, 0x0a, 0xa0, 0x68, 0x86, 0x49, 0x94, 0x39, 0x93,
+    0x77, 0x09, 0x58, 0x85, 0x29, 0x67, 0x76, 0x92, 0x91, 0x19, 0x90, 0x48, 0x84, 0x57, 0x75, 0x38,
+    0x83, 0x66, 0x47, 0x28, 0x82, 0x18, 0x81, 0x74, 0x08, 0x80, 0x56, 0x65, 0x37, 0x73, 0x46, 0x27,
+    0x72, 0x64, 0x17, 0x55, 0x71, 0x07, 0x70, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x16, 0x06, 0x60,
+    0x35, 0x61, 0x53, 0x44, 0x25, 0x52, 0x15, 0x51, 0x05, 0x50, 0x34, 0x43, 0x24, 0x42, 0x33, 0x41,
+    0x14, 0x04, 0x23, 0x32, 0x40, 0x03, 0x13, 0x31, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01,
+    0x10, 0x00, 0xef, 0xfe, 0xdf, 0xfd, 0xcf, 0xfc, 0xbf, 0xfb, 0xaf, 0xfa, 0x9f, 0xf9, 0xf8, 0x8f,
+    0x7f, 0xf7, 0x6f, 0xf6, 0xff, 0x5f, 0xf5, 0x4f, 0xf4, 0xf3, 0xf0, 0x3f, 0xce, 0xec, 0xdd, 0xde,
+    0xe9, 0xea, 0xd9, 0xee, 0xed, 0xeb, 0xbe, 0xcd, 0xdc, 0xdb, 0xae, 0xcc, 0xad, 0xda, 0x7e, 0xac,
+    0xca, 0xc9, 0x7d, 0x5e, 0xbd, 0xf2, 0x2f, 0x0f, 0x1f, 0xf1, 0x9e, 0xbc, 0xcb, 0x8e, 0xe8, 0x9d,
+    0xe7, 0xbb, 0x8d, 0xd8, 0x6e, 0xe6, 0x9c, 0xab, 0xba, 0xe5, 0xd7, 0x4e, 0xe4, 0x8c, 0xc8, 0x3e,
+    0x6d, 0xd6, 0x9b, 0xb9, 0xaa, 0xe1, 0xd4, 0xb8, 0xa9, 0x7b, 0xb7, 0xd0, 0xe3, 0x0e, 0xe0, 0x5d,
+    0xd5, 0x7c, 0xc7, 0x4d, 0x8b, 0x9a, 0x6c, 0xc6, 0x3d, 0x5c, 0xc5, 0x0d, 0x8a, 0xa8, 0x99, 0x4c,
+    0xb6, 0x7a, 0x3c, 0x5b, 0x89, 0x1c, 0xc0, 0x98, 0x79, 0xe2, 0x2e, 0x1e, 0xd3, 0x2d, 0xd2, 0xd1,
+    0x3b, 0x97, 0x88, 0x1d, 0xc4, 0x6b, 0xc3, 0xa7, 0x2c, 0xc2, 0xb5, 0xc1, 0x0c, 0x4b, 0xb4, 0x6a,
+    0xa6, 0xb3, 0x5a, 0xa5, 0x2b, 0xb2, 0x1b, 0xb1, 0x0b, 0xb0, 0x69, 0x96, 0x4a, 0xa4, 0x78, 0x87,
+    0xa3, 0x3a, 0x59, 0x2a, 0x95, 0x68, 0xa1, 0x86, 0x77, 0x94, 0x49, 0x57, 0x67, 0xa2, 0x1a, 0x0a,
+    0xa0, 0x39, 0x93, 0x58, 0x85, 0x29, 0x92, 0x76, 0x09, 0x19, 0x91, 0x90, 0x48, 0x84, 0x75, 0x38,
+    0x83, 0x66, 0x28, 0x82, 0x47, 0x74, 0x18, 0x81, 0x80, 0x08, 0x56, 0x37, 0x73, 0x65, 0x46, 0x27,
+    0x72, 0x64, 0x55, 0x07, 0x17, 0x71, 0x70, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x16, 0x61, 0x06,
+    0x60, 0x53, 0x35, 0x44, 0x25, 0x52, 0x51, 0x15, 0x05, 0x34, 0x43, 0x50, 0x24, 0x42, 0x33, 0x14,
+    0x41, 0x04, 0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01,
+    0x10, 0x00, 0xef, 0xfe, 0xdf, 0xfd, 0xcf, 0xfc, 0xbf, 0xfb, 0xfa, 0xaf, 0x9f, 0xf9, 0xf8, 0x8f,
+    0x7f, 0xf7, 0x6f, 0xf6, 0x5f, 0xf5, 0x4f, 0xf4, 0x3f, 0xf3, 0x2f, 0xf2, 0xf1, 0x1f, 0xf0, 0x0f,
+    0xee, 0xde, 0xed, 0xce, 0xec, 0xdd, 0xbe, 0xeb, 0xcd, 0xdc, 0xae, 0xea, 0xbd, 0xdb, 0xcc, 0x9e,
+    0xe9, 0xad, 0xda, 0xbc, 0xcb, 0x8e, 0xe8, 0x9d, 0xd9, 0x7e, 0xe7, 0xac, 0xff, 0xca, 0xbb, 0x8d,
+    0xd8, 0x0e, 0xe0, 0x0d, 0xe6, 0x6e, 0x9c, 0xc9, 0x5e, 0xba, 0xe5, 0xab, 0x7d, 0xd7, 0xe4, 0x8c,
+    0xc8, 0x4e, 0x2e, 0x3e, 0x6d, 0xd6, 0xe3, 0x9b, 0xb9, 0xaa, 0xe2, 0x1e, 0xe1, 0x5d, 0xd5, 0x7c,
+    0xc7, 0x4d, 0x8b, 0xb8, 0xd4, 0x9a, 0xa9, 0x6c, 0xc6, 0x3d, 0xd3, 0x2d, 0xd2, 0x1d, 0x7b, 0xb7,
+    0xd1, 0x5c, 0xc5, 0x8a, 0xa8, 0x99, 0x4c, 0xc4, 0x6b, 0xb6, 0xd0, 0x0c, 0x3c, 0xc3, 0x7a, 0xa7,
+    0x2c, 0xc2, 0x5b, 0xb5, 0x1c, 0x89, 0x98, 0xc1, 0x4b, 0xc0, 0x0b, 0x3b, 0xb0, 0x0a, 0x1a, 0xb4,
+    0x6a, 0xa6, 0x79, 0x97, 0xa0, 0x09, 0x90, 0xb3, 0x88, 0x2b, 0x5a, 0xb2, 0xa5, 0x1b, 0xb1, 0x69,
+    0x96, 0xa4, 0x4a, 0x78, 0x87, 0x3a, 0xa3, 0x59, 0x95, 0x2a, 0xa2, 0xa1, 0x68, 0x86, 0x77, 0x49,
+    0x94, 0x39, 0x93, 0x58, 0x85, 0x29, 0x67, 0x76, 0x92, 0x19, 0x91, 0x48, 0x84, 0x57, 0x75, 0x38,
+    0x83, 0x66, 0x28, 0x82, 0x18, 0x47, 0x74, 0x81, 0x08, 0x80, 0x56, 0x65, 0x17, 0x07, 0x70, 0x73,
+    0x37, 0x27, 0x72, 0x46, 0x64, 0x55, 0x71, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x16, 0x61, 0x06,
+    0x60, 0x35, 0x53, 0x44, 0x25, 0x52, 0x15, 0x05, 0x50, 0x51, 0x34, 0x43, 0x24, 0x42, 0x33, 0x14,
+    0x41, 0x04, 0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01,
+    0x10, 0x00,
+};
+/* table_select → {Huffman table above (1-based, 0 = all zero), linbits} */
+constexpr std::uint8_t kHuffSelect[32][2] = {
+    {0, 0},  {1, 0},  {2, 0},  {3, 0},  {0, 0},  {4, 0},  {5, 0},  {6, 0},  {7, 0},  {8, 0},  {9, 0},
+    {10, 0}, {11, 0}, {12, 0}, {0, 0},  {13, 0}, {14, 1}, {14, 2}, {14, 3}, {14, 4}, {14, 6}, {14, 8},
+    {14, 10}, {14, 13}, {15, 4}, {15, 5}, {15, 6}, {15, 7}, {15, 8}, {15, 9}, {15, 11}, {15, 13}};
+
+/* count1 table A, indexed by v << 3 | w << 2 | x << 1 | y (table B is 4 bits, inverted) */
+constexpr std::uint8_t kQuadLen[16] = {1, 4, 4, 5, 4, 6, 5, 6, 4, 5, 5, 6, 5, 6, 6, 6};
+constexpr std::uint8_t kQuadCode[16] = {1, 5, 4, 5, 6, 5, 4, 4, 7, 3, 6, 0, 7, 2, 3, 1};
+
+/* Scalefactor band widths; rows 44.1, 48, 32, 22.05, 24, 16, 11.025, 12 and 8 kHz */
+constexpr std::uint8_t kBandLong[9][22] = {
+    {4, 4, 4, 4, 4, 4, 6, 6, 8, 8, 10, 12, 16, 20, 24, 28, 34, 42, 50, 54, 76, 158},
+    {4, 4, 4, 4, 4, 4, 6, 6, 6, 8, 10, 12, 16, 18, 22, 28, 34, 40, 46, 54, 54, 192},
+    {4, 4, 4, 4, 4, 4, 6, 6, 8, 10, 12, 16, 20, 24, 30, 38, 46, 56, 68, 84, 102, 26},
+    {6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+    {6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 18, 22, 26, 32, 38, 46, 54, 62, 70, 76, 36},
+    {6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+    {6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+    {6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+    {12, 12, 12, 12, 12, 12, 16, 20, 24, 28, 32, 40, 48, 56, 64, 76, 90, 2, 2, 2, 2, 2},
+};
+constexpr std::uint8_t kBandShort[9][13] = {
+    {4, 4, 4, 4, 6, 8, 10, 12, 14, 18, 22, 30, 56}, {4, 4, 4, 4, 6, 6, 10, 12, 14, 16, 20, 26, 66},
+    {4, 4, 4, 4, 6, 8, 12, 16, 20, 26, 34, 42, 12}, {4, 4, 4, 6, 6, 8, 10, 14, 18, 26, 32, 42, 18},
+    {4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 32, 44, 12}, {4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+    {4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18}, {4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+    {8, 8, 8, 12, 16, 20, 24, 28, 36, 2, 2, 2, 26},
+};
+
+constexpr std::uint8_t kPretab[22] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 3, 2, 0};
+
+/* MPEG-1 scalefac_compress → slen1, slen2 */
+constexpr std::uint8_t kSlen[2][16] = {{0, 0, 0, 0, 3, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4},
+                                       {0, 1, 2, 3, 0, 1, 2, 3, 1, 2, 3, 1, 2, 3, 2, 3}};
+
+/* MPEG-2 nr_of_sfb[partition table][long, short, mixed][4] */
+constexpr std::uint8_t kLsfSfbCount[6][3][4] = {
+    {{6, 5, 5, 5}, {9, 9, 9, 9}, {6, 9, 9, 9}},   {{6, 5, 7, 3}, {9, 9, 12, 6}, {6, 9, 12, 6}},
+    {{11, 10, 0, 0}, {18, 18, 0, 0}, {15, 18, 0, 0}}, {{7, 7, 7, 0}, {12, 12, 12, 0}, {6, 15, 12, 0}},
+    {{6, 6, 6, 3}, {12, 9, 9, 6}, {6, 12, 9, 6}},   {{8, 8, 5, 0}, {15, 12, 9, 0}, {6, 18, 9, 0}},
+};
+
+/* Synthesis window D[0..256] × 65536 (Table 3-B.3); the rest follows by symmetry */
+constexpr std::int32_t kSynthWindow[257] = {
+    0, -1, -1, -1, -1, -1, -1, -2, -2, -2, -2, -3,
+    -3, -4, -4, -5, -5, -6, -7, -7, -8, -9, -10, -11,
+    -13, -14, -16, -17, -19, -21, -24, -26, -29, -31, -35, -38,
+    -41, -45, -49, -53, -58, -63, -68, -73, -79, -85, -91, -97,
+    -104, -111, -117, -125, -132, -139, -147, -154, -161, -169, -176, -183,
+    -190, -196, -202, -208, 213, 218, 222, 225, 227, 228, 228, 227,
+    224, 221, 215, 208, 200, 189, 177, 163, 146, 127, 106, 83,
+    57, 29, -2, -36, -72, -111, -153, -197, -244, -294, -347, -401,
+    -459, -519, -581, -645, -711, -779, -848, -919, -991, -1064, -1137, -1210,
+    -1283, -1356, -1428, -1498, -1567, -1634, -1698, -1759, -1817, -1870, -1919, -1962,
+    -2001, -2032, -2057, -2075, -2085, -2087, -2080, -2063, 2037, 2000, 1952, 1893,
+    1822, 1739, 1644, 1535, 1414, 1280, 1131, 970, 794, 605, 402, 185,
+    -45, -288, -545, -814, -1095, -1388, -1692, -2006, -2330, -2663, -3004, -3351,
+    -3705, -4063, -4425, -4788, -5153, -5517, -5879, -6237, -6589, -6935, -7271, -7597,
+    -7910, -8209, -8491, -8755, -8998, -9219, -9416, -9585, -9727, -9838, -9916, -9959,
+    -9966, -9935, -9863, -9750, -9592, -9389, -9139, -8840, -8492, -8092, -7640, -7134,
+    6574, 5959, 5288, 4561, 3776, 2935, 2037, 1082, 70, -998, -2122, -3300,
+    -4533, -5818, -7154, -8540, -9975, -11455, -12980, -14548, -16155, -17799, -19478, -21189,
+    -22929, -24694, -26482, -28289, -30112, -31947, -33791, -35640, -37489, -39336, -41176, -43006,
+    -44821, -46617, -48390, -50137, -51853, -53534, -55178, -56778, -58333, -59838, -61289, -62684,
+    -64019, -65290, -66494, -67629, -68692, -69679, -70590, -71420, -72169, -72835, -73415, -73908,
+    -74313, -74630, -74856, -74992, 75038,
+};
+/*───────────────────────────────────────────────────────────────
+  Derived tables, built once
+──────────────────────────────────────────────────────────────*/
+struct Tables
+{
+    /* Huffman trees: node pairs, a leaf is −(value + 1) */
+    std::vector<std::int16_t> tree[kHuffTables + 1]; // [kHuffTables] = count1 table A
+    float pow43[8207];
+    float imdct_long[18][36];  // cos(π/72 (2i + 19)(2k + 1))
+    float imdct_short[6][12];  // cos(π/24 (2i + 7)(2k + 1))
+    float window[4][36];       // block types 0–3 (2: the 12-point window in [0, 12))
+    float alias_cs[8], alias_ca[8];
+    float synth_matrix[64][32]; // cos((16 + i)(2k + 1)π/64)
+    float synth_window[512];
+
+    Tables()
+    {
+        const double pi = 3.14159265358979323846;
+        std::size_t at = 0;
+        for (int t = 0; t < kHuffTables; ++t)
+        {
+            std::vector<std::uint32_t> codes;
+            std::uint64_t code = 0; // left-aligned in 32 bits: codes follow in tree order
+            for (int i = 0; i < kHuffSize[t]; ++i)
+            {
+                const int len = kHuffLen[at + std::size_t(i)];
+                codes.push_back(std::uint32_t(code >> (32 - len)));
+                code += std::uint64_t(1) << (32 - len);
+            }
+            for (int i = 0; i < kHuffSize[t]; ++i)
+                insert(tree[t], codes[std::size_t(i)], kHuffLen[at + std::size_t(i)], kHuffSym[at + std::size_t(i)]);
+            at += kHuffSize[t];
+        }
+        for (int v = 0; v < 16; ++v)
+            insert(tree[kHuffTables], kQuadCode[v], kQuadLen[v], std::uint8_t(v));
+
+        for (int i = 0; i < 8207; ++i)
+            pow43[i] = float(std::pow(double(i), 4.0 / 3.0));
+        for (int i = 0; i < 36; ++i)
+            for (int k = 0; k < 18; ++k)
+                imdct_long[k][i] = float(std::cos(pi / 72.0 * (2 * i + 19) * (2 * k + 1)));
+        for (int i = 0; i < 12; ++i)
+            for (int k = 0; k < 6; ++k)
+                imdct_short[k][i] = float(std::cos(pi / 24.0 * (2 * i + 7) * (2 * k + 1)));
+
+        for (int i = 0; i < 36; ++i)
+        {
+            const float sine = float(std::sin(pi / 36.0 * (i + 0.5)));
+            window[0][i] = sine;
+            window[1][i] = i < 18 ? sine : i < 24 ? 1.0f : i < 30 ? float(std::sin(pi / 12.0 * (i - 18 + 0.5))) : 0.0f;
+            window[3][i] = i < 6 ? 0.0f : i < 12 ? float(std::sin(pi / 12.0 * (i - 6 + 0.5))) : i < 18 ? 1.0f : sine;
+            window[2][i] = i < 12 ? float(std::sin(pi / 12.0 * (i + 0.5))) : 0.0f;
+        }
+        static const double kAlias[8] = {-0.6, -0.535, -0.33, -0.185, -0.095, -0.041, -0.0142, -0.0037};
+        for (int i = 0; i < 8; ++i)
+        {
+            const double r = std::sqrt(1.0 + kAlias[i] * kAlias[i]);
+            alias_cs[i] = float(1.0 / r);
+            alias_ca[i] = float(kAlias[i] / r);
+        }
+        for (int i = 0; i < 64; ++i)
+            for (int k = 0; k < 32; ++k)
+                synth_matrix[i][k] = float(std::cos((16 + i) * (2 * k + 1) * pi / 64.0));
+        for (int i = 0; i < 257; ++i)
+        {
+            const float v = float(kSynthWindow[i]) / 65536.0f;
+            synth_window[i] = v;
+            if (i > 0)
+                synth_window[512 - i] = (i & 63) ? -v : v;
+        }
+    }
+
+    static void insert(std::vector<std::int16_t> &t, std::uint32_t code, int len, std::uint8_t value)
+    {
+        if (t.empty())
+            t.assign(2, 0);
+        std::size_t node = 0;
+        for (int b = len - 1; b > 0; --b)
+        {
+            const std::size_t slot = node * 2 + ((code >> b) & 1);
+            if (t[slot] == 0)
+            {
+                t[slot] = std::int16_t(t.size() / 2);
+                t.resize(t.size() + 2, 0);
+            }
+            node = std::size_t(t[slot]);
+        }
+        t[node * 2 + (code & 1)] = std::int16_t(-int(value) - 1);
+    }
+};
+
+inline const Tables &tables()
+{
+    static const Tables t;
+    return t;
+}
+
+/* MSB-first reader over a zero-padded buffer; reads past the end give zeros. */
+class BitReader
+{
+public:
+    BitReader(const std::uint8_t *p, std::size_t bytes) : p_(p), bits_(bytes * 8) {}
+
+    std::size_t pos() const { return pos_; }
+    void seek(std::size_t bit) { pos_ = bit; }
+
+    unsigned bit()
+    {
+        const unsigned b = pos_ < bits_ ? (p_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1u : 0u;
+        ++pos_;
+        return b;
+    }
+
+    unsigned get(int n)
+    {
+        unsigned v = 0;
+        while (n-- > 0)
+            v = v << 1 | bit();
+        return v;
+    }
+
+    /* One value from a Huffman tree */
+    int decode(const std::vector<std::int16_t> &tree)
+    {
+        std::size_t node = 0;
+        for (int depth = 0; depth < 20; ++depth)
+        {
+            const std::int16_t next = tree[node * 2 + bit()];
+            if (next < 0)
+                return -next - 1;
+            node = std::size_t(next);
+        }
+        return 0; // cannot happen with complete tables
+    }
+
+private:
+    const std::uint8_t *p_;
+    std::size_t bits_;
+    std::size_t pos_ = 0;
+};
+
+struct Granule
+{
+    unsigned part2_3_length = 0, big_values = 0, global_gain = 0, scalefac_compress = 0;
+    unsigned block_type = 0, table_select[3] = {}, subblock_gain[3] = {};
+    unsigned region0_count = 0, region1_count = 0;
+    bool window_switching = false, mixed = false, preflag = false, scalefac_scale = false, count1_b = false;
+};
+} // namespace mp3_detail
+
+/*───────────────────────────────────────────────────────────────
+  Mp3Layer3Decoder – one frame in, interleaved float PCM out
+──────────────────────────────────────────────────────────────*/
+class Mp3Layer3Decoder
+{
+public:
+    static constexpr int kMaxFrameSamples = 1152; // per channel
+
+    Mp3Layer3Decoder() { reset(); }
+
+    /* Forget the reservoir and filter state, e.g. before decoding from another offset. */
+    void reset()
+    {
+        reservoir_.clear();
+        std::memset(overlap_, 0, sizeof(overlap_));
+        std::memset(synth_v_, 0, sizeof(synth_v_));
+        std::memset(scalefac_l_, 0, sizeof(scalefac_l_));
+        synth_at_[0] = synth_at_[1] = 0;
+    }
+
+    /* Decode the frame at `frame` (`bytes` long, header included) into `out`
+       (interleaved, room for kMaxFrameSamples × channels); `frames` receives
+       the samples per channel. False for frames this decoder does not handle. */
+    bool decode(const std::uint8_t *frame, std::size_t bytes, float *out, int &frames)
+    {
+        using namespace mp3_detail;
+        frames = 0;
+        if (bytes < 4 || frame[0] != 0xFF || (frame[1] & 0xE0) != 0xE0 || ((frame[1] >> 1) & 3) != 1)
+            return false; // not Layer III
+        const int ver_bits = (frame[1] >> 3) & 3, sr_bits = (frame[2] >> 2) & 3;
+        if (ver_bits == 1 || sr_bits == 3)
+            return false;
+        const bool lsf = ver_bits != 3;
+        const int mode = frame[3] >> 6, mode_ext = (frame[3] >> 4) & 3;
+        const int channels = mode == 3 ? 1 : 2;
+        const bool ms = mode == 1 && (mode_ext & 2);
+        if (mode == 1 && (mode_ext & 1))
+            return false; // intensity stereo
+        sfreq_ = (ver_bits == 3 ? 0 : ver_bits == 2 ? 3 : 6) + sr_bits;
+        const int granules = lsf ? 1 : 2;
+        const std::size_t side_at = (frame[1] & 1) ? 4 : 6;
+        const std::size_t side_bytes = lsf ? (channels == 1 ? 9 : 17) : (channels == 1 ? 17 : 32);
+        if (bytes < side_at + side_bytes)
+            return false;
+
+        /* Side information */
+        BitReader side(frame + side_at, side_bytes);
+        const unsigned main_data_begin = side.get(lsf ? 8 : 9);
+        side.get(lsf ? channels : (channels == 1 ? 5 : 3));
+        unsigned scfsi[2] = {};
+        if (!lsf)
+            for (int ch = 0; ch < channels; ++ch)
+                scfsi[ch] = side.get(4);
+        Granule gr[2][2];
+        for (int g = 0; g < granules; ++g)
+            for (int ch = 0; ch < channels; ++ch)
+                read_granule(side, lsf, gr[g][ch]);
+
+        const std::uint8_t *main = frame + side_at + side_bytes;
+        const std::size_t main_bytes = bytes - side_at - side_bytes;
+        frames = granules * 576;
+        if (main_bytes >= 4 && (!std::memcmp(main, "Xing", 4) || !std::memcmp(main, "Info", 4)))
+        {
+            frames = 0; // encoder tag, not audio
+            return true;
+        }
+        if (bytes > side_at + 36 && !std::memcmp(frame + 36, "VBRI", 4))
+        {
+            frames = 0;
+            return true;
+        }
+
+        /* Main data: the tail of the reservoir, then this frame's own */
+        const bool have_data = main_data_begin <= reservoir_.size();
+        if (have_data)
+        {
+            data_.assign(reservoir_.end() - std::ptrdiff_t(main_data_begin), reservoir_.end());
+            data_.insert(data_.end(), main, main + main_bytes);
+        }
+        reservoir_.insert(reservoir_.end(), main, main + main_bytes);
+        if (reservoir_.size() > kReservoirBytes)
+            reservoir_.erase(reservoir_.begin(), reservoir_.end() - std::ptrdiff_t(kReservoirBytes));
+        if (!have_data)
+        {
+            std::fill(out, out + frames * channels, 0.0f);
+            return true;
+        }
+
+        data_.resize(data_.size() + 8, 0);
+        BitReader bits(data_.data(), data_.size() - 8);
+        for (int g = 0; g < granules; ++g)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                Granule &gi = gr[g][ch];
+                const std::size_t end = bits.pos() + gi.part2_3_length;
+                if (lsf)
+                    read_scalefactors_lsf(bits, gi, ch);
+                else
+                    read_scalefactors(bits, gi, ch, g == 0 ? 0u : scfsi[ch]);
+                read_huffman(bits, gi, end, is_[ch]);
+                bits.seek(end);
+                requantize(gi, ch);
+                reorder(gi, xr_[ch]);
+            }
+            if (ms)
+            {
+                const float k = 0.70710678118654752f;
+                for (int i = 0; i < 576; ++i)
+                {
+                    const float m = xr_[0][i], s = xr_[1][i];
+                    xr_[0][i] = (m + s) * k;
+                    xr_[1][i] = (m - s) * k;
+                }
+            }
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                antialias(gr[g][ch], xr_[ch]);
+                hybrid(gr[g][ch], ch);
+                synthesize(ch, out + std::size_t(g) * 576 * std::size_t(channels) + std::size_t(ch), channels);
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr std::size_t kReservoirBytes = 4096; // main_data_begin reaches back at most 511
+
+    static void read_granule(mp3_detail::BitReader &side, bool lsf, mp3_detail::Granule &g)
+    {
+        g.part2_3_length = side.get(12);
+        g.big_values = std::min(side.get(9), 288u);
+        g.global_gain = side.get(8);
+        g.scalefac_compress = side.get(lsf ? 9 : 4);
+        g.window_switching = side.get(1);
+        if (g.window_switching)
+        {
+            g.block_type = side.get(2);
+            g.mixed = side.get(1);
+            g.table_select[0] = side.get(5);
+            g.table_select[1] = side.get(5);
+            g.table_select[2] = 0;
+            for (unsigned &s : g.subblock_gain)
+                s = side.get(3);
+        }
+        else
+        {
+            g.block_type = 0;
+            g.mixed = false;
+            for (unsigned &t : g.table_select)
+                t = side.get(5);
+            g.region0_count = side.get(4);
+            g.region1_count = side.get(3);
+            g.subblock_gain[0] = g.subblock_gain[1] = g.subblock_gain[2] = 0;
+        }
+        g.preflag = lsf ? false : side.get(1); // MPEG-2: from scalefac_compress
+        g.scalefac_scale = side.get(1);
+        g.count1_b = side.get(1);
+    }
+
+    /* Last sample coded with long bands in a mixed block */
+    int mixed_end() const { return sfreq_ == 8 ? 72 : 36; }
+
+    void read_scalefactors(mp3_detail::BitReader &bits, const mp3_detail::Granule &g, int ch, unsigned scfsi)
+    {
+        using namespace mp3_detail;
+        const int slen1 = kSlen[0][g.scalefac_compress], slen2 = kSlen[1][g.scalefac_compress];
+        std::uint8_t *sl = scalefac_l_[ch];
+        if (g.window_switching && g.block_type == 2)
+        {
+            int sfb = 0;
+            if (g.mixed)
+                for (; sfb < 8; ++sfb)
+                    sl[sfb] = std::uint8_t(bits.get(slen1));
+            for (int s = g.mixed ? 3 : 0; s < 12; ++s)
+                for (int w = 0; w < 3; ++w)
+                    scalefac_s_[ch][s][w] = std::uint8_t(bits.get(s < 6 ? slen1 : slen2));
+            for (int w = 0; w < 3; ++w)
+                scalefac_s_[ch][12][w] = 0;
+            return;
+        }
+        static const int kGroup[5] = {0, 6, 11, 16, 21};
+        for (int grp = 0; grp < 4; ++grp)
+        {
+            if (scfsi & (8u >> grp))
+                continue; // shared with granule 0
+            for (int sfb = kGroup[grp]; sfb < kGroup[grp + 1]; ++sfb)
+                sl[sfb] = std::uint8_t(bits.get(grp < 2 ? slen1 : slen2));
+        }
+        sl[21] = 0;
+    }
+
+    void read_scalefactors_lsf(mp3_detail::BitReader &bits, mp3_detail::Granule &g, int ch)
+    {
+        using namespace mp3_detail;
+        unsigned sfc = g.scalefac_compress, slen[4] = {};
+        int table = 0;
+        if (sfc < 400)
+            slen[0] = (sfc >> 4) / 5, slen[1] = (sfc >> 4) % 5, slen[2] = (sfc & 15) >> 2, slen[3] = sfc & 3;
+        else if (sfc < 500)
+            sfc -= 400, slen[0] = (sfc >> 2) / 5, slen[1] = (sfc >> 2) % 5, slen[2] = sfc & 3, table = 1;
+        else
+            sfc -= 500, slen[0] = sfc / 3, slen[1] = sfc % 3, table = 2, g.preflag = true;
+
+        const int kind = g.window_switching && g.block_type == 2 ? (g.mixed ? 2 : 1) : 0;
+        std::uint8_t values[39] = {};
+        int n = 0;
+        for (int part = 0; part < 4; ++part)
+            for (int i = 0; i < kLsfSfbCount[table][kind][part]; ++i)
+                values[n++] = std::uint8_t(bits.get(int(slen[part])));
+
+        if (kind == 0)
+        {
+            for (int sfb = 0; sfb < 21; ++sfb)
+                scalefac_l_[ch][sfb] = values[sfb];
+            scalefac_l_[ch][21] = 0;
+            return;
+        }
+        int at = 0;
+        if (kind == 2)
+            for (; at < 6; ++at)
+                scalefac_l_[ch][at] = values[at];
+        for (int s = kind == 2 ? 3 : 0; s < 12; ++s)
+            for (int w = 0; w < 3; ++w)
+                scalefac_s_[ch][s][w] = values[at++];
+        for (int w = 0; w < 3; ++w)
+            scalefac_s_[ch][12][w] = 0;
+    }
+
+    void read_huffman(mp3_detail::BitReader &bits, const mp3_detail::Granule &g, std::size_t end, int *is)
+    {
+        using namespace mp3_detail;
+        const Tables &t = tables();
+        int region1, region2;
+        if (g.window_switching)
+        {
+            region1 = g.block_type == 2 ? (sfreq_ == 8 ? 72 : 36) : (sfreq_ <= 2 ? 36 : sfreq_ != 8 ? 54 : 108);
+            region2 = 576;
+        }
+        else
+        {
+            int edge = 0, b = 0;
+            for (; b <= int(g.region0_count); ++b)
+                edge += kBandLong[sfreq_][std::min(b, 21)];
+            region1 = edge;
+            for (; b <= int(g.region0_count + g.region1_count) + 1 && b < 22; ++b)
+                edge += kBandLong[sfreq_][b];
+            region2 = std::min(edge, 576);
+        }
+
+        const int big = int(g.big_values) * 2;
+        int i = 0;
+        for (; i < big; i += 2)
+        {
+            const unsigned sel = g.table_select[i < region1 ? 0 : i < region2 ? 1 : 2];
+            const int table = kHuffSelect[sel][0], linbits = kHuffSelect[sel][1];
+            if (table == 0)
+            {
+                is[i] = is[i + 1] = 0;
+                continue;
+            }
+            const int v = bits.decode(t.tree[table - 1]);
+            int x = v >> 4, y = v & 15;
+            if (x == 15 && linbits)
+                x += int(bits.get(linbits));
+            if (x && bits.bit())
+                x = -x;
+            if (y == 15 && linbits)
+                y += int(bits.get(linbits));
+            if (y && bits.bit())
+                y = -y;
+            is[i] = x;
+            is[i + 1] = y;
+        }
+
+        /* count1: quadruples of −1 … 1 until part2_3_length runs out */
+        while (i + 4 <= 576 && bits.pos() < end)
+        {
+            const int v = g.count1_b ? int(bits.get(4) ^ 15u) : bits.decode(t.tree[kHuffTables]);
+            int q[4] = {(v >> 3) & 1, (v >> 2) & 1, (v >> 1) & 1, v & 1};
+            for (int &x : q)
+                if (x && bits.bit())
+                    x = -x;
+            if (bits.pos() > end)
+                break; // over-read: the last quadruple is not part of the granule
+            std::copy(q, q + 4, is + i);
+            i += 4;
+        }
+        std::fill(is + i, is + 576, 0);
+    }
+
+    void requantize(const mp3_detail::Granule &g, int ch)
+    {
+        using namespace mp3_detail;
+        const Tables &t = tables();
+        const int *is = is_[ch];
+        float *xr = xr_[ch];
+        const double sf_mult = g.scalefac_scale ? 1.0 : 0.5;
+        const double gain = (double(g.global_gain) - 210.0) / 4.0;
+        const auto value = [&](int q, double exponent) {
+            const float m = t.pow43[std::min(std::abs(q), 8206)] * float(std::exp2(exponent));
+            return q < 0 ? -m : m;
+        };
+
+        const bool short_blocks = g.window_switching && g.block_type == 2;
+        int i = 0;
+        if (!short_blocks || g.mixed)
+        {
+            const int limit = short_blocks ? mixed_end() : 576;
+            for (int sfb = 0; sfb < 22 && i < limit; ++sfb)
+            {
+                const double e = gain - sf_mult * (scalefac_l_[ch][sfb] + (g.preflag ? kPretab[sfb] : 0));
+                const float scale = float(std::exp2(e));
+                for (int end = std::min(limit, i + kBandLong[sfreq_][sfb]); i < end; ++i)
+                    xr[i] = is[i] ? (is[i] < 0 ? -1.0f : 1.0f) * t.pow43[std::min(std::abs(is[i]), 8206)] * scale : 0.0f;
+            }
+        }
+        if (short_blocks)
+            for (int sfb = g.mixed ? 3 : 0; sfb < 13 && i < 576; ++sfb)
+            {
+                const int width = kBandShort[sfreq_][sfb];
+                for (int w = 0; w < 3; ++w)
+                {
+                    const double e = gain - 2.0 * g.subblock_gain[w] - sf_mult * scalefac_s_[ch][sfb][w];
+                    for (int k = 0; k < width && i < 576; ++k, ++i)
+                        xr[i] = is[i] ? value(is[i], e) : 0.0f;
+                }
+            }
+        for (; i < 576; ++i)
+            xr[i] = 0.0f;
+    }
+
+    /* Short bands arrive window by window; the IMDCT wants them interleaved */
+    void reorder(const mp3_detail::Granule &g, float *xr)
+    {
+        using namespace mp3_detail;
+        if (!g.window_switching || g.block_type != 2)
+            return;
+        int start = 0;
+        if (g.mixed)
+            start = mixed_end();
+        for (int sfb = g.mixed ? 3 : 0, at = start; sfb < 13 && at < 576; ++sfb)
+        {
+            const int width = kBandShort[sfreq_][sfb];
+            float tmp[3 * 66];
+            for (int w = 0; w < 3; ++w)
+                for (int f = 0; f < width; ++f)
+                    tmp[3 * f + w] = xr[at + w * width + f];
+            std::copy(tmp, tmp + 3 * width, xr + at);
+            at += 3 * width;
+        }
+    }
+
+    void antialias(const mp3_detail::Granule &g, float *xr)
+    {
+        const mp3_detail::Tables &t = mp3_detail::tables();
+        int bounds = 32;
+        if (g.window_switching && g.block_type == 2)
+            bounds = g.mixed ? 2 : 0;
+        for (int sb = 1; sb < bounds; ++sb)
+            for (int i = 0; i < 8; ++i)
+            {
+                float &a = xr[18 * sb - 1 - i], &b = xr[18 * sb + i];
+                const float lo = a, hi = b;
+                a = lo * t.alias_cs[i] - hi * t.alias_ca[i];
+                b = hi * t.alias_cs[i] + lo * t.alias_ca[i];
+            }
+    }
+
+    /* IMDCT, windowing, overlap-add and frequency inversion: xr_[ch] → subband samples */
+    void hybrid(const mp3_detail::Granule &g, int ch)
+    {
+        const mp3_detail::Tables &t = mp3_detail::tables();
+        const float *xr = xr_[ch];
+        float *sub = xr_[ch] + 576; // subband samples, [sb][18]
+        for (int sb = 0; sb < 32; ++sb)
+        {
+            const unsigned type = g.window_switching && !(g.mixed && sb < 2) ? g.block_type : 0;
+            const float *x = xr + 18 * sb;
+            float z[36];
+            if (type == 2)
+            {
+                std::fill(z, z + 36, 0.0f);
+                for (int w = 0; w < 3; ++w)
+                    for (int i = 0; i < 12; ++i)
+                    {
+                        float s = 0.0f;
+                        for (int k = 0; k < 6; ++k)
+                            s += x[3 * k + w] * t.imdct_short[k][i];
+                        z[6 + 6 * w + i] += s * t.window[2][i];
+                    }
+            }
+            else
+                for (int i = 0; i < 36; ++i)
+                {
+                    float s = 0.0f;
+                    for (int k = 0; k < 18; ++k)
+                        s += x[k] * t.imdct_long[k][i];
+                    z[i] = s * t.window[type][i];
+                }
+            float *prev = overlap_[ch][sb];
+            for (int i = 0; i < 18; ++i)
+            {
+                const float v = z[i] + prev[i];
+                sub[sb * 18 + i] = (sb & 1) && (i & 1) ? -v : v;
+                prev[i] = z[i + 18];
+            }
+        }
+    }
+
+    /* Polyphase synthesis of the 18 time slots; writes every `stride`-th sample of `out` */
+    void synthesize(int ch, float *out, int stride)
+    {
+        const mp3_detail::Tables &t = mp3_detail::tables();
+        const SimdKernels &k = simd();
+        const float *sub = xr_[ch] + 576;
+        float *v = synth_v_[ch];
+        for (int slot = 0; slot < 18; ++slot)
+        {
+            float s[32];
+            for (int sb = 0; sb < 32; ++sb)
+                s[sb] = sub[sb * 18 + slot];
+            int &at = synth_at_[ch];
+            at = (at + 1024 - 64) & 1023;
+            for (int i = 0; i < 64; ++i)
+                v[at + i] = k.dot(t.synth_matrix[i], s, 32);
+            for (int j = 0; j < 32; ++j)
+            {
+                float sum = 0.0f;
+                for (int i = 0; i < 8; ++i)
+                {
+                    sum += v[(at + i * 128 + j) & 1023] * t.synth_window[i * 64 + j];
+                    sum += v[(at + i * 128 + 96 + j) & 1023] * t.synth_window[i * 64 + 32 + j];
+                }
+                out[std::size_t(slot * 32 + j) * std::size_t(stride)] = sum;
+            }
+        }
+    }
+
+    int sfreq_ = 0; // band table row
+    std::vector<std::uint8_t> reservoir_, data_;
+    std::uint8_t scalefac_l_[2][22];
+    std::uint8_t scalefac_s_[2][13][3] = {};
+    int is_[2][576] = {};
+    float xr_[2][576 + 576] = {}; // spectrum, then subband samples
+    float overlap_[2][32][18];
+    float synth_v_[2][1024 + 64]; // +64: v[at + i] never wraps inside one slot
+    int synth_at_[2] = {};
+};
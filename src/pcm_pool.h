@@ -0,0 +1,340 @@
+/*
+pcm_pool.h – pooled, recycled PCM blocks in compact 16-bit storage
+
+Introduction
+============
+Decoded audio is held as 16-bit samples in fixed-size blocks taken from a
+process-wide pool, not as float vectors sized to the chunk. A worker converts
+to float only inside its own scratch window, right where a float consumer
+(the VAD, say) needs it:
+
+    ```cpp
+    #include "pcm_pool.h"
+
+    PcmBuffer pcm;                              // blocks come from pcm_pool()
+    pcm.append(decoded.data(), decoded.size()); // float in, int16 / f16 stored
+    pcm.drop_front(preroll);                    // whole blocks go back to the pool
+
+    std::vector<float> &win = pcm_scratch();    // this worker's window, reused
+    pcm.read(0, n, win.data());                 // float only here
+    ```
+
+Blocks are 16384 samples (~1 s at 16 kHz, 32 KiB) aligned to 64 bytes, and
+are recycled rather than freed, so after the first chunks a job allocates
+nothing for audio and resident PCM is bounded by workers × chunk length
+rather than by the length of the episode. At 16 kHz one hour takes 115 MB
+here against 230 MB as float.
+
+Storage is signed 16-bit by default – exactly what whisper-cli is handed in
+the chunk WAV, so nothing is lost – or IEEE half precision (set_storage),
+which keeps 11 bits of mantissa at any level and suits very quiet sources.
+Float to int16 rounds like drwav_f32_to_s16, so a WAV written from a buffer is
+bit-identical to one written from the float samples.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+enum class PcmStorage
+{
+    S16,
+    F16
+};
+
+inline const char *pcm_storage_name(PcmStorage s) { return s == PcmStorage::F16 ? "f16" : "s16"; }
+
+inline bool parse_pcm_storage(const std::string &name, PcmStorage &out)
+{
+    if (name == "s16" || name == "int16")
+        out = PcmStorage::S16;
+    else if (name == "f16" || name == "half")
+        out = PcmStorage::F16;
+    else
+        return false;
+    return true;
+}
+
+namespace pcm_detail
+{
+inline std::uint16_t to_s16(float x)
+{
+    const float c = (x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : x)) + 1.0f;
+    return std::uint16_t(std::int16_t(int(c * 32767.5f) - 32768));
+}
+
+inline float from_s16(std::uint16_t v) { return float(std::int16_t(v)) * 0.000030517578125f; }
+
+/* Round to nearest even; overflow becomes ±inf, NaN stays NaN. */
+inline std::uint16_t to_f16(float f)
+{
+    std::uint32_t x;
+    std::memcpy(&x, &f, 4);
+    const std::uint32_t sign = (x >> 16) & 0x8000;
+    x &= 0x7FFFFFFF;
+    if (x >= 0x47800000) // ≥ 65536, inf or NaN
+        return std::uint16_t(sign | (x > 0x7F800000 ? 0x7E00 : 0x7C00));
+    if (x < 0x38800000) // below 2^-14: subnormal, let the FPU round via 0.5 + |f|
+    {
+        float a;
+        std::memcpy(&a, &x, 4);
+        a += 0.5f;
+        std::uint32_t y;
+        std::memcpy(&y, &a, 4);
+        return std::uint16_t(sign | (y - 0x3F000000));
+    }
+    x += 0xC8000FFF + ((x >> 13) & 1); // rebias exponent by -112, round half to even
+    return std::uint16_t(sign | (x >> 13));
+}
+
+inline float from_f16(std::uint16_t h)
+{
+    const std::uint32_t sign = std::uint32_t(h & 0x8000) << 16;
+    const std::uint32_t e = (h >> 10) & 0x1F, m = h & 0x3FF;
+    if (e == 0)
+    {
+        const float v = float(m) * (1.0f / 16777216.0f);
+        return sign ? -v : v;
+    }
+    const std::uint32_t bits = sign | (e == 31 ? 0x7F800000 | (m << 13) : ((e + 112) << 23) | (m << 13));
+    float f;
+    std::memcpy(&f, &bits, 4);
+    return f;
+}
+} // namespace pcm_detail
+
+/*───────────────────────────────────────────────────────────────
+  PcmPool – fixed-size aligned blocks, recycled through a free list
+──────────────────────────────────────────────────────────────*/
+class PcmPool
+{
+public:
+    static constexpr std::size_t kBlockSamples = 16384;
+    static constexpr std::size_t kBlockBytes = kBlockSamples * sizeof(std::uint16_t);
+    static constexpr std::size_t kAlign = 64;
+
+    struct Stats
+    {
+        std::size_t allocated = 0; // blocks obtained from the system
+        std::size_t in_use = 0;
+        std::size_t peak = 0; // most blocks in use at once
+    };
+
+    PcmPool() = default;
+    PcmPool(const PcmPool &) = delete;
+    PcmPool &operator=(const PcmPool &) = delete;
+    ~PcmPool()
+    {
+        for (std::uint16_t *b : free_)
+            std::free(b);
+    }
+
+    /* Applies to buffers created afterwards. */
+    void set_storage(PcmStorage s) { storage_.store(s, std::memory_order_relaxed); }
+    PcmStorage storage() const { return storage_.load(std::memory_order_relaxed); }
+
+    std::uint16_t *acquire()
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        std::uint16_t *b = nullptr;
+        if (!free_.empty())
+        {
+            b = free_.back();
+            free_.pop_back();
+        }
+        else
+        {
+            b = static_cast<std::uint16_t *>(std::aligned_alloc(kAlign, kBlockBytes));
+            if (!b)
+                throw std::bad_alloc();
+            ++stats_.allocated;
+        }
+        stats_.peak = std::max(stats_.peak, ++stats_.in_use);
+        return b;
+    }
+
+    void release(std::uint16_t *b)
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        free_.push_back(b);
+        --stats_.in_use;
+    }
+
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        return stats_;
+    }
+
+private:
+    mutable std::mutex mu_;
+    std::vector<std::uint16_t *> free_;
+    Stats stats_;
+    std::atomic<PcmStorage> storage_{PcmStorage::S16};
+};
+
+inline PcmPool &pcm_pool()
+{
+    static PcmPool pool;
+    return pool;
+}
+
+/* {"storage":"s16","block_kb":32,"blocks":12,"peak_blocks":12,"peak_mb":0.375} */
+inline std::string pcm_pool_json()
+{
+    const PcmPool::Stats s = pcm_pool().stats();
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "{\"storage\":\"%s\",\"block_kb\":%zu,\"blocks\":%zu,\"peak_blocks\":%zu,\"peak_mb\":%.3f}",
+                  pcm_storage_name(pcm_pool().storage()), PcmPool::kBlockBytes / 1024, s.allocated, s.peak,
+                  double(s.peak * PcmPool::kBlockBytes) / (1024.0 * 1024.0));
+    return buf;
+}
+
+/* The calling worker's float window; keeps its capacity from chunk to chunk. */
+inline std::vector<float> &pcm_scratch()
+{
+    thread_local std::vector<float> scratch;
+    return scratch;
+}
+
+/*───────────────────────────────────────────────────────────────
+  PcmBuffer – 16 kHz mono samples in pooled blocks
+──────────────────────────────────────────────────────────────*/
+class PcmBuffer
+{
+public:
+    explicit PcmBuffer(PcmPool &pool = pcm_pool()) : pool_(&pool), storage_(pool.storage()) {}
+    PcmBuffer(const PcmBuffer &) = delete;
+    PcmBuffer &operator=(const PcmBuffer &) = delete;
+    ~PcmBuffer() { clear(); }
+
+    PcmStorage storage() const { return storage_; }
+    std::size_t size() const { return end_ - head_; }
+    bool empty() const { return end_ == head_; }
+
+    void clear()
+    {
+        for (std::uint16_t *b : blocks_)
+            pool_->release(b);
+        blocks_.clear();
+        head_ = end_ = 0;
+    }
+
+    void append(const float *x, std::size_t n)
+    {
+        while (n > 0)
+        {
+            const std::size_t at = end_ % PcmPool::kBlockSamples;
+            if (at == 0 && end_ / PcmPool::kBlockSamples == blocks_.size())
+                blocks_.push_back(pool_->acquire());
+            std::uint16_t *dst = blocks_[end_ / PcmPool::kBlockSamples] + at;
+            const std::size_t take = std::min(n, PcmPool::kBlockSamples - at);
+            if (storage_ == PcmStorage::F16)
+                for (std::size_t i = 0; i < take; ++i)
+                    dst[i] = pcm_detail::to_f16(x[i]);
+            else
+                for (std::size_t i = 0; i < take; ++i)
+                    dst[i] = pcm_detail::to_s16(x[i]);
+            x += take;
+            n -= take;
+            end_ += take;
+        }
+    }
+
+    /* Forget the first n samples; blocks that fall out go back to the pool. */
+    void drop_front(std::size_t n)
+    {
+        head_ += std::min(n, size());
+        const std::size_t whole = head_ / PcmPool::kBlockSamples;
+        for (std::size_t i = 0; i < whole; ++i)
+            pool_->release(blocks_[i]);
+        blocks_.erase(blocks_.begin(), blocks_.begin() + std::ptrdiff_t(whole));
+        head_ -= whole * PcmPool::kBlockSamples;
+        end_ -= whole * PcmPool::kBlockSamples;
+    }
+
+    /* Keep at most the first n samples. */
+    void truncate(std::size_t n)
+    {
+        end_ = head_ + std::min(n, size());
+        const std::size_t keep = (end_ + PcmPool::kBlockSamples - 1) / PcmPool::kBlockSamples;
+        while (blocks_.size() > keep)
+        {
+            pool_->release(blocks_.back());
+            blocks_.pop_back();
+        }
+    }
+
+    /* Samples [at, at+n) as float. */
+    void read(std::size_t at, std::size_t n, float *out) const
+    {
+        visit(at, n, [&](const std::uint16_t *src, std::size_t take) {
+            if (storage_ == PcmStorage::F16)
+                for (std::size_t i = 0; i < take; ++i)
+                    *out++ = pcm_detail::from_f16(src[i]);
+            else
+                for (std::size_t i = 0; i < take; ++i)
+                    *out++ = pcm_detail::from_s16(src[i]);
+        });
+    }
+
+    /* Samples [at, at+n) as signed 16-bit, straight from the blocks when stored that way. */
+    void read_s16(std::size_t at, std::size_t n, std::int16_t *out) const
+    {
+        visit(at, n, [&](const std::uint16_t *src, std::size_t take) {
+            if (storage_ == PcmStorage::F16)
+                for (std::size_t i = 0; i < take; ++i)
+                    out[i] = std::int16_t(pcm_detail::to_s16(pcm_detail::from_f16(src[i])));
+            else
+                std::memcpy(out, src, take * sizeof(std::uint16_t));
+            out += take;
+        });
+    }
+
+    /* All samples in order, at most `window` at a time as float in the calling
+       worker's scratch window: fn(const float *x, std::size_t n). Only one
+       window is ever converted, however long the buffer. */
+    template <class Fn>
+    void for_each_window(std::size_t window, Fn &&fn) const
+    {
+        std::vector<float> &w = pcm_scratch();
+        w.resize(std::min(window, size()));
+        for (std::size_t at = 0; at < size(); at += window)
+        {
+            const std::size_t n = std::min(window, size() - at);
+            read(at, n, w.data());
+            fn(static_cast<const float *>(w.data()), n);
+        }
+    }
+
+private:
+    template <class Fn>
+    void visit(std::size_t at, std::size_t n, Fn &&fn) const
+    {
+        std::size_t pos = head_ + std::min(at, size());
+        n = std::min(n, end_ - pos);
+        while (n > 0)
+        {
+            const std::size_t off = pos % PcmPool::kBlockSamples;
+            const std::size_t take = std::min(n, PcmPool::kBlockSamples - off);
+            fn(blocks_[pos / PcmPool::kBlockSamples] + off, take);
+            pos += take;
+            n -= take;
+        }
+    }
+
+    PcmPool *pool_;
+    PcmStorage storage_;
+    std::vector<std::uint16_t *> blocks_;
+    std::size_t head_ = 0, end_ = 0; // sample offsets into blocks_[0]
+};
@@ -0,0 +1,261 @@
+/*
+perf_counters.h – opt-in hardware counters per pipeline stage (Linux perf_event_open)
+
+Introduction
+============
+Wall time says a stage is slow, not why. Cycles, instructions, last-level
+cache misses and branch misses say whether it is waiting on memory (low IPC,
+high LLC misses per kilo-instruction) or on arithmetic:
+
+    ```cpp
+    #include "perf_counters.h"
+
+    perf_counters_enable();             // once, from main; false if unavailable
+    {
+        PerfScope scope(Stage::Inference);
+        run_whisper(...);               // children forked here are counted too
+    }
+    std::string json = perf_json();     // {"available":true,"stages":{…},"workers":[…]}
+    ```
+
+Counters are opened on the calling thread with `inherit` set, so the
+whisper-cli and ffmpeg processes a stage forks are included once they have
+been waited for. Only user-space events are counted, which works under the
+default perf_event_paranoid of 2.
+
+When the kernel, the container or the platform refuses a counter, the
+failure is recorded once, every scope becomes a no-op and the report says
+why. Events the PMU lacks (LLC misses in many VMs) are left out individually.
+*/
+
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "metrics.h"
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PERF_COUNTERS_LINUX 1
+#endif
+
+enum PerfEvent
+{
+    kPerfCycles,
+    kPerfInstructions,
+    kPerfLlcMisses,
+    kPerfBranchMisses,
+    kPerfEvents
+};
+
+struct PerfTotals
+{
+    std::uint64_t value[kPerfEvents] = {};
+    bool seen[kPerfEvents] = {};
+    std::uint64_t scopes = 0;
+
+    void add(const PerfTotals &o)
+    {
+        for (int e = 0; e < kPerfEvents; ++e)
+        {
+            value[e] += o.value[e];
+            seen[e] = seen[e] || o.seen[e];
+        }
+        scopes += o.scopes;
+    }
+};
+
+namespace perf_detail
+{
+struct State
+{
+    std::mutex lock;
+    bool enabled = false;
+    bool available = false;
+    std::string reason = "not enabled";
+    std::map<std::pair<Stage, std::size_t>, PerfTotals> totals; // (stage, worker)
+};
+
+inline State &state()
+{
+    static State s;
+    return s;
+}
+
+#ifdef PERF_COUNTERS_LINUX
+inline int open_counter(PerfEvent e)
+{
+    static const std::uint64_t kConfig[kPerfEvents] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES};
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kConfig[e];
+    attr.inherit = 1; // count the processes this thread forks
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1, -1, 0));
+}
+#endif
+} // namespace perf_detail
+
+/* Turn counting on; false (and perf_json() says why) if the host refuses it. */
+inline bool perf_counters_enable()
+{
+    auto &s = perf_detail::state();
+    std::lock_guard<std::mutex> g(s.lock);
+    s.enabled = true;
+#ifdef PERF_COUNTERS_LINUX
+    const int fd = perf_detail::open_counter(kPerfCycles);
+    if (fd < 0)
+    {
+        s.reason = std::string("perf_event_open: ") + std::strerror(errno);
+        if (errno == EACCES || errno == EPERM)
+            s.reason += " (see /proc/sys/kernel/perf_event_paranoid)";
+        return false;
+    }
+    close(fd);
+    s.available = true;
+    s.reason.clear();
+#else
+    s.reason = "hardware counters need Linux perf_event_open";
+#endif
+    return s.available;
+}
+
+inline bool perf_counters_requested()
+{
+    auto &s = perf_detail::state();
+    std::lock_guard<std::mutex> g(s.lock);
+    return s.enabled;
+}
+
+inline bool perf_counters_active()
+{
+    auto &s = perf_detail::state();
+    std::lock_guard<std::mutex> g(s.lock);
+    return s.available;
+}
+
+/* Counts the calling thread (and what it forks) for the scope's lifetime. */
+class PerfScope
+{
+public:
+    explicit PerfScope(Stage stage) : stage_(stage)
+    {
+#ifdef PERF_COUNTERS_LINUX
+        if (!perf_counters_active())
+            return;
+        for (int e = 0; e < kPerfEvents; ++e)
+            fd_[e] = perf_detail::open_counter(PerfEvent(e));
+#endif
+    }
+
+    ~PerfScope()
+    {
+#ifdef PERF_COUNTERS_LINUX
+        PerfTotals t;
+        bool any = false;
+        for (int e = 0; e < kPerfEvents; ++e)
+        {
+            if (fd_[e] < 0)
+                continue;
+            std::uint64_t buf[3] = {}; // value, time enabled, time running
+            if (read(fd_[e], buf, sizeof(buf)) == ssize_t(sizeof(buf)) && buf[2] > 0)
+            {
+                /* Scale up if the PMU was multiplexed between events. */
+                t.value[e] = buf[2] < buf[1] ? std::uint64_t(double(buf[0]) * double(buf[1]) / double(buf[2]))
+                                             : buf[0];
+                t.seen[e] = any = true;
+            }
+            close(fd_[e]);
+        }
+        if (!any)
+            return;
+        t.scopes = 1;
+        auto &s = perf_detail::state();
+        std::lock_guard<std::mutex> g(s.lock);
+        s.totals[{stage_, this_worker()}].add(t);
+#endif
+    }
+
+    PerfScope(const PerfScope &) = delete;
+    PerfScope &operator=(const PerfScope &) = delete;
+
+private:
+    Stage stage_;
+    int fd_[kPerfEvents] = {-1, -1, -1, -1};
+};
+
+namespace perf_detail
+{
+inline std::string totals_json(const PerfTotals &t)
+{
+    static const char *kNames[kPerfEvents] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+    std::string out = "{\"scopes\":" + std::to_string(t.scopes);
+    for (int e = 0; e < kPerfEvents; ++e)
+        if (t.seen[e])
+            out += std::string(",\"") + kNames[e] + "\":" + std::to_string(t.value[e]);
+    char buf[96];
+    const double instr = double(t.value[kPerfInstructions]);
+    if (t.seen[kPerfCycles] && t.seen[kPerfInstructions] && t.value[kPerfCycles])
+    {
+        std::snprintf(buf, sizeof(buf), ",\"ipc\":%.3f", instr / double(t.value[kPerfCycles]));
+        out += buf;
+    }
+    if (t.seen[kPerfLlcMisses] && t.seen[kPerfInstructions] && instr > 0.0)
+    {
+        std::snprintf(buf, sizeof(buf), ",\"llc_mpki\":%.3f", 1000.0 * double(t.value[kPerfLlcMisses]) / instr);
+        out += buf;
+    }
+    if (t.seen[kPerfBranchMisses] && t.seen[kPerfInstructions] && instr > 0.0)
+    {
+        std::snprintf(buf, sizeof(buf), ",\"branch_mpki\":%.3f", 1000.0 * double(t.value[kPerfBranchMisses]) / instr);
+        out += buf;
+    }
+    return out + "}";
+}
+} // namespace perf_detail
+
+/* {"available":…,"reason":…,"stages":{"<stage>":{…}},"workers":[{"worker":…,"stage":…,…}]} */
+inline std::string perf_json()
+{
+    auto &s = perf_detail::state();
+    std::lock_guard<std::mutex> g(s.lock);
+    std::string out = std::string("{\"available\":") + (s.available ? "true" : "false");
+    if (!s.reason.empty())
+        out += ",\"reason\":\"" + s.reason + "\"";
+
+    std::map<Stage, PerfTotals> stages;
+    for (const auto &kv : s.totals)
+        stages[kv.first.first].add(kv.second);
+    out += ",\"stages\":{";
+    bool first = true;
+    for (const auto &kv : stages)
+    {
+        out += std::string(first ? "" : ",") + "\"" + stage_name(kv.first) + "\":" + perf_detail::totals_json(kv.second);
+        first = false;
+    }
+    out += "},\"workers\":[";
+    first = true;
+    for (const auto &kv : s.totals)
+    {
+        std::string t = perf_detail::totals_json(kv.second);
+        out += std::string(first ? "" : ",") + "{\"worker\":" + std::to_string(kv.first.second) + ",\"stage\":\"" +
+               stage_name(kv.first.first) + "\"," + t.substr(1);
+        first = false;
+    }
+    return out + "]}";
+}
@@ -0,0 +1,1719 @@
+// pipeline.h – stages shared by transcribe.cpp and transcribe-mp4.cpp
+//
+// The including translation unit defines DR_WAV_IMPLEMENTATION before
+// including this header.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dr_wav.h"
+#include "frame_index.h"
+#include "memory_stats.h"
+#include "metrics.h"
+#include "mp3_decoder.h"
+#include "pcm_pool.h"
+#include "perf_counters.h"
+#include "simd.h"
+#include "speech_pack.h"
+#include "vad.h"
+#include "watchdog.h"
+#include "webm_opus.h"
+
+namespace fs = std::filesystem;
+
+/*───────────────────────────────────────────────────────────────
+  Helper – run external command, report whether it succeeded
+──────────────────────────────────────────────────────────────*/
+inline bool try_cmd(const std::string &cmd, bool echo = false)
+{
+    if (echo)
+        std::cout << "\n> " << cmd << std::endl;
+    return std::system(cmd.c_str()) == 0;
+}
+
+/*───────────────────────────────────────────────────────────────
+  A job that cannot go on – a required command failed or there is
+  nothing to transcribe. The command-line tools exit with `status`;
+  a daemon fails just that job and keeps serving.
+──────────────────────────────────────────────────────────────*/
+struct JobError : std::runtime_error
+{
+    JobError(const std::string &what, int status = 1) : std::runtime_error(what), status(status) {}
+    int status;
+};
+
+/*───────────────────────────────────────────────────────────────
+  Helper – run external command, abort the job if it fails
+──────────────────────────────────────────────────────────────*/
+inline void run_cmd(const std::string &cmd, bool echo = false)
+{
+    if (echo)
+        std::cout << "\n> " << cmd << std::endl;
+    const int ret = std::system(cmd.c_str());
+    if (ret)
+        throw JobError("Command failed (" + std::to_string(ret) + "): " + cmd,
+                       WIFEXITED(ret) && WEXITSTATUS(ret) ? WEXITSTATUS(ret) : 1);
+}
+
+/*───────────────────────────────────────────────────────────────
+  Helper – child process with its stdout on a pipe, read line by
+  line while it runs and killable at any point (POSIX)
+──────────────────────────────────────────────────────────────*/
+class ChildProcess
+{
+public:
+    ChildProcess() = default;
+    ChildProcess(const ChildProcess &) = delete;
+    ChildProcess &operator=(const ChildProcess &) = delete;
+    ~ChildProcess()
+    {
+        if (pid_ > 0)
+        {
+            kill();
+            wait();
+        }
+    }
+
+    /* `sh -c cmd` in its own process group, so kill() reaches grandchildren. */
+    bool start(const std::string &cmd)
+    {
+        int fds[2];
+        if (::pipe(fds) != 0)
+            return false;
+        pid_ = ::fork();
+        if (pid_ < 0)
+        {
+            ::close(fds[0]);
+            ::close(fds[1]);
+            return false;
+        }
+        if (pid_ == 0)
+        {
+            ::setpgid(0, 0);
+            ::dup2(fds[1], STDOUT_FILENO);
+            ::close(fds[0]);
+            ::close(fds[1]);
+            ::execl("/bin/sh", "sh", "-c", cmd.c_str(), static_cast<char *>(nullptr));
+            ::_exit(127);
+        }
+        ::setpgid(pid_, pid_);
+        ::close(fds[1]);
+        fd_ = fds[0];
+        return true;
+    }
+
+    /* Next line of output (without '\n'); false at end of output, or once
+       `deadline` has passed – timed_out() then tells the two apart. */
+    bool read_line(std::string &line,
+                   std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+    {
+        for (;;)
+        {
+            const auto nl = buf_.find('\n');
+            if (nl != std::string::npos)
+            {
+                line = buf_.substr(0, nl);
+                buf_.erase(0, nl + 1);
+                return true;
+            }
+            if (fd_ >= 0 && deadline != std::chrono::steady_clock::time_point::max())
+            {
+                const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now());
+                pollfd pfd{fd_, POLLIN, 0};
+                const int ready = left.count() > 0 ? ::poll(&pfd, 1, int(std::min<long long>(left.count(), 1 << 30))) : 0;
+                if (ready < 0 && errno == EINTR)
+                    continue;
+                if (ready == 0)
+                {
+                    timed_out_ = true;
+                    return false;
+                }
+            }
+            char tmp[4096];
+            const ssize_t n = fd_ < 0 ? 0 : ::read(fd_, tmp, sizeof(tmp));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                if (buf_.empty())
+                    return false;
+                line.swap(buf_);
+                buf_.clear();
+                return true;
+            }
+            buf_.append(tmp, std::size_t(n));
+        }
+    }
+
+    void kill()
+    {
+        if (pid_ > 0)
+            ::kill(-pid_, SIGKILL);
+    }
+
+    bool timed_out() const { return timed_out_; }
+
+    /* Exit status as std::system would report it; -1 if never started. */
+    int wait()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+        if (pid_ <= 0)
+            return -1;
+        int status = 0;
+        while (::waitpid(pid_, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        pid_ = -1;
+        return status;
+    }
+
+private:
+    pid_t pid_ = -1;
+    int fd_ = -1;
+    std::string buf_;
+    bool timed_out_ = false;
+};
+
+/*───────────────────────────────────────────────────────────────
+  Helper – run external command with a time limit (0 = none), its
+  output passed through; exit status, or -1 if it had to be killed
+──────────────────────────────────────────────────────────────*/
+inline int run_cmd_timeout(const std::string &cmd, double timeout_sec, bool echo = false)
+{
+    using clock = std::chrono::steady_clock;
+    if (echo)
+        std::cout << "\n> " << cmd << std::endl;
+    const auto deadline = timeout_sec > 0.0
+                              ? clock::now() + std::chrono::milliseconds(std::llround(timeout_sec * 1000))
+                              : clock::time_point::max();
+    ChildProcess proc;
+    if (!proc.start(cmd))
+        return -1;
+    std::string line;
+    while (proc.read_line(line, deadline))
+        std::cout << line << '\n';
+    if (proc.timed_out())
+    {
+        proc.kill();
+        proc.wait();
+        std::cerr << "\nTimed out after " << timeout_sec << " s: " << cmd << std::endl;
+        return -1;
+    }
+    return proc.wait();
+}
+
+/*───────────────────────────────────────────────────────────────
+  Helper – write 16 kHz mono float PCM as a 16-bit WAV (dr_wav)
+──────────────────────────────────────────────────────────────*/
+inline bool write_wav_16k(const std::string &path, const float *pcm, std::size_t count)
+{
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_PCM;
+    format.channels = 1;
+    format.sampleRate = 16000;
+    format.bitsPerSample = 16;
+
+    drwav wav;
+    if (!drwav_init_file_write(&wav, path.c_str(), &format, nullptr))
+        return false;
+
+    std::vector<drwav_int16> s16(count);
+    drwav_f32_to_s16(s16.data(), pcm, count);
+    const drwav_uint64 written = drwav_write_pcm_frames(&wav, s16.size(), s16.data());
+    drwav_uninit(&wav);
+    return written == s16.size();
+}
+
+/* Same, from pooled blocks – one block of int16 staging, no float copy. With
+   a layout, only its spans are written, each at its place on the packed
+   timeline with silence in between. */
+inline bool write_wav_16k(const std::string &path, const PcmBuffer &pcm, const SpeechLayout *layout = nullptr)
+{
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_PCM;
+    format.channels = 1;
+    format.sampleRate = 16000;
+    format.bitsPerSample = 16;
+
+    drwav wav;
+    if (!drwav_init_file_write(&wav, path.c_str(), &format, nullptr))
+        return false;
+
+    std::vector<drwav_int16> s16(PcmPool::kBlockSamples);
+    bool ok = true;
+    std::size_t written = 0;
+    const auto put = [&](std::size_t from, std::size_t count, bool silent) {
+        for (std::size_t done = 0; ok && done < count;)
+        {
+            const std::size_t n = std::min(s16.size(), count - done);
+            if (silent)
+                std::fill(s16.begin(), s16.begin() + std::ptrdiff_t(n), drwav_int16(0));
+            else
+                pcm.read_s16(from + done, n, s16.data());
+            ok = drwav_write_pcm_frames(&wav, n, s16.data()) == n;
+            done += n;
+            written += n;
+        }
+    };
+    if (!layout)
+        put(0, pcm.size(), false);
+    else
+        for (const PackedSpan &span : layout->spans)
+        {
+            const auto sample = [](double sec) { return std::size_t(std::llround(sec * 16000.0)); };
+            const std::size_t at = sample(span.at), from = std::min(sample(span.src_start), pcm.size());
+            if (at > written)
+                put(0, at - written, true);
+            put(from, std::min(pcm.size() - from, sample(span.length())), false);
+        }
+    drwav_uninit(&wav);
+    return ok;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Helper – command-line flags after the positional arguments
+  (`--name value`, `--name=value`, or a bare switch)
+──────────────────────────────────────────────────────────────*/
+struct CliArgs
+{
+    std::vector<std::string> positional;
+    std::map<std::string, std::string> flags;
+
+    bool has(const std::string &name) const { return flags.count(name) != 0; }
+
+    std::string get(const std::string &name, const std::string &def = "") const
+    {
+        const auto it = flags.find(name);
+        return it == flags.end() ? def : it->second;
+    }
+
+    double num(const std::string &name, double def) const
+    {
+        const auto it = flags.find(name);
+        return it == flags.end() || it->second.empty() ? def : std::atof(it->second.c_str());
+    }
+};
+
+inline CliArgs parse_args(int argc, char *argv[], const std::set<std::string> &switches = {})
+{
+    CliArgs args;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        if (a.rfind("--", 0) != 0)
+        {
+            args.positional.push_back(a);
+            continue;
+        }
+        const auto eq = a.find('=');
+        if (eq != std::string::npos)
+            args.flags[a.substr(0, eq)] = a.substr(eq + 1);
+        else if (switches.count(a) || i + 1 >= argc || std::string(argv[i + 1]).rfind("--", 0) == 0)
+            args.flags[a] = "";
+        else
+            args.flags[a] = argv[++i];
+    }
+    return args;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Host profile – tuned defaults for this machine, written by
+  `bench scale --profile`; flags given explicitly still win
+──────────────────────────────────────────────────────────────*/
+struct HostProfile
+{
+    std::size_t workers = 1;
+    int threads = 0;     // whisper-cli -t; 0 = its default
+    int chunk_len = 600; // seconds
+    std::string note;    // where the numbers came from
+};
+
+inline bool save_host_profile(const std::string &path, const HostProfile &p)
+{
+    std::ofstream out(path);
+    if (!p.note.empty())
+        out << "# " << p.note << '\n';
+    out << "workers=" << p.workers << "\nthreads=" << p.threads << "\nchunk_len=" << p.chunk_len << '\n';
+    return bool(out);
+}
+
+inline bool load_host_profile(const std::string &path, HostProfile &p)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    for (std::string line; std::getline(in, line);)
+    {
+        const auto eq = line.find('=');
+        if (line.empty() || line[0] == '#' || eq == std::string::npos)
+            continue;
+        const std::string key = line.substr(0, eq);
+        const long value = std::atol(line.c_str() + eq + 1);
+        if (key == "workers")
+            p.workers = std::size_t(std::max(1L, value));
+        else if (key == "threads")
+            p.threads = int(value);
+        else if (key == "chunk_len")
+            p.chunk_len = int(std::max(1L, value));
+    }
+    return true;
+}
+
+/* --profile PATH supplies --workers, --threads and --chunk-len where they are not given. */
+inline bool apply_host_profile(CliArgs &args)
+{
+    if (!args.has("--profile"))
+        return true;
+    HostProfile p;
+    if (!load_host_profile(args.get("--profile"), p))
+        return false;
+    args.flags.emplace("--workers", std::to_string(p.workers));
+    args.flags.emplace("--threads", std::to_string(p.threads));
+    args.flags.emplace("--chunk-len", std::to_string(p.chunk_len));
+    return true;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Helper – timestamps ("SS", "MM:SS", "HH:MM:SS.mmm")
+──────────────────────────────────────────────────────────────*/
+inline bool parse_time(const std::string &txt, double &sec)
+{
+    sec = 0.0;
+    std::size_t start = 0;
+    int fields = 0;
+    while (start <= txt.size())
+    {
+        const std::size_t colon = std::min(txt.find(':', start), txt.size());
+        const std::string part = txt.substr(start, colon - start);
+        char *end = nullptr;
+        const double v = std::strtod(part.c_str(), &end);
+        if (part.empty() || *end != '\0' || v < 0.0 || ++fields > 3)
+            return false;
+        sec = sec * 60.0 + v;
+        start = colon + 1;
+    }
+    return true;
+}
+
+inline std::string format_timestamp(double sec)
+{
+    const auto ms = static_cast<long long>(std::llround(std::max(0.0, sec) * 1000.0));
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%02lld:%02lld:%02lld.%03lld",
+                  ms / 3600000, (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000);
+    return buf;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Segments – whisper-cli "[HH:MM:SS.mmm --> HH:MM:SS.mmm]  text" lines
+──────────────────────────────────────────────────────────────*/
+struct Segment
+{
+    double t0 = 0.0, t1 = 0.0; // seconds
+    std::string text;
+};
+
+inline bool parse_segment_line(const std::string &line, Segment &seg)
+{
+    const auto open = line.find('[');
+    const auto arrow = line.find(" --> ");
+    const auto close = line.find(']');
+    if (open != 0 || arrow == std::string::npos || close == std::string::npos || arrow > close)
+        return false;
+    if (!parse_time(line.substr(1, arrow - 1), seg.t0) ||
+        !parse_time(line.substr(arrow + 5, close - arrow - 5), seg.t1))
+        return false;
+
+    std::size_t text = close + 1;
+    while (text < line.size() && std::isspace(static_cast<unsigned char>(line[text])))
+        ++text;
+    seg.text = line.substr(text);
+    return true;
+}
+
+inline std::string format_segment_line(const Segment &seg)
+{
+    return "[" + format_timestamp(seg.t0) + " --> " + format_timestamp(seg.t1) + "]   " + seg.text;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Helper – JSON string literal (quotes included) for event lines
+──────────────────────────────────────────────────────────────*/
+inline std::string json_string(const std::string &s)
+{
+    std::string out = "\"";
+    for (unsigned char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\', out += char(c);
+        else if (c == '\n')
+            out += "\\n";
+        else if (c < 0x20)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else
+            out += char(c);
+    }
+    return out + '"';
+}
+
+/*───────────────────────────────────────────────────────────────
+  Progress – one tracker per run. Workers report what they are on
+  and how far into it they are; at most every 250 ms (and once at
+  the end) a snapshot goes out as an NDJSON event on `fd` and as
+  the single-line ASCII bar on stdout.
+──────────────────────────────────────────────────────────────*/
+class ProgressReporter
+{
+public:
+    /* `audio_sec` holds the length of each item; fd < 0 disables events. */
+    ProgressReporter(std::vector<double> audio_sec, std::size_t workers, int fd = -1, bool bar = true)
+        : item_sec_(std::move(audio_sec)), workers_(std::max<std::size_t>(1, workers)), fd_(fd), bar_(bar),
+          start_(clock::now())
+    {
+        for (double sec : item_sec_)
+            total_sec_ += sec;
+        emit(true);
+    }
+
+    /* Worker `worker` is at `at_sec` into item `item`, in `stage` ("decode", "transcribe"). */
+    void update(std::size_t worker, std::size_t item, const char *stage, double at_sec = 0.0)
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        Worker &w = workers_[worker];
+        w.item = item;
+        w.stage = stage;
+        w.at_sec = std::min(std::max(0.0, at_sec), item < item_sec_.size() ? item_sec_[item] : at_sec);
+        emit(false);
+    }
+
+    /* Item finished; `cached` items (from a checkpoint) do not count towards the speed. */
+    void finish(std::size_t worker, std::size_t item, bool cached = false)
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        const double sec = item < item_sec_.size() ? item_sec_[item] : 0.0;
+        ++items_done_;
+        done_sec_ += sec;
+        if (cached)
+            cached_sec_ += sec;
+        workers_[worker] = Worker();
+        emit(items_done_ == item_sec_.size());
+    }
+
+    /* Final event, even if some items never ran (e.g. a preview budget ran out). */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        if (!closed_)
+            emit(true, true);
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Worker
+    {
+        std::size_t item = 0;
+        const char *stage = "idle";
+        double at_sec = 0.0;
+    };
+
+    static std::string clock_text(double sec)
+    {
+        const auto s = static_cast<long long>(std::max(0.0, sec));
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%lld:%02lld:%02lld", s / 3600, (s / 60) % 60, s % 60);
+        return buf;
+    }
+
+    void emit(bool force, bool final = false)
+    {
+        const auto now = clock::now();
+        if (!force && now - last_emit_ < std::chrono::milliseconds(250))
+            return;
+        last_emit_ = now;
+        final = final || items_done_ == item_sec_.size();
+        closed_ = final;
+
+        /* Audio covered so far, including the parts of items in flight */
+        double audio = done_sec_;
+        for (const Worker &w : workers_)
+            if (std::strcmp(w.stage, "idle") != 0)
+                audio += w.at_sec;
+        const double elapsed = std::chrono::duration<double>(now - start_).count();
+        const double worked = audio - cached_sec_;
+        const double speed = elapsed > 0.0 && worked > 0.0 ? worked / elapsed : 0.0; // × realtime
+        const double eta = speed > 0.0 ? (total_sec_ - audio) / speed : -1.0;
+
+        if (fd_ >= 0)
+        {
+            char head[320];
+            std::snprintf(head, sizeof(head),
+                          "{\"type\":\"%s\",\"elapsed\":%.1f,\"items_done\":%zu,\"items_total\":%zu,"
+                          "\"audio_done\":%.1f,\"audio_total\":%.1f,\"speed\":%.3f,\"rtf\":%.3f,\"eta\":%.1f,"
+                          "\"workers\":[",
+                          final ? "done" : "progress", elapsed, items_done_, item_sec_.size(), audio,
+                          total_sec_, speed, speed > 0.0 ? 1.0 / speed : 0.0, eta);
+            std::string line = head;
+            for (std::size_t i = 0; i < workers_.size(); ++i)
+            {
+                char buf[128];
+                std::snprintf(buf, sizeof(buf), "%s{\"id\":%zu,\"stage\":\"%s\",\"item\":%zu,\"at\":%.1f}",
+                              i ? "," : "", i, workers_[i].stage, workers_[i].item, workers_[i].at_sec);
+                line += buf;
+            }
+            line += "]}\n";
+            for (std::size_t off = 0; off < line.size();)
+            {
+                const ssize_t n = ::write(fd_, line.data() + off, line.size() - off);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    break;
+                off += std::size_t(n);
+            }
+        }
+
+        if (bar_)
+        {
+            constexpr int bar_width = 50;
+            const double ratio = total_sec_ > 0.0 ? std::min(1.0, audio / total_sec_)
+                                                  : item_sec_.empty() ? 1.0 : double(items_done_) / item_sec_.size();
+            const int filled = static_cast<int>(ratio * bar_width);
+            std::string text = "\r[";
+            for (int i = 0; i < bar_width; ++i)
+                text += i < filled ? '=' : (i == filled ? '>' : ' ');
+            char tail[160];
+            std::snprintf(tail, sizeof(tail), "] %3d%% (%zu/%zu)", static_cast<int>(ratio * 100), items_done_,
+                          item_sec_.size());
+            text += tail;
+            if (final)
+                text += std::string(48, ' ') + "\n";
+            else if (speed > 0.0)
+            {
+                std::snprintf(tail, sizeof(tail), "  %s / %s  %.1fx  ETA %s  ", clock_text(audio).c_str(),
+                              clock_text(total_sec_).c_str(), speed, clock_text(eta).c_str());
+                text += tail;
+            }
+            std::cout << text << std::flush;
+        }
+    }
+
+    std::vector<double> item_sec_;
+    std::vector<Worker> workers_;
+    int fd_;
+    bool bar_;
+    clock::time_point start_, last_emit_{};
+    double total_sec_ = 0.0, done_sec_ = 0.0, cached_sec_ = 0.0;
+    std::size_t items_done_ = 0;
+    bool closed_ = false;
+    std::mutex m_;
+};
+
+/*───────────────────────────────────────────────────────────────
+  Whisper – run whisper-cli on one WAV under the repetition
+  watchdog. A runaway decode is killed; the span is decoded once
+  more without prompt context and at a higher temperature, and if
+  it loops again it is marked and skipped. `lines` receives the
+  output (timestamps relative to the WAV); on failure or timeout
+  false is returned with the reason in `error`.
+──────────────────────────────────────────────────────────────*/
+struct InferenceBackend;
+
+struct WhisperOptions
+{
+    std::string binary = "./whisper.cpp/build/bin/whisper-cli";
+    std::string model;
+    bool merge_stderr = false; // keep whisper's log lines in the output
+    bool watchdog = true;
+    int retries = 1;           // re-decodes of a looping span before skipping it
+    double min_skip_sec = 5.0; // a skipped span is at least this long
+    double timeout_sec = 0.0;  // per whisper-cli run; 0 = 120 s + 4 × audio length
+    int threads = 0;           // whisper-cli -t; 0 = its default
+    int audio_ctx = 0;         // whisper-cli -ac; 0 = full context (1500 positions, 30 s)
+    bool adaptive_ctx = false; // set audio_ctx per input from its length (adaptive_audio_ctx)
+    std::function<void(double)> on_segment; // end time of each segment as it is printed
+    std::shared_ptr<const InferenceBackend> backend; // null = whisper-cli
+    bool pack_speech = false; // send only VAD speech, packed end to end (speech_pack.h)
+};
+
+/* whisper_print_timings: "load time = 97.12 ms" (only seen with merge_stderr) */
+inline void note_model_load(const std::string &line)
+{
+    const auto at = line.find("load time =");
+    if (at == std::string::npos)
+        return;
+    const double ms = std::atof(line.c_str() + at + 11);
+    PipelineCounters &pc = pipeline_counters();
+    pc.model_loads.fetch_add(1, std::memory_order_relaxed);
+    pc.model_load_us.fetch_add(std::uint64_t(ms * 1000.0), std::memory_order_relaxed);
+}
+
+/* Length of a WAV from its header; < 0 if it cannot be read. */
+inline double wav_duration_sec(const std::string &path)
+{
+    drwav probe;
+    if (!drwav_init_file(&probe, path.c_str(), nullptr))
+        return -1.0;
+    const double sec = double(probe.totalPCMFrameCount) / probe.sampleRate;
+    drwav_uninit(&probe);
+    return sec;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Adaptive audio context – the encoder attends over 1500 positions
+  (20 ms each, 30 s) however short the input, the rest being
+  padding. Inputs well under 30 s get a context sized to their
+  length plus a margin – 10 % and 2 s, in steps of 64 positions,
+  never under 256 – since text near a too-tight end is lost.
+──────────────────────────────────────────────────────────────*/
+constexpr int kFullAudioCtx = 1500;
+
+/* 0 (full context) when the input needs nearly all of it anyway. */
+inline int adaptive_audio_ctx(double sec)
+{
+    if (sec <= 0.0)
+        return 0;
+    const double need = (sec * 1.1 + 2.0) * kFullAudioCtx / 30.0;
+    const int ctx = std::max(256, (int(std::ceil(need)) + 63) / 64 * 64);
+    return ctx >= kFullAudioCtx ? 0 : ctx;
+}
+
+/* Encoder positions a run over `sec` of audio costs, and what it would at full context. */
+inline void count_encoder_run(double sec, int audio_ctx)
+{
+    const auto windows = std::uint64_t(std::max(1.0, std::ceil(sec / 30.0 - 1e-9)));
+    PipelineCounters &pc = pipeline_counters();
+    pc.encoder_runs.fetch_add(1, std::memory_order_relaxed);
+    if (audio_ctx > 0 && audio_ctx < kFullAudioCtx)
+        pc.encoder_reduced.fetch_add(1, std::memory_order_relaxed);
+    pc.encoder_positions.fetch_add(windows * std::uint64_t(audio_ctx > 0 ? audio_ctx : kFullAudioCtx),
+                                   std::memory_order_relaxed);
+    pc.encoder_full_positions.fetch_add(windows * kFullAudioCtx, std::memory_order_relaxed);
+}
+
+/* {"runs":…,"reduced_runs":…,"ctx_share":…}: ctx_share is positions encoded over those at full context */
+inline double encoder_ctx_share()
+{
+    const PipelineCounters &pc = pipeline_counters();
+    const std::uint64_t full = pc.encoder_full_positions.load();
+    return full ? double(pc.encoder_positions.load()) / double(full) : 1.0;
+}
+
+inline std::string encoder_json()
+{
+    const PipelineCounters &pc = pipeline_counters();
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "{\"runs\":%llu,\"reduced_runs\":%llu,\"ctx_share\":%.4f}",
+                  static_cast<unsigned long long>(pc.encoder_runs.load()),
+                  static_cast<unsigned long long>(pc.encoder_reduced.load()), encoder_ctx_share());
+    return buf;
+}
+
+inline bool run_whisper(const std::string &wav, const WhisperOptions &o, std::vector<std::string> &lines,
+                        std::string &error)
+{
+    using clock = std::chrono::steady_clock;
+    WatchdogStats &stats = watchdog_stats();
+    lines.clear();
+    double offset = 0.0;
+    int attempt = 0;
+
+    double duration = wav_duration_sec(wav);
+    if (duration < 0.0)
+        duration = 1e300;
+    const double timeout = o.timeout_sec > 0.0 ? o.timeout_sec
+                                               : 120.0 + 4.0 * (duration < 1e300 ? duration : 600.0);
+
+    while (offset < duration)
+    {
+        std::string cmd = o.binary + " -m \"" + o.model + "\" -f \"" + wav + "\"";
+        if (o.threads > 0)
+            cmd += " -t " + std::to_string(o.threads);
+        if (o.audio_ctx > 0)
+            cmd += " -ac " + std::to_string(o.audio_ctx);
+        if (offset > 0.0)
+            cmd += " -ot " + std::to_string(std::llround(offset * 1000));
+        if (attempt > 0)
+            cmd += " -mc 0 -tp 0.4"; // no prompt carry-over, sample instead of greedy
+        cmd += o.merge_stderr ? " 2>&1" : " 2>/dev/null";
+
+        ChildProcess proc;
+        if (!proc.start(cmd))
+        {
+            error = "could not start whisper-cli";
+            return false;
+        }
+        const auto deadline = clock::now() + std::chrono::milliseconds(std::llround(timeout * 1000));
+        RepetitionWatchdog dog;
+        std::vector<std::string> out;
+        std::string line;
+        Segment seg;
+        bool tripped = false;
+        while (proc.read_line(line, deadline))
+        {
+            out.push_back(line);
+            if (!parse_segment_line(line, seg))
+            {
+                note_model_load(line);
+                continue;
+            }
+            if (o.on_segment)
+                o.on_segment(seg.t1);
+            if (o.watchdog && dog.feed(seg))
+            {
+                tripped = true;
+                proc.kill();
+                break;
+            }
+        }
+        if (proc.timed_out())
+        {
+            proc.kill();
+            proc.wait();
+            error = "whisper-cli timed out after " + std::to_string(std::lround(timeout)) + " s";
+            return false;
+        }
+        const int ret = proc.wait();
+
+        if (!tripped)
+        {
+            if (ret)
+            {
+                error = WIFEXITED(ret) ? "whisper-cli exited with status " + std::to_string(WEXITSTATUS(ret))
+                                       : "whisper-cli was killed by signal " + std::to_string(WTERMSIG(ret));
+                return false;
+            }
+            if (attempt > 0)
+                ++stats.recovered;
+            lines.insert(lines.end(), out.begin(), out.end());
+            return true;
+        }
+
+        /* Keep what came before the loop */
+        ++stats.fired;
+        for (const auto &l : out)
+            if (!parse_segment_line(l, seg) || seg.t0 < dog.loop_start())
+                lines.push_back(l);
+        std::cerr << "\nwatchdog: " << dog.reason() << " at " << format_timestamp(dog.loop_start())
+                  << " in " << wav << std::endl;
+
+        if (attempt < o.retries)
+        {
+            ++attempt;
+            ++stats.retried;
+            offset = dog.loop_start();
+            continue;
+        }
+
+        /* Give up on the span: mark it and carry on after it */
+        const double skip_to = std::max(dog.loop_end(), dog.loop_start() + o.min_skip_sec);
+        lines.push_back(format_segment_line({dog.loop_start(), skip_to, "[repetition removed]"}));
+        ++stats.skipped;
+        stats.skipped_ms += std::llround((skip_to - dog.loop_start()) * 1000);
+        offset = skip_to;
+        attempt = 0;
+    }
+    return true;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Inference backends – what turns a chunk WAV into segment lines.
+  whisper-cli is the real one. The mock reads only the WAV header
+  and prints deterministic segments at a fixed realtime factor –
+  billed, like the encoder, per 30 s window or per reduced audio
+  context – so a run measures everything but the model and needs
+  no model file.
+──────────────────────────────────────────────────────────────*/
+struct InferenceBackend
+{
+    virtual ~InferenceBackend() = default;
+    virtual std::string name() const = 0;
+    virtual bool transcribe(const std::string &wav, const WhisperOptions &o, std::vector<std::string> &lines,
+                            std::string &error) const = 0;
+};
+
+struct WhisperCliBackend : InferenceBackend
+{
+    std::string name() const override { return "whisper-cli"; }
+    bool transcribe(const std::string &wav, const WhisperOptions &o, std::vector<std::string> &lines,
+                    std::string &error) const override
+    {
+        return run_whisper(wav, o, lines, error);
+    }
+};
+
+class MockBackend : public InferenceBackend
+{
+public:
+    explicit MockBackend(double rtf, double load_sec = 0.0, double segment_sec = 5.0)
+        : rtf_(rtf), load_sec_(load_sec), segment_sec_(segment_sec)
+    {
+    }
+
+    std::string name() const override
+    {
+        char buf[64];
+        if (load_sec_ > 0.0)
+            std::snprintf(buf, sizeof(buf), "mock:%g:%g", rtf_, load_sec_);
+        else
+            std::snprintf(buf, sizeof(buf), "mock:%g", rtf_);
+        return buf;
+    }
+
+    bool transcribe(const std::string &wav, const WhisperOptions &o, std::vector<std::string> &lines,
+                    std::string &error) const override
+    {
+        lines.clear();
+        const double duration = wav_duration_sec(wav);
+        if (duration < 0.0)
+        {
+            error = "mock: cannot read " + wav;
+            return false;
+        }
+        const double pace = pace_of(duration, o);
+        const auto start = std::chrono::steady_clock::now() + std::chrono::microseconds(std::llround(load_sec_ * 1e6));
+        for (const Segment &seg : segments(duration))
+        {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(std::llround(seg.t1 * pace * 1e6)));
+            lines.push_back(format_segment_line(seg));
+            if (o.on_segment)
+                o.on_segment(seg.t1);
+        }
+        return true;
+    }
+
+private:
+    /* Billed like the encoder: whole 30 s windows, or the reduced context */
+    double pace_of(double duration, const WhisperOptions &o) const
+    {
+        const double windows = std::max(1.0, std::ceil(duration / 30.0 - 1e-9));
+        const double billed = windows * 30.0 * (o.audio_ctx > 0 ? double(o.audio_ctx) / kFullAudioCtx : 1.0);
+        return duration > 0.0 ? rtf_ * std::max(duration, billed) / duration : 0.0;
+    }
+
+    /* Same WAV length, same text: seeded by the length in milliseconds */
+    std::vector<Segment> segments(double duration) const
+    {
+        static const char *kWords[] = {"the", "model", "audio", "chunk", "window", "speech", "segment", "time",
+                                       "and", "of", "to", "a", "is", "that", "we", "it"};
+        std::uint64_t state = std::uint64_t(std::llround(duration * 1000.0)) * 0x9E3779B97F4A7C15ull + 1;
+        std::vector<Segment> segs;
+        for (double t0 = 0.0; t0 < duration; t0 += segment_sec_)
+        {
+            Segment seg{t0, std::min(duration, t0 + segment_sec_), ""};
+            for (int w = 0; w < 8; ++w)
+            {
+                state = state * 6364136223846793005ull + 1442695040888963407ull;
+                seg.text += (w ? " " : "") + std::string(kWords[(state >> 59) & 15]);
+            }
+            segs.push_back(std::move(seg));
+        }
+        return segs;
+    }
+
+    double rtf_;         // seconds of wall time per second of audio
+    double load_sec_;    // per run, like whisper-cli loading the model
+    double segment_sec_; // length of each synthetic segment
+};
+
+/* "whisper-cli" (or empty) and "mock[:RTF[:LOAD_SEC]]"; null with `error` set on anything else. */
+inline std::shared_ptr<const InferenceBackend> make_inference_backend(const std::string &spec, std::string &error)
+{
+    if (spec.empty() || spec == "whisper-cli")
+        return std::make_shared<WhisperCliBackend>();
+    if (spec == "mock" || spec.rfind("mock:", 0) == 0)
+    {
+        const double rtf = spec.size() > 5 ? std::atof(spec.c_str() + 5) : 0.05;
+        const auto colon = spec.find(':', 5);
+        const double load = colon == std::string::npos ? 0.0 : std::atof(spec.c_str() + colon + 1);
+        if (rtf < 0.0 || load < 0.0)
+        {
+            error = "mock realtime factor and load time must be >= 0";
+            return nullptr;
+        }
+        return std::make_shared<MockBackend>(rtf, load);
+    }
+    error = "unknown backend '" + spec + "' (whisper-cli, mock[:RTF[:LOAD_SEC]])";
+    return nullptr;
+}
+
+inline bool run_inference(const std::string &wav, const WhisperOptions &o, std::vector<std::string> &lines,
+                          std::string &error)
+{
+    const double sec = wav_duration_sec(wav);
+    const WhisperOptions *use = &o;
+    WhisperOptions adapted;
+    if (o.adaptive_ctx && sec > 0.0)
+    {
+        adapted = o;
+        adapted.audio_ctx = adaptive_audio_ctx(sec);
+        use = &adapted;
+    }
+    count_encoder_run(std::max(0.0, sec), use->audio_ctx);
+    return o.backend ? o.backend->transcribe(wav, *use, lines, error) : run_whisper(wav, *use, lines, error);
+}
+
+/* User + system CPU time of this process and every child waited for. */
+inline double cpu_seconds()
+{
+    double sec = 0.0;
+    for (int who : {RUSAGE_SELF, RUSAGE_CHILDREN})
+    {
+        rusage ru{};
+        getrusage(who, &ru);
+        sec += double(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) + double(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    }
+    return sec;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Run report – one JSON object per run (--report PATH) for tooling:
+  caller-supplied fields, host and CPU time, stage latency, memory
+  and (with --perf-counters) hardware counters
+──────────────────────────────────────────────────────────────*/
+class RunReport
+{
+public:
+    void add(const std::string &key, const std::string &value) { raw(key, json_string(value)); }
+    void add(const std::string &key, double value)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%.6g", value);
+        raw(key, buf);
+    }
+    void raw(const std::string &key, const std::string &json) { fields_.emplace_back(key, json); }
+
+    std::string json() const
+    {
+        std::string out = "{";
+        for (const auto &f : fields_)
+            out += json_string(f.first) + ":" + f.second + ",";
+        char host[256] = {};
+        gethostname(host, sizeof(host) - 1);
+        char cpu[64];
+        std::snprintf(cpu, sizeof(cpu), "%.3f", cpu_seconds());
+        out += "\"host\":" + json_string(host) + ",\"cpu_sec\":" + cpu + ",\"simd\":" + simd_json() + ",";
+        out += "\"pcm_pool\":" + pcm_pool_json() + ",";
+        if (pipeline_counters().encoder_runs.load())
+            out += "\"encoder\":" + encoder_json() + ",";
+        if (pack_stats().chunks.load())
+            out += "\"speech_pack\":" + pack_stats_json() + ",";
+        out += "\"latency\":" + latency_json() + ",\"memory\":" + memory_json();
+        if (perf_counters_requested())
+            out += ",\"counters\":" + perf_json();
+        return out + "}";
+    }
+
+    bool write(const std::string &path) const
+    {
+        std::ofstream out(path);
+        out << json() << '\n';
+        return bool(out);
+    }
+
+private:
+    std::vector<std::pair<std::string, std::string>> fields_;
+};
+
+inline std::string watchdog_json()
+{
+    const WatchdogStats &s = watchdog_stats();
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "{\"fired\":%zu,\"retried\":%zu,\"recovered\":%zu,\"skipped\":%zu,\"skipped_sec\":%.3f}",
+                  s.fired.load(), s.retried.load(), s.recovered.load(), s.skipped.load(), double(s.skipped_ms) / 1000.0);
+    return buf;
+}
+
+inline void print_watchdog_stats()
+{
+    const WatchdogStats &s = watchdog_stats();
+    std::cerr << "watchdog: fired " << s.fired << ", retried " << s.retried << ", recovered "
+              << s.recovered << ", skipped " << s.skipped << " span(s) / "
+              << std::fixed << std::setprecision(1) << double(s.skipped_ms) / 1000.0 << " s"
+              << std::defaultfloat << std::endl;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Chunks – byte ranges of the source, materialised on demand
+──────────────────────────────────────────────────────────────*/
+struct AudioChunk
+{
+    std::size_t index = 0;
+    std::string source;               // file the range refers to
+    AudioFormat format = AudioFormat::Unknown;
+    ChunkRange range;
+    bool last = false;                // runs to the end of the source
+    bool owns_source = false;         // source is a temporary split file
+    double origin_sec = 0.0;          // global time of the source's t = 0
+
+    double global_start() const { return origin_sec + range.start_sec; }
+    double duration() const { return std::max(0.0, range.end_sec - range.start_sec); }
+};
+
+inline std::vector<double> chunk_durations(const std::vector<AudioChunk> &chunks)
+{
+    std::vector<double> sec;
+    for (const auto &c : chunks)
+        sec.push_back(c.duration());
+    return sec;
+}
+
+/* Fallback when the source cannot be indexed: let ffmpeg cut real files into
+   a fresh directory next to the source, so concurrent jobs – and segments
+   left over from an earlier run – never mix. ffmpeg's segment list gives
+   each file and its real start and end, so the short last segment keeps its
+   own duration. */
+inline std::vector<AudioChunk> split_audio_files(const std::string &audio_file, int chunk_len_sec,
+                                                 double from_sec, double to_sec, double origin_sec)
+{
+    const std::string ext = fs::path(audio_file).extension().string();
+    std::string tmpl = (fs::absolute(audio_file).parent_path() / "chunks-XXXXXX").string();
+    if (!mkdtemp(&tmpl[0]))
+        throw JobError("Could not create a directory for chunks next to " + audio_file + ": " + std::strerror(errno));
+    const fs::path dir = tmpl;
+    const fs::path list = dir / "segments.csv";
+    std::string seek;
+    if (from_sec > 0.0)
+        seek += "-ss " + std::to_string(from_sec) + " ";
+    if (to_sec > from_sec)
+        seek += "-t " + std::to_string(to_sec - from_sec) + " ";
+    const std::string cmd =
+        "ffmpeg -hide_banner -loglevel error " + seek + "-i \"" + audio_file +
+        "\" -f segment -segment_time " + std::to_string(chunk_len_sec) +
+        " -segment_list \"" + list.string() + "\" -segment_list_type csv" +
+        " -c copy \"" + (dir / "chunk_%03d").string() + ext + "\"";
+    run_cmd(cmd, /*echo=*/true);
+
+    /* One "<file>,<start>,<end>" line per segment, in order */
+    std::vector<AudioChunk> chunks;
+    std::ifstream in(list);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const auto end_at = line.rfind(','), start_at = end_at == std::string::npos ? end_at : line.rfind(',', end_at - 1);
+        if (start_at == std::string::npos || start_at == 0)
+            continue;
+        const double start = std::atof(line.c_str() + start_at + 1), end = std::atof(line.c_str() + end_at + 1);
+        AudioChunk c;
+        c.index = chunks.size();
+        c.source = (dir / line.substr(0, start_at)).string();
+        c.range.end_sec = std::max(0.0, end - start);
+        c.last = true;
+        c.owns_source = true;
+        c.origin_sec = origin_sec + std::max(0.0, from_sec) + start;
+        chunks.push_back(c);
+    }
+    fs::remove(list);
+    if (chunks.empty())
+    {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+        throw JobError("No chunks produced – check ffmpeg output.");
+    }
+    return chunks;
+}
+
+/* Delete a chunk's split file (and its directory once the last one is gone). */
+inline void release_chunk_source(const AudioChunk &c)
+{
+    if (!c.owns_source)
+        return;
+    std::error_code ec;
+    fs::remove(c.source, ec);
+    fs::remove(fs::path(c.source).parent_path(), ec); // fails while other chunks remain
+}
+
+/*───────────────────────────────────────────────────────────────
+  2. Split audio into ≤10-min chunks (frame index, no copies)
+     Only [from_sec, to_sec) of the source is planned (to_sec < 0 = end);
+     `origin_sec` is the global time of the source's first sample.
+──────────────────────────────────────────────────────────────*/
+inline std::vector<AudioChunk> split_audio(const std::string &audio_file, int chunk_len_sec = 600,
+                                           double from_sec = 0.0, double to_sec = -1.0,
+                                           double origin_sec = 0.0)
+{
+    StageTimer timer(Stage::Segmentation);
+    PerfScope counters(Stage::Segmentation);
+    MemScope mem(Stage::Segmentation);
+    FrameIndex index;
+    if (!build_frame_index(audio_file, index))
+        return split_audio_files(audio_file, chunk_len_sec, from_sec, to_sec, origin_sec);
+
+    std::vector<AudioChunk> chunks;
+    for (const ChunkRange &r : plan_chunks(index, chunk_len_sec, from_sec, to_sec))
+    {
+        AudioChunk c;
+        c.index = chunks.size();
+        c.source = audio_file;
+        c.format = index.format;
+        c.range = r;
+        c.last = r.last == index.entries.size() && r.end_sec >= index.duration_sec;
+        c.origin_sec = origin_sec;
+        chunks.push_back(c);
+    }
+    if (chunks.empty())
+        throw JobError("Requested range is outside the audio (" + std::to_string(index.duration_sec) + " s).");
+    return chunks;
+}
+
+/* Sample frames of a PCM WAV in bytes [begin, end), downmixed and resampled to 16 kHz mono. */
+inline bool wav_decode_range(const std::string &path, std::uint64_t begin, std::uint64_t end, PcmBuffer &pcm)
+{
+    drwav wav;
+    if (!drwav_init_file(&wav, path.c_str(), nullptr))
+        return false;
+    const std::uint64_t align = std::max<std::uint64_t>(1, wav.fmt.blockAlign);
+    const std::uint64_t data = wav.dataChunkDataPos;
+    const std::uint64_t first = (std::max(begin, data) - data) / align;
+    std::uint64_t left = (std::max(end, begin) - begin) / align;
+    bool ok = drwav_seek_to_pcm_frame(&wav, first);
+    if (ok)
+    {
+        StreamResampler resampler;
+        resampler.reset(int(wav.sampleRate), wav.channels, 16000);
+        std::vector<float> buf(std::size_t(4096) * wav.channels), out;
+        while (left > 0)
+        {
+            const drwav_uint64 got = drwav_read_pcm_frames_f32(&wav, std::min<std::uint64_t>(left, 4096), buf.data());
+            if (!got)
+                break;
+            resampler.push(buf.data(), std::size_t(got), out);
+            pcm.append(out.data(), out.size());
+            out.clear();
+            left -= got;
+        }
+        resampler.flush(out);
+        pcm.append(out.data(), out.size());
+    }
+    drwav_uninit(&wav);
+    return ok;
+}
+
+/* Decode a chunk's byte range in-process to 16 kHz mono. Decoder output
+   passes through a float staging area of about one block on its way into
+   the pooled buffer. */
+inline bool decode_chunk(const AudioChunk &c, PcmBuffer &pcm)
+{
+    pcm.clear();
+    std::vector<float> stage;
+    stage.reserve(2 * PcmPool::kBlockSamples);
+    const auto spill = [&](bool force) {
+        if (force || stage.size() >= PcmPool::kBlockSamples)
+        {
+            pcm.append(stage.data(), stage.size());
+            stage.clear();
+        }
+    };
+    bool ok = false;
+    if (c.format == AudioFormat::Mp3)
+    {
+        Mp3Decoder dec;
+        if (dec.open(c.source, c.range.preroll_begin, c.range.end))
+        {
+            while (dec.decode_frame(stage))
+                spill(false);
+            spill(true);
+            ok = dec.source_rate() != 0 && !dec.failed();
+        }
+    }
+    else if (c.format == AudioFormat::Webm)
+    {
+        WebmOpusDecoder dec;
+        if (dec.open(c.source, c.range.preroll_begin, c.last ? ~std::uint64_t(0) : c.range.end))
+        {
+            while (dec.decode_packet(stage))
+                spill(false);
+            spill(true);
+            ok = !pcm.empty() && !dec.had_errors(); // concealed packets: let ffmpeg try the range
+        }
+    }
+    else if (c.format == AudioFormat::Wav)
+        ok = wav_decode_range(c.source, c.range.preroll_begin, c.range.end, pcm);
+    if (!ok)
+        return false;
+
+    /* Drop the pre-roll, and trim the filter/decoder tail at the cut. */
+    pcm.drop_front(std::size_t(std::lround((c.range.start_sec - c.range.preroll_sec) * 16000)));
+    if (!c.last)
+        pcm.truncate(std::size_t(std::lround((c.range.end_sec - c.range.start_sec) * 16000)));
+    return true;
+}
+
+/* ffmpeg's half of materialize_chunk: path 0 reads just the byte range,
+   path 1 seeks by time in the whole source. */
+inline bool ffmpeg_chunk(const AudioChunk &c, const std::string &wav, int path, double timeout_sec)
+{
+    std::string input = "-i \"" + c.source + "\"";
+    if (path == 0 && (c.format == AudioFormat::Mp3 || c.format == AudioFormat::Adts))
+        input = "-i \"subfile,,start," + std::to_string(c.range.begin) + ",end," +
+                std::to_string(c.range.end) + ",,:" + c.source + "\"";
+    else if (c.format != AudioFormat::Unknown)
+        input = "-ss " + std::to_string(c.range.start_sec) +
+                (c.last ? "" : " -t " + std::to_string(c.range.end_sec - c.range.start_sec)) + " " + input;
+
+    return run_cmd_timeout("ffmpeg -hide_banner -loglevel error -y " + input +
+                               " -ar 16000 -ac 1 \"" + wav + "\"",
+                           timeout_sec) == 0;
+}
+
+/* Produce the 16 kHz mono WAV whisper-cli reads for one chunk.
+   Path 0 decodes in-process, falling back to ffmpeg on the byte range;
+   path 1 is the fallback – ffmpeg seeks by time in the whole source. */
+inline bool materialize_chunk(const AudioChunk &c, const std::string &wav, int path = 0,
+                              double timeout_sec = 300.0)
+{
+    PcmBuffer pcm;
+    if (path == 0 && decode_chunk(c, pcm) && write_wav_16k(wav, pcm))
+        return true;
+    return ffmpeg_chunk(c, wav, path, timeout_sec);
+}
+
+/* A WAV written by materialize_chunk (16 kHz) into pooled blocks, downmixed. */
+inline bool read_wav_16k(const std::string &path, PcmBuffer &pcm)
+{
+    pcm.clear();
+    drwav wav;
+    if (!drwav_init_file(&wav, path.c_str(), nullptr))
+        return false;
+    const unsigned channels = std::max<unsigned>(1, wav.channels);
+    std::vector<float> buf(std::size_t(4096) * channels), mono(4096);
+    for (drwav_uint64 got; (got = drwav_read_pcm_frames_f32(&wav, 4096, buf.data())) > 0;)
+    {
+        simd().downmix(buf.data(), std::size_t(got), int(channels), 1.0f / float(channels), mono.data());
+        pcm.append(mono.data(), std::size_t(got));
+    }
+    drwav_uninit(&wav);
+    return true;
+}
+
+/* Chunk PCM in memory, going through a temporary WAV when it has to. */
+inline bool load_chunk_pcm(const AudioChunk &c, PcmBuffer &pcm, const std::string &tmp_wav)
+{
+    if (decode_chunk(c, pcm))
+        return true;
+
+    if (!ffmpeg_chunk(c, tmp_wav, 0, 300.0))
+        return false;
+    const bool ok = read_wav_16k(tmp_wav, pcm);
+    fs::remove(tmp_wav);
+    return ok;
+}
+
+/* vad_frame_energy_db over a pooled buffer, one block-sized run of whole VAD
+   frames at a time, so the chunk is never held as float */
+inline void pcm_frame_energy_db(const PcmBuffer &pcm, std::vector<float> &db)
+{
+    const VadParams p;
+    std::vector<float> part;
+    db.clear();
+    pcm.for_each_window(PcmPool::kBlockSamples / p.frame * p.frame, [&](const float *x, std::size_t n) {
+        vad_frame_energy_db(x, n, part, p);
+        db.insert(db.end(), part.begin(), part.end());
+    });
+}
+
+/* materialize_chunk for --pack-speech: the WAV holds only the chunk's speech,
+   packed end to end; `layout` maps it back. An empty layout means silence,
+   and no WAV is left behind. */
+inline bool materialize_packed_chunk(const AudioChunk &c, const std::string &wav, int path, double timeout_sec,
+                                     SpeechLayout &layout)
+{
+    /* One decode: in-process when it works, otherwise ffmpeg's WAV read back */
+    PcmBuffer pcm;
+    if (!(path == 0 && decode_chunk(c, pcm)) &&
+        !(ffmpeg_chunk(c, wav, path, timeout_sec) && read_wav_16k(wav, pcm)))
+        return false;
+
+    std::vector<float> db;
+    pcm_frame_energy_db(pcm, db);
+    layout = pack_speech(vad_speech_spans(db, vad_threshold_db(db)));
+    pack_stats().add(double(pcm.size()) / 16000.0, layout);
+    if (layout.spans.empty())
+    {
+        fs::remove(wav);
+        return true;
+    }
+    return write_wav_16k(wav, pcm, &layout);
+}
+
+/*───────────────────────────────────────────────────────────────
+  Robust chunk – decode and transcribe one chunk with bounded
+  retries and fallbacks, so one bad chunk never costs the others.
+  Decoding falls back to ffmpeg's own seek; whisper falls back to
+  `fallback_model`. If every attempt fails, `lines` holds a single
+  gap segment spanning the chunk and false is returned.
+──────────────────────────────────────────────────────────────*/
+struct RetryPolicy
+{
+    int retries = 1;                  // extra attempts per stage before falling back
+    std::string fallback_model;       // whisper model tried last, if set
+    double decode_timeout_sec = 300.0;
+};
+
+inline Segment gap_segment(const AudioChunk &c, const std::string &why)
+{
+    return {0.0, c.duration(), "[gap: " + why + "]"};
+}
+
+/* `status(stage, at_sec)` is told when decoding starts and how far transcription has got. */
+inline bool transcribe_chunk_robust(const AudioChunk &c, const std::string &wav, const WhisperOptions &opts,
+                                    const RetryPolicy &policy, std::vector<std::string> &lines,
+                                    const std::function<void(const char *, double)> &status = {})
+{
+    lines.clear();
+    const std::string what = "chunk " + std::to_string(c.index);
+    if (status)
+        status("decode", 0.0);
+
+    bool decoded = false;
+    SpeechLayout layout;
+    {
+        StageTimer timer(Stage::Decode);
+        PerfScope counters(Stage::Decode);
+        MemScope mem(Stage::Decode);
+        for (int attempt = 0; !decoded && attempt <= policy.retries; ++attempt)
+        {
+            if (attempt > 0)
+                std::cerr << "\n" << what << ": decode failed, retrying with ffmpeg seek" << std::endl;
+            const int path = attempt == 0 ? 0 : 1;
+            decoded = opts.pack_speech
+                          ? materialize_packed_chunk(c, wav, path, policy.decode_timeout_sec, layout)
+                          : materialize_chunk(c, wav, path, policy.decode_timeout_sec);
+        }
+    }
+    if (!decoded)
+    {
+        count_error(Stage::Decode);
+        fs::remove(wav);
+        lines.push_back(format_segment_line(gap_segment(c, "audio could not be decoded")));
+        return false;
+    }
+    if (opts.pack_speech && layout.spans.empty())
+    {
+        pipeline_counters().chunks.fetch_add(1, std::memory_order_relaxed); // no speech: nothing to transcribe
+        pipeline_counters().audio_ms.fetch_add(std::uint64_t(c.duration() * 1000.0), std::memory_order_relaxed);
+        return true;
+    }
+
+    std::vector<std::string> models(std::size_t(policy.retries) + 1, opts.model);
+    if (!policy.fallback_model.empty() && policy.fallback_model != opts.model)
+        models.push_back(policy.fallback_model);
+
+    std::string error;
+    bool ok = false;
+    for (std::size_t attempt = 0; !ok && attempt < models.size(); ++attempt)
+    {
+        if (attempt > 0)
+            std::cerr << "\n" << what << ": " << error << ", retrying with " << models[attempt] << std::endl;
+        WhisperOptions o = opts;
+        o.model = models[attempt];
+        if (status)
+        {
+            status("transcribe", 0.0);
+            o.on_segment = [&](double t1) { status("transcribe", opts.pack_speech ? layout.to_source(t1, true) : t1); };
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        {
+            PerfScope counters(Stage::Inference);
+            MemScope mem(Stage::Inference);
+            ok = run_inference(wav, o, lines, error);
+        }
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        if (ok && c.duration() > 0.0)
+            record_stage(Stage::Inference, std::uint64_t(us / c.duration()));
+    }
+    fs::remove(wav);
+    if (ok && opts.pack_speech)
+        for (std::string &line : lines)
+        {
+            Segment seg;
+            if (!parse_segment_line(line, seg))
+                continue;
+            seg.t0 = layout.to_source(seg.t0);
+            seg.t1 = std::max(seg.t0, layout.to_source(seg.t1, true));
+            line = format_segment_line(seg);
+        }
+    PipelineCounters &pc = pipeline_counters();
+    pc.chunks.fetch_add(1, std::memory_order_relaxed);
+    if (!ok)
+    {
+        count_error(Stage::Inference);
+        lines.clear();
+        lines.push_back(format_segment_line(gap_segment(c, error)));
+    }
+    else
+        pc.audio_ms.fetch_add(std::uint64_t(c.duration() * 1000.0), std::memory_order_relaxed);
+    return ok;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Checkpoint – finished chunk transcripts kept on disk, so running
+  the same job again only redoes chunks that failed or never ran
+──────────────────────────────────────────────────────────────*/
+class Checkpoint
+{
+public:
+    Checkpoint() = default; // disabled: loads nothing, saves nothing
+
+    /* One directory per job, named after a hash of `job_key`. */
+    explicit Checkpoint(const std::string &job_key)
+    {
+        std::uint64_t h = 1469598103934665603ull; // FNV-1a
+        for (unsigned char ch : job_key)
+            h = (h ^ ch) * 1099511628211ull;
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(h));
+        dir_ = (fs::path(".transcribe-work") / name).string();
+        std::error_code ec;
+        fs::create_directories(dir_, ec);
+        if (ec)
+            dir_.clear();
+    }
+
+    bool enabled() const { return !dir_.empty(); }
+    const std::string &dir() const { return dir_; }
+
+    /* A saved chunk only counts for the same model and the same inference
+       settings: backend, --pack-speech and the audio context all change the text. */
+    bool load(const AudioChunk &c, const WhisperOptions &o, std::vector<std::string> &lines) const
+    {
+        if (!enabled())
+            return false;
+        std::ifstream in(file(c));
+        std::string head;
+        const bool hit = std::getline(in, head) && head == header(c, o);
+        (hit ? pipeline_counters().chunk_cache_hits : pipeline_counters().chunk_cache_misses)
+            .fetch_add(1, std::memory_order_relaxed);
+        if (!hit)
+            return false;
+        lines.clear();
+        for (std::string line; std::getline(in, line);)
+            lines.push_back(line);
+        return true;
+    }
+
+    void save(const AudioChunk &c, const WhisperOptions &o, const std::vector<std::string> &lines) const
+    {
+        if (!enabled())
+            return;
+        const std::string tmp = file(c) + ".tmp";
+        {
+            std::ofstream out(tmp);
+            out << header(c, o) << '\n';
+            for (const auto &line : lines)
+                out << line << '\n';
+            if (!out)
+                return;
+        }
+        std::error_code ec;
+        fs::rename(tmp, file(c), ec);
+    }
+
+    void clear() const
+    {
+        std::error_code ec;
+        if (!enabled())
+            return;
+        fs::remove_all(dir_, ec);
+        fs::remove(fs::path(dir_).parent_path(), ec); // only once no other job is left
+    }
+
+private:
+    std::string file(const AudioChunk &c) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "chunk_%03zu.txt", c.index);
+        return (fs::path(dir_) / name).string();
+    }
+
+    static std::string header(const AudioChunk &c, const WhisperOptions &o)
+    {
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "# %.3f %.3f %.3f backend=%s pack=%d ac=%s ", c.origin_sec,
+                      c.range.start_sec, c.range.end_sec, o.backend ? o.backend->name().c_str() : "whisper-cli",
+                      int(o.pack_speech), o.adaptive_ctx ? "adaptive" : std::to_string(o.audio_ctx).c_str());
+        return buf + o.model;
+    }
+
+    std::string dir_;
+};
+
+/*───────────────────────────────────────────────────────────────
+  Helper – run `jobs` tasks on `workers` threads, first come first served
+──────────────────────────────────────────────────────────────*/
+template <typename Fn>
+void run_workers(std::size_t workers, std::size_t jobs, Fn fn)
+{
+    workers = std::max<std::size_t>(1, std::min(workers, jobs));
+    std::atomic<std::size_t> next{0};
+    auto loop = [&](std::size_t worker) {
+        this_worker() = worker;
+        for (std::size_t i; (i = next.fetch_add(1)) < jobs;)
+            fn(worker, i);
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t w = 1; w < workers; ++w)
+        pool.emplace_back(loop, w);
+    loop(0);
+    for (auto &t : pool)
+        t.join();
+}
+
+/* Like run_workers, but a job is only started while the mean job time so far
+   says it can finish by `deadline` (the first job always runs). Returns the
+   number of jobs started – always a prefix of [0, jobs). */
+template <typename Fn>
+std::size_t run_workers_until(std::size_t workers, std::size_t jobs,
+                              std::chrono::steady_clock::time_point deadline, Fn fn)
+{
+    using clock = std::chrono::steady_clock;
+    std::mutex m;
+    std::size_t next = 0, finished = 0;
+    clock::duration busy{};
+
+    run_workers(workers, jobs, [&](std::size_t worker, std::size_t) {
+        std::size_t i;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            const auto mean = finished ? busy / clock::rep(finished) : clock::duration{};
+            if (next == jobs || (next > 0 && clock::now() + mean > deadline))
+                return;
+            i = next++;
+        }
+        const auto t0 = clock::now();
+        fn(worker, i);
+        std::lock_guard<std::mutex> lock(m);
+        busy += clock::now() - t0;
+        ++finished;
+    });
+    return next;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Preview – short windows spread evenly over the source, ordered
+  so that every part of the timeline is visited before any part
+  is visited twice, and speech-dense windows go first in each pass
+──────────────────────────────────────────────────────────────*/
+struct PreviewPlan
+{
+    std::vector<AudioChunk> windows; // in transcription priority order
+    std::size_t candidates = 0;      // windows considered before ranking
+    double duration_sec = 0.0;       // of the source
+};
+
+/* Scratch WAVs for windows ffmpeg has to decode go to `work_dir`. */
+inline PreviewPlan plan_preview(const std::string &audio_file, double window_sec, const std::string &work_dir,
+                                std::size_t workers = 1, double origin_sec = 0.0)
+{
+    constexpr std::size_t kMaxCandidates = 45; // decode + VAD cost stays a few seconds
+    constexpr std::size_t kStratum = 3;        // neighbouring candidates competing per pass
+    constexpr float kMinDensity = 0.1f;        // below this a window is silence or noise
+
+    PreviewPlan plan;
+    FrameIndex index;
+    if (!build_frame_index(audio_file, index))
+        throw JobError("Preview needs an MP3, ADTS or WebM source: " + audio_file);
+    plan.duration_sec = index.duration_sec;
+
+    /* Candidate windows centred on an even grid over the whole duration */
+    const auto n = std::max<std::size_t>(
+        1, std::min(kMaxCandidates, std::size_t(index.duration_sec / window_sec)));
+    const double step = index.duration_sec / double(n);
+    std::vector<AudioChunk> cand;
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        const double from = std::max(0.0, (double(k) + 0.5) * step - window_sec / 2);
+        const auto ranges = plan_chunks(index, window_sec, from, from + window_sec);
+        if (ranges.empty())
+            continue;
+        AudioChunk c;
+        c.index = cand.size();
+        c.source = audio_file;
+        c.format = index.format;
+        c.range = ranges.front();
+        c.last = c.range.last == index.entries.size() && c.range.end_sec >= index.duration_sec;
+        c.origin_sec = origin_sec;
+        cand.push_back(c);
+    }
+    plan.candidates = cand.size();
+
+    /* Speech density of each candidate against one shared threshold */
+    std::vector<std::vector<float>> energy(cand.size());
+    run_workers(workers, cand.size(), [&](std::size_t, std::size_t i) {
+        PcmBuffer pcm;
+        char name[40];
+        std::snprintf(name, sizeof(name), "preview_%03zu.wav", i);
+        if (load_chunk_pcm(cand[i], pcm, (fs::path(work_dir) / name).string()))
+            pcm_frame_energy_db(pcm, energy[i]);
+    });
+    std::vector<float> all;
+    for (const auto &e : energy)
+        all.insert(all.end(), e.begin(), e.end());
+    const float threshold = vad_threshold_db(all);
+    std::vector<float> density(cand.size());
+    for (std::size_t i = 0; i < cand.size(); ++i)
+        density[i] = vad_speech_density(energy[i], threshold);
+
+    /* Pass r takes the r-th best window of every stratum, densest strata first.
+       With no window above kMinDensity (music, noise, VAD found no contrast)
+       every candidate stays in, so the plan is the even grid in pass order. */
+    const bool any_speech =
+        std::any_of(density.begin(), density.end(), [&](float d) { return d >= kMinDensity; });
+    std::vector<std::vector<std::size_t>> strata((cand.size() + kStratum - 1) / kStratum);
+    for (std::size_t i = 0; i < cand.size(); ++i)
+        if (!any_speech || density[i] >= kMinDensity)
+            strata[i / kStratum].push_back(i);
+    const auto denser = [&](std::size_t a, std::size_t b) { return density[a] > density[b]; };
+    for (auto &s : strata)
+        std::stable_sort(s.begin(), s.end(), denser);
+
+    for (std::size_t r = 0; r < kStratum; ++r)
+    {
+        std::vector<std::size_t> pass;
+        for (const auto &s : strata)
+            if (r < s.size())
+                pass.push_back(s[r]);
+        std::stable_sort(pass.begin(), pass.end(), denser);
+        for (std::size_t i : pass)
+            plan.windows.push_back(cand[i]);
+    }
+    return plan;
+}
@@ -0,0 +1,266 @@
+/*
+prometheus.h – pipeline metrics in Prometheus text exposition format
+
+Introduction
+============
+A long-running transcriber is scraped like any other service. The counters in
+metrics.h are rendered on demand – nothing here runs on the transcription
+path – and either served over HTTP or written as a node_exporter textfile:
+
+    ```cpp
+    #include "prometheus.h"
+
+    MetricsServer server;
+    std::string error;
+    server.start(9464, error);                  // GET http://127.0.0.1:9464/metrics
+    write_metrics_textfile("/var/lib/node_exporter/transcribe.prom");
+    ```
+
+Exposed: jobs in flight and queued, jobs / chunks / audio seconds done, chunk
+and download cache hits, whisper model load time, errors per stage, a
+realtime-factor histogram and per-stage latency quantiles.
+
+The server binds to loopback only and answers one request per connection.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "memory_stats.h"
+#include "metrics.h"
+
+namespace prometheus_detail
+{
+inline void line(std::string &out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+inline void line(std::string &out, const char *fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    std::vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    out += buf;
+    out += '\n';
+}
+
+inline void header(std::string &out, const char *name, const char *type, const char *help)
+{
+    line(out, "# HELP %s %s", name, help);
+    line(out, "# TYPE %s %s", name, type);
+}
+} // namespace prometheus_detail
+
+inline std::string prometheus_text()
+{
+    using prometheus_detail::header;
+    using prometheus_detail::line;
+    const PipelineCounters &pc = pipeline_counters();
+    const auto ld = [](const std::atomic<std::uint64_t> &v) {
+        return static_cast<unsigned long long>(v.load(std::memory_order_relaxed));
+    };
+    std::string out;
+
+    header(out, "transcribe_jobs_in_flight", "gauge", "Jobs being transcribed.");
+    line(out, "transcribe_jobs_in_flight %lld", static_cast<long long>(pc.jobs_in_flight.load()));
+    header(out, "transcribe_queue_depth", "gauge", "Jobs waiting for a runner.");
+    line(out, "transcribe_queue_depth %lld", static_cast<long long>(pc.queue_depth.load()));
+    header(out, "transcribe_jobs_total", "counter", "Jobs finished, by outcome.");
+    line(out, "transcribe_jobs_total{status=\"done\"} %llu", ld(pc.jobs_done));
+    line(out, "transcribe_jobs_total{status=\"failed\"} %llu", ld(pc.jobs_failed));
+    header(out, "transcribe_chunks_total", "counter", "Chunks sent to whisper.");
+    line(out, "transcribe_chunks_total %llu", ld(pc.chunks));
+    header(out, "transcribe_audio_seconds_total", "counter", "Seconds of audio transcribed.");
+    line(out, "transcribe_audio_seconds_total %.3f", double(ld(pc.audio_ms)) / 1000.0);
+
+    header(out, "transcribe_cache_requests_total", "counter", "Checkpoint and download cache lookups.");
+    line(out, "transcribe_cache_requests_total{cache=\"chunk\",result=\"hit\"} %llu", ld(pc.chunk_cache_hits));
+    line(out, "transcribe_cache_requests_total{cache=\"chunk\",result=\"miss\"} %llu", ld(pc.chunk_cache_misses));
+    line(out, "transcribe_cache_requests_total{cache=\"download\",result=\"hit\"} %llu", ld(pc.download_cache_hits));
+    line(out, "transcribe_cache_requests_total{cache=\"download\",result=\"miss\"} %llu",
+         ld(pc.download_cache_misses));
+
+    header(out, "transcribe_model_load_seconds", "summary", "whisper-cli model load time.");
+    line(out, "transcribe_model_load_seconds_sum %.6f", double(ld(pc.model_load_us)) / 1e6);
+    line(out, "transcribe_model_load_seconds_count %llu", ld(pc.model_loads));
+
+    header(out, "transcribe_stage_errors_total", "counter", "Failures, by pipeline stage.");
+    for (std::size_t i = 0; i < std::size_t(Stage::Count); ++i)
+        line(out, "transcribe_stage_errors_total{stage=\"%s\"} %llu", stage_name(Stage(i)), ld(pc.errors[i]));
+
+    /* Inference is recorded in µs per audio second, i.e. realtime factor × 1e6 */
+    {
+        static const double kBounds[] = {0.02, 0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0};
+        const auto snap = stage_histogram(Stage::Inference).snapshot();
+        header(out, "transcribe_realtime_factor", "histogram", "Inference wall time per second of audio.");
+        std::uint64_t cum = 0;
+        std::size_t b = 0;
+        for (double le : kBounds)
+        {
+            for (const std::size_t last = LatencyHistogram::bucket_of(std::uint64_t(le * 1e6)); b <= last; ++b)
+                cum += snap.counts[b];
+            line(out, "transcribe_realtime_factor_bucket{le=\"%g\"} %llu", le, static_cast<unsigned long long>(cum));
+        }
+        line(out, "transcribe_realtime_factor_bucket{le=\"+Inf\"} %llu", static_cast<unsigned long long>(snap.count));
+        line(out, "transcribe_realtime_factor_sum %.6f", snap.sum / 1e6);
+        line(out, "transcribe_realtime_factor_count %llu", static_cast<unsigned long long>(snap.count));
+    }
+
+    header(out, "transcribe_stage_duration_seconds", "summary", "Wall time per chunk, by stage.");
+    for (Stage s : {Stage::Segmentation, Stage::Decode, Stage::Postprocess})
+    {
+        const LatencyHistogram &h = stage_histogram(s);
+        const auto sum = h.summary();
+        const char *name = stage_name(s);
+        line(out, "transcribe_stage_duration_seconds{stage=\"%s\",quantile=\"0.5\"} %.6f", name, sum.p50 / 1e6);
+        line(out, "transcribe_stage_duration_seconds{stage=\"%s\",quantile=\"0.9\"} %.6f", name, sum.p90 / 1e6);
+        line(out, "transcribe_stage_duration_seconds{stage=\"%s\",quantile=\"0.99\"} %.6f", name, sum.p99 / 1e6);
+        line(out, "transcribe_stage_duration_seconds_sum{stage=\"%s\"} %.6f", name,
+             sum.mean * double(sum.count) / 1e6);
+        line(out, "transcribe_stage_duration_seconds_count{stage=\"%s\"} %llu", name,
+             static_cast<unsigned long long>(sum.count));
+    }
+
+    const RssSample rss = sample_rss();
+    header(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+    line(out, "process_resident_memory_bytes %llu", static_cast<unsigned long long>(rss.rss_kb * 1024));
+    return out;
+}
+
+/* Atomically replaces `path` (write to a temporary file, then rename). */
+inline bool write_metrics_textfile(const std::string &path)
+{
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp);
+        out << prometheus_text();
+        if (!out)
+            return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+/*───────────────────────────────────────────────────────────────
+  MetricsServer – GET /metrics on 127.0.0.1:<port>
+──────────────────────────────────────────────────────────────*/
+class MetricsServer
+{
+public:
+    MetricsServer() = default;
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+    ~MetricsServer() { stop(); }
+
+    bool start(int port, std::string &error)
+    {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0)
+        {
+            error = std::strerror(errno);
+            return false;
+        }
+        const int one = 1;
+        ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(std::uint16_t(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd_, 8) < 0)
+        {
+            error = "port " + std::to_string(port) + ": " + std::strerror(errno);
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        stop_ = false;
+        thread_ = std::thread([this] { serve(); });
+        return true;
+    }
+
+    void stop()
+    {
+        stop_ = true;
+        if (thread_.joinable())
+            thread_.join();
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    void serve()
+    {
+        while (!stop_)
+        {
+            pollfd p{fd_, POLLIN, 0};
+            if (::poll(&p, 1, 200) <= 0)
+                continue;
+            const int client = ::accept(fd_, nullptr, nullptr);
+            if (client < 0)
+                continue;
+#ifdef SO_NOSIGPIPE
+            const int one = 1; // a client hanging up must not kill the process
+            ::setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            respond(client);
+            ::close(client);
+        }
+    }
+
+    static void respond(int client)
+    {
+        /* Only the request line matters; give a slow client one second */
+        std::string req;
+        char buf[1024];
+        while (req.find("\r\n") == std::string::npos && req.size() < 8192)
+        {
+            pollfd p{client, POLLIN, 0};
+            if (::poll(&p, 1, 1000) <= 0)
+                return;
+            const ssize_t n = ::read(client, buf, sizeof(buf));
+            if (n <= 0)
+                return;
+            req.append(buf, std::size_t(n));
+        }
+        const bool ok = req.rfind("GET /metrics ", 0) == 0 || req.rfind("GET /metrics?", 0) == 0;
+        const std::string body = ok ? prometheus_text() : "not found: try /metrics\n";
+        const std::string head = std::string(ok ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 404 Not Found\r\n") +
+                                 "Content-Type: text/plain; version=0.0.4\r\n"
+                                 "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                 "Connection: close\r\n\r\n";
+        const std::string reply = head + body;
+        for (std::size_t sent = 0; sent < reply.size();)
+        {
+#ifdef MSG_NOSIGNAL
+            const ssize_t n = ::send(client, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+#else
+            const ssize_t n = ::send(client, reply.data() + sent, reply.size() - sent, 0);
+#endif
+            if (n <= 0)
+                return;
+            sent += std::size_t(n);
+        }
+    }
+
+    int fd_ = -1;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
@@ -0,0 +1,459 @@
+/*
+simd.h – DSP kernels written once over a SIMD width, picked at startup
+
+Introduction
+============
+One binary runs on AVX-512, AVX2 and Graviton hosts alike. Each kernel is
+written once (simd_kernels.h) against an instruction-set traits type (vector
+types, widths, load / fma / horizontal sum / 64-bit lane ops …) and compiled
+for scalar, SSE4.1, AVX2+FMA, AVX-512F and NEON; the fastest one the CPU
+supports is chosen on first use:
+
+    ```cpp
+    #include "simd.h"
+
+    const SimdKernels &k = simd();           // e.g. k.name == "avx2"
+    float e = k.sum_squares(frame, 480);     // VAD energy
+    float y = k.dot(history, taps, 32);      // resampler FIR
+    k.downmix(stereo, frames, 2, 0.5f, mono);
+    k.levenshtein(peq, blocks, cols, n, pv, mv, carry); // wer.h edit distance
+
+    std::string error;
+    simd_force("scalar", error);             // --simd scalar: reproduce / compare
+    ```
+
+Kernels: `dot` (resampler taps, polyphase synthesis), `sum_squares` (VAD frame
+energy), `downmix` (interleaved → mono with gain; stereo has a vector path,
+other layouts fall back to the scalar loop) and `levenshtein` (the bit-vector
+edit distance behind WER/CER, one 64-row block per 64-bit lane).
+
+The x86 paths are compiled inside per-path target regions (`#pragma GCC
+target` under GCC, `#pragma clang attribute` with `target` under clang), so
+the binary still builds with a plain `g++ -O2` or `clang++ -O2` and never
+executes an instruction the CPU lacks; the choice comes from CPUID via
+`__builtin_cpu_supports`, which also checks that the OS saves the wider
+registers. Other x86 compilers get the scalar path. On AArch64, NEON is part
+of the base ISA and is confirmed from the ELF hwcaps where the OS has them.
+
+Vector paths sum floats in a different order from the scalar loop, so those
+results agree to float rounding, not bit for bit; `levenshtein` is exact on
+every path. `bench selftest` compares each path with scalar.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#endif
+#endif
+
+struct SimdKernels
+{
+    const char *name;
+    float (*dot)(const float *a, const float *b, std::size_t n);
+    float (*sum_squares)(const float *x, std::size_t n);
+    void (*downmix)(const float *interleaved, std::size_t frames, int channels, float gain, float *out);
+    /* Myers/Hyyrö edit distance over `blocks` 64-row blocks for n ≥ 1 columns:
+       column j matches block b with peq[col[j] * blocks + b]. pv/mv hold each
+       block's vertical deltas in and out; carry[j] is the horizontal delta
+       (+1, 0, −1) into the first block at column j, and out of the last. */
+    void (*levenshtein)(const std::uint64_t *peq, std::size_t blocks, const std::uint32_t *col, std::size_t n,
+                        std::uint64_t *pv, std::uint64_t *mv, std::int8_t *carry);
+};
+
+namespace simd_detail
+{
+/*───────────────────────────────────────────────────────────────
+  Instruction-set traits
+──────────────────────────────────────────────────────────────*/
+struct Scalar
+{
+    using V = float;
+    static constexpr std::size_t W = 1;
+    static V zero() { return 0.0f; }
+    static V set1(float x) { return x; }
+    static V load(const float *p) { return *p; }
+    static void store(float *p, V v) { *p = v; }
+    static V add(V a, V b) { return a + b; }
+    static V mul(V a, V b) { return a * b; }
+    static V fma(V a, V b, V c) { return a * b + c; }
+    static float hsum(V v) { return v; }
+    static V pair_sum(const float *p) { return p[0] + p[1]; } // 2·W interleaved → W sums
+
+    using U = std::uint64_t; // L lanes of 64 bits
+    static constexpr std::size_t L = 1;
+    static U uzero() { return 0; }
+    static U uload(const std::uint64_t *p) { return *p; }
+    template <class F> static U ugen(F f) { return f(0); } // lane k = f(k), in registers: no store → load
+    static void ustore(std::uint64_t *p, U v) { *p = v; }
+    static U uand(U a, U b) { return a & b; }
+    static U uor(U a, U b) { return a | b; }
+    static U uxor(U a, U b) { return a ^ b; }
+    static U uandnot(U a, U b) { return ~a & b; }
+    static U unot(U a) { return ~a; }
+    static U uadd(U a, U b) { return a + b; }
+    static U ushl1(U a) { return a << 1; }
+    static U ushr63(U a) { return a >> 63; }
+    static U shift_in(U, std::uint64_t x) { return x; } // lanes up by one, x into lane 0
+    static std::uint64_t ulast(U v) { return v; }       // lane L − 1
+};
+
+#ifdef SIMD_X86
+#define SIMD_OP(isa) __attribute__((target(isa), always_inline)) static inline
+
+struct Sse4
+{
+    using V = __m128;
+    static constexpr std::size_t W = 4;
+    SIMD_OP("sse4.1") V zero() { return _mm_setzero_ps(); }
+    SIMD_OP("sse4.1") V set1(float x) { return _mm_set1_ps(x); }
+    SIMD_OP("sse4.1") V load(const float *p) { return _mm_loadu_ps(p); }
+    SIMD_OP("sse4.1") void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    SIMD_OP("sse4.1") V add(V a, V b) { return _mm_add_ps(a, b); }
+    SIMD_OP("sse4.1") V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    SIMD_OP("sse4.1") V fma(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    SIMD_OP("sse4.1") float hsum(V v)
+    {
+        v = _mm_hadd_ps(v, v);
+        return _mm_cvtss_f32(_mm_hadd_ps(v, v));
+    }
+    SIMD_OP("sse4.1") V pair_sum(const float *p) { return _mm_hadd_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4)); }
+
+    using U = __m128i;
+    static constexpr std::size_t L = 2;
+    SIMD_OP("sse4.1") U uzero() { return _mm_setzero_si128(); }
+    SIMD_OP("sse4.1") U uload(const std::uint64_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+    template <class F> SIMD_OP("sse4.1") U ugen(F f)
+    {
+        return _mm_set_epi64x(static_cast<long long>(f(1)), static_cast<long long>(f(0)));
+    }
+    SIMD_OP("sse4.1") void ustore(std::uint64_t *p, U v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+    SIMD_OP("sse4.1") U uand(U a, U b) { return _mm_and_si128(a, b); }
+    SIMD_OP("sse4.1") U uor(U a, U b) { return _mm_or_si128(a, b); }
+    SIMD_OP("sse4.1") U uxor(U a, U b) { return _mm_xor_si128(a, b); }
+    SIMD_OP("sse4.1") U uandnot(U a, U b) { return _mm_andnot_si128(a, b); }
+    SIMD_OP("sse4.1") U unot(U a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+    SIMD_OP("sse4.1") U uadd(U a, U b) { return _mm_add_epi64(a, b); }
+    SIMD_OP("sse4.1") U ushl1(U a) { return _mm_slli_epi64(a, 1); }
+    SIMD_OP("sse4.1") U ushr63(U a) { return _mm_srli_epi64(a, 63); }
+    SIMD_OP("sse4.1") U shift_in(U v, std::uint64_t x)
+    {
+        return _mm_or_si128(_mm_slli_si128(v, 8), _mm_set_epi64x(0, static_cast<long long>(x)));
+    }
+    SIMD_OP("sse4.1") std::uint64_t ulast(U v) { return std::uint64_t(_mm_cvtsi128_si32(_mm_srli_si128(v, 8))); }
+};
+
+struct Avx2
+{
+    using V = __m256;
+    static constexpr std::size_t W = 8;
+    SIMD_OP("avx2,fma") V zero() { return _mm256_setzero_ps(); }
+    SIMD_OP("avx2,fma") V set1(float x) { return _mm256_set1_ps(x); }
+    SIMD_OP("avx2,fma") V load(const float *p) { return _mm256_loadu_ps(p); }
+    SIMD_OP("avx2,fma") void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    SIMD_OP("avx2,fma") V add(V a, V b) { return _mm256_add_ps(a, b); }
+    SIMD_OP("avx2,fma") V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    SIMD_OP("avx2,fma") V fma(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+    SIMD_OP("avx2,fma") float hsum(V v)
+    {
+        __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        x = _mm_hadd_ps(x, x);
+        return _mm_cvtss_f32(_mm_hadd_ps(x, x));
+    }
+    SIMD_OP("avx2,fma") V pair_sum(const float *p)
+    {
+        /* hadd works per 128-bit lane: [a01 a23 b01 b23 | a45 a67 b45 b67] → restore order */
+        const __m256 h = _mm256_hadd_ps(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8));
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(h), 0xD8));
+    }
+
+    using U = __m256i;
+    static constexpr std::size_t L = 4;
+    SIMD_OP("avx2,fma") U uzero() { return _mm256_setzero_si256(); }
+    SIMD_OP("avx2,fma") U uload(const std::uint64_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    template <class F> SIMD_OP("avx2,fma") U ugen(F f)
+    {
+        return _mm256_set_epi64x(static_cast<long long>(f(3)), static_cast<long long>(f(2)),
+                                 static_cast<long long>(f(1)), static_cast<long long>(f(0)));
+    }
+    SIMD_OP("avx2,fma") void ustore(std::uint64_t *p, U v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    SIMD_OP("avx2,fma") U uand(U a, U b) { return _mm256_and_si256(a, b); }
+    SIMD_OP("avx2,fma") U uor(U a, U b) { return _mm256_or_si256(a, b); }
+    SIMD_OP("avx2,fma") U uxor(U a, U b) { return _mm256_xor_si256(a, b); }
+    SIMD_OP("avx2,fma") U uandnot(U a, U b) { return _mm256_andnot_si256(a, b); }
+    SIMD_OP("avx2,fma") U unot(U a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+    SIMD_OP("avx2,fma") U uadd(U a, U b) { return _mm256_add_epi64(a, b); }
+    SIMD_OP("avx2,fma") U ushl1(U a) { return _mm256_slli_epi64(a, 1); }
+    SIMD_OP("avx2,fma") U ushr63(U a) { return _mm256_srli_epi64(a, 63); }
+    SIMD_OP("avx2,fma") U shift_in(U v, std::uint64_t x)
+    {
+        const __m256i up = _mm256_permute4x64_epi64(v, 0x90); // [v0 v0 v1 v2]
+        return _mm256_blend_epi32(up, _mm256_set1_epi64x(static_cast<long long>(x)), 0x03);
+    }
+    SIMD_OP("avx2,fma") std::uint64_t ulast(U v)
+    {
+        return std::uint64_t(_mm_cvtsi128_si32(_mm_srli_si128(_mm256_extracti128_si256(v, 1), 8)));
+    }
+};
+
+struct Avx512
+{
+    using V = __m512;
+    static constexpr std::size_t W = 16;
+    SIMD_OP("avx512f") V zero() { return _mm512_setzero_ps(); }
+    SIMD_OP("avx512f") V set1(float x) { return _mm512_set1_ps(x); }
+    SIMD_OP("avx512f") V load(const float *p) { return _mm512_loadu_ps(p); }
+    SIMD_OP("avx512f") void store(float *p, V v) { _mm512_storeu_ps(p, v); }
+    SIMD_OP("avx512f") V add(V a, V b) { return _mm512_add_ps(a, b); }
+    SIMD_OP("avx512f") V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    SIMD_OP("avx512f") V fma(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+    SIMD_OP("avx512f") float hsum(V v)
+    {
+        /* Through memory: GCC 12's 512-bit extract/shuffle intrinsics warn under -Wall */
+        alignas(64) float t[16];
+        _mm512_store_ps(t, v);
+        __m128 x = _mm_add_ps(_mm_add_ps(_mm_load_ps(t), _mm_load_ps(t + 4)),
+                              _mm_add_ps(_mm_load_ps(t + 8), _mm_load_ps(t + 12)));
+        x = _mm_hadd_ps(x, x);
+        return _mm_cvtss_f32(_mm_hadd_ps(x, x));
+    }
+    SIMD_OP("avx512f") V pair_sum(const float *p)
+    {
+        const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+        const __m512i odd = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1);
+        const __m512 a = _mm512_loadu_ps(p), b = _mm512_loadu_ps(p + 16);
+        return _mm512_add_ps(_mm512_permutex2var_ps(a, even, b), _mm512_permutex2var_ps(a, odd, b));
+    }
+
+    /* Zero-masked and-not, shift and permute: the plain ones start from an
+       undefined register that GCC 12 warns about under -Wall */
+    using U = __m512i;
+    static constexpr std::size_t L = 8;
+    SIMD_OP("avx512f") U uzero() { return _mm512_setzero_si512(); }
+    SIMD_OP("avx512f") U uload(const std::uint64_t *p) { return _mm512_loadu_si512(p); }
+    template <class F> SIMD_OP("avx512f") U ugen(F f)
+    {
+        return _mm512_set_epi64(static_cast<long long>(f(7)), static_cast<long long>(f(6)),
+                                static_cast<long long>(f(5)), static_cast<long long>(f(4)),
+                                static_cast<long long>(f(3)), static_cast<long long>(f(2)),
+                                static_cast<long long>(f(1)), static_cast<long long>(f(0)));
+    }
+    SIMD_OP("avx512f") void ustore(std::uint64_t *p, U v) { _mm512_storeu_si512(p, v); }
+    SIMD_OP("avx512f") U uand(U a, U b) { return _mm512_and_si512(a, b); }
+    SIMD_OP("avx512f") U uor(U a, U b) { return _mm512_or_si512(a, b); }
+    SIMD_OP("avx512f") U uxor(U a, U b) { return _mm512_xor_si512(a, b); }
+    SIMD_OP("avx512f") U uandnot(U a, U b) { return _mm512_maskz_andnot_epi64(0xFF, a, b); }
+    SIMD_OP("avx512f") U unot(U a) { return _mm512_xor_si512(a, _mm512_set1_epi32(-1)); }
+    SIMD_OP("avx512f") U uadd(U a, U b) { return _mm512_add_epi64(a, b); }
+    SIMD_OP("avx512f") U ushl1(U a) { return _mm512_add_epi64(a, a); }
+    SIMD_OP("avx512f") U ushr63(U a) { return _mm512_maskz_srli_epi64(0xFF, a, 63); }
+    SIMD_OP("avx512f") U shift_in(U v, std::uint64_t x)
+    {
+        const __m512i up = _mm512_maskz_permutexvar_epi64(0xFF, _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0), v);
+        return _mm512_mask_set1_epi64(up, 1, static_cast<long long>(x));
+    }
+    SIMD_OP("avx512f") std::uint64_t ulast(U v)
+    {
+        alignas(64) std::uint64_t t[8];
+        _mm512_store_si512(t, v);
+        return t[7];
+    }
+};
+#undef SIMD_OP
+#endif
+
+#ifdef SIMD_NEON
+struct Neon
+{
+    using V = float32x4_t;
+    static constexpr std::size_t W = 4;
+    static V zero() { return vdupq_n_f32(0.0f); }
+    static V set1(float x) { return vdupq_n_f32(x); }
+    static V load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, V v) { vst1q_f32(p, v); }
+    static V add(V a, V b) { return vaddq_f32(a, b); }
+    static V mul(V a, V b) { return vmulq_f32(a, b); }
+    static V fma(V a, V b, V c) { return vfmaq_f32(c, a, b); }
+    static float hsum(V v) { return vaddvq_f32(v); }
+    static V pair_sum(const float *p) { return vpaddq_f32(vld1q_f32(p), vld1q_f32(p + 4)); }
+
+    using U = uint64x2_t;
+    static constexpr std::size_t L = 2;
+    static U uzero() { return vdupq_n_u64(0); }
+    static U uload(const std::uint64_t *p) { return vld1q_u64(p); }
+    template <class F> static U ugen(F f) { return vcombine_u64(vcreate_u64(f(0)), vcreate_u64(f(1))); }
+    static void ustore(std::uint64_t *p, U v) { vst1q_u64(p, v); }
+    static U uand(U a, U b) { return vandq_u64(a, b); }
+    static U uor(U a, U b) { return vorrq_u64(a, b); }
+    static U uxor(U a, U b) { return veorq_u64(a, b); }
+    static U uandnot(U a, U b) { return vbicq_u64(b, a); }
+    static U unot(U a) { return veorq_u64(a, vdupq_n_u64(~std::uint64_t(0))); }
+    static U uadd(U a, U b) { return vaddq_u64(a, b); }
+    static U ushl1(U a) { return vshlq_n_u64(a, 1); }
+    static U ushr63(U a) { return vshrq_n_u64(a, 63); }
+    static U shift_in(U v, std::uint64_t x) { return vextq_u64(vdupq_n_u64(x), v, 1); } // [x v0]
+    static std::uint64_t ulast(U v) { return vgetq_lane_u64(v, 1); }
+};
+#endif
+
+} // namespace simd_detail
+
+/*───────────────────────────────────────────────────────────────
+  Kernels – one definition each (simd_kernels.h), compiled per path
+──────────────────────────────────────────────────────────────*/
+
+namespace simd_detail::scalar
+{
+using I = Scalar;
+#include "simd_kernels.h"
+} // namespace simd_detail::scalar
+
+#ifdef SIMD_X86
+/* A target region: every function defined inside may use `isa` */
+#define SIMD_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define SIMD_TARGET_BEGIN(isa) SIMD_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define SIMD_TARGET_END SIMD_PRAGMA(clang attribute pop)
+#else
+#define SIMD_TARGET_BEGIN(isa) SIMD_PRAGMA(GCC push_options) SIMD_PRAGMA(GCC target(isa))
+#define SIMD_TARGET_END SIMD_PRAGMA(GCC pop_options)
+#endif
+
+SIMD_TARGET_BEGIN("sse4.1")
+namespace simd_detail::sse4
+{
+using I = Sse4;
+#include "simd_kernels.h"
+} // namespace simd_detail::sse4
+SIMD_TARGET_END
+
+SIMD_TARGET_BEGIN("avx2,fma")
+namespace simd_detail::avx2
+{
+using I = Avx2;
+#include "simd_kernels.h"
+} // namespace simd_detail::avx2
+SIMD_TARGET_END
+
+SIMD_TARGET_BEGIN("avx512f")
+namespace simd_detail::avx512
+{
+using I = Avx512;
+#include "simd_kernels.h"
+} // namespace simd_detail::avx512
+SIMD_TARGET_END
+
+#undef SIMD_TARGET_BEGIN
+#undef SIMD_TARGET_END
+#undef SIMD_PRAGMA
+#endif
+
+#ifdef SIMD_NEON
+namespace simd_detail::neon
+{
+using I = Neon;
+#include "simd_kernels.h"
+} // namespace simd_detail::neon
+#endif
+
+namespace simd_detail
+{
+/* Every path this build and this CPU can run, fastest first. */
+inline const std::vector<SimdKernels> &supported()
+{
+    static const std::vector<SimdKernels> paths = [] {
+        std::vector<SimdKernels> v;
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            v.push_back(avx512::kernels("avx512"));
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            v.push_back(avx2::kernels("avx2"));
+        if (__builtin_cpu_supports("sse4.1"))
+            v.push_back(sse4::kernels("sse4"));
+#endif
+#ifdef SIMD_NEON
+#if defined(__linux__)
+        if (getauxval(AT_HWCAP) & HWCAP_ASIMD)
+#endif
+            v.push_back(neon::kernels("neon"));
+#endif
+        v.push_back(scalar::kernels("scalar"));
+        return v;
+    }();
+    return paths;
+}
+
+inline std::atomic<const SimdKernels *> &current()
+{
+    static std::atomic<const SimdKernels *> k{&supported().front()};
+    return k;
+}
+} // namespace simd_detail
+
+/* The kernels in use: the fastest supported path unless one was forced. */
+inline const SimdKernels &simd()
+{
+    return *simd_detail::current().load(std::memory_order_relaxed);
+}
+
+/* Names of the paths this host can run, fastest first ("avx2", …, "scalar"). */
+inline std::vector<std::string> simd_paths()
+{
+    std::vector<std::string> names;
+    for (const auto &k : simd_detail::supported())
+        names.push_back(k.name);
+    return names;
+}
+
+/* The kernels of path `name`, or nullptr if this build or CPU cannot run it –
+   for comparing paths side by side without switching the one in use. */
+inline const SimdKernels *simd_path(const std::string &name)
+{
+    for (const auto &k : simd_detail::supported())
+        if (name == k.name)
+            return &k;
+    return nullptr;
+}
+
+/* Use `name` from now on; false with `error` set if this build or CPU cannot run it.
+   Call before work starts – objects that cached the old table keep it. */
+inline bool simd_force(const std::string &name, std::string &error)
+{
+    for (const auto &k : simd_detail::supported())
+        if (name == k.name)
+        {
+            simd_detail::current().store(&k, std::memory_order_relaxed);
+            return true;
+        }
+    error = "SIMD path '" + name + "' is not available here (";
+    for (const auto &k : simd_detail::supported())
+        error += std::string(k.name) + (&k == &simd_detail::supported().back() ? ")" : ", ");
+    return false;
+}
+
+/* {"path":"avx2","available":["avx512","avx2","sse4","scalar"]} */
+inline std::string simd_json()
+{
+    std::string out = std::string("{\"path\":\"") + simd().name + "\",\"available\":[";
+    for (const auto &k : simd_detail::supported())
+        out += std::string(&k == &simd_detail::supported().front() ? "" : ",") + "\"" + k.name + "\"";
+    return out + "]}";
+}
@@ -0,0 +1,128 @@
+/*
+simd_kernels.h – the kernel bodies behind simd.h, compiled once per path
+
+Included by simd.h only: once per instruction set, inside that path's
+namespace after `using I = <traits>;` and, on x86, inside its target region –
+the only place the wider instructions are generated. No include guard on
+purpose.
+*/
+
+/* Two accumulators hide FMA latency */
+inline float dot(const float *a, const float *b, std::size_t n)
+{
+    I::V acc0 = I::zero(), acc1 = I::zero();
+    std::size_t i = 0;
+    for (; i + 2 * I::W <= n; i += 2 * I::W)
+    {
+        acc0 = I::fma(I::load(a + i), I::load(b + i), acc0);
+        acc1 = I::fma(I::load(a + i + I::W), I::load(b + i + I::W), acc1);
+    }
+    for (; i + I::W <= n; i += I::W)
+        acc0 = I::fma(I::load(a + i), I::load(b + i), acc0);
+    float sum = I::hsum(I::add(acc0, acc1));
+    for (; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+inline float sum_squares(const float *x, std::size_t n)
+{
+    I::V acc0 = I::zero(), acc1 = I::zero();
+    std::size_t i = 0;
+    for (; i + 2 * I::W <= n; i += 2 * I::W)
+    {
+        const I::V v0 = I::load(x + i), v1 = I::load(x + i + I::W);
+        acc0 = I::fma(v0, v0, acc0);
+        acc1 = I::fma(v1, v1, acc1);
+    }
+    for (; i + I::W <= n; i += I::W)
+    {
+        const I::V v = I::load(x + i);
+        acc0 = I::fma(v, v, acc0);
+    }
+    float sum = I::hsum(I::add(acc0, acc1));
+    for (; i < n; ++i)
+        sum += x[i] * x[i];
+    return sum;
+}
+
+inline void downmix(const float *in, std::size_t frames, int channels, float gain, float *out)
+{
+    std::size_t i = 0;
+    const I::V g = I::set1(gain);
+    if (channels == 1)
+        for (; i + I::W <= frames; i += I::W)
+            I::store(out + i, I::mul(I::load(in + i), g));
+    else if (channels == 2)
+        for (; i + I::W <= frames; i += I::W)
+            I::store(out + i, I::mul(I::pair_sum(in + 2 * i), g));
+    for (; i < frames; ++i)
+    {
+        float s = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            s += in[i * std::size_t(channels) + std::size_t(c)];
+        out[i] = s * gain;
+    }
+}
+
+/* Blocks [b0, b0 + I::L) of the bit-vector edit distance, one per 64-bit lane,
+   as a wavefront: at step t lane k is at column t − k, so the horizontal delta
+   lane k carries out of a column is what lane k + 1 needs for that column on
+   the next step. Lanes outside [0, n) during fill and drain keep their state. */
+inline void levenshtein_group(const std::uint64_t *peq, std::size_t blocks, std::size_t b0,
+                              const std::uint32_t *col, std::size_t n, std::uint64_t *pv, std::uint64_t *mv,
+                              std::int8_t *carry)
+{
+    constexpr std::size_t L = I::L;
+    I::U p = I::uload(pv + b0), m = I::uload(mv + b0);
+    I::U hp = I::shift_in(I::uzero(), carry[0] > 0), hn = I::shift_in(I::uzero(), carry[0] < 0);
+    for (std::size_t t = 0; t + 1 < n + L; ++t)
+    {
+        const bool edge = t + 1 < L || t >= n;
+        const auto active = [&](std::size_t k) { return k <= t && t - k < n; };
+        I::U e = edge ? I::ugen([&](std::size_t k) {
+            return active(k) ? peq[std::size_t(col[t - k]) * blocks + b0 + k] : std::uint64_t(0);
+        })
+                      : I::ugen([&](std::size_t k) { return peq[std::size_t(col[t - k]) * blocks + b0 + k]; });
+        const I::U xv = I::uor(e, m);
+        e = I::uor(e, hn);
+        const I::U xh = I::uor(I::uxor(I::uadd(I::uand(e, p), p), p), e);
+        I::U ph = I::uor(m, I::unot(I::uor(xh, p)));
+        I::U mh = I::uand(p, xh);
+        const I::U hp_out = I::ushr63(ph), hn_out = I::ushr63(mh);
+        ph = I::uor(I::ushl1(ph), hp);
+        mh = I::uor(I::ushl1(mh), hn);
+        I::U np = I::uor(mh, I::unot(I::uor(xv, ph))), nm = I::uand(ph, xv);
+        if (edge)
+        {
+            const I::U keep = I::ugen([&](std::size_t k) { return active(k) ? ~std::uint64_t(0) : 0; });
+            np = I::uor(I::uand(np, keep), I::uandnot(keep, p));
+            nm = I::uor(I::uand(nm, keep), I::uandnot(keep, m));
+        }
+        p = np;
+        m = nm;
+
+        if (t + 1 >= L) // the last lane finished column t + 1 − L
+            carry[t + 1 - L] = std::int8_t(int(I::ulast(hp_out)) - int(I::ulast(hn_out)));
+        const int next = t + 1 < n ? carry[t + 1] : 0;
+        hp = I::shift_in(hp_out, next > 0);
+        hn = I::shift_in(hn_out, next < 0);
+    }
+    I::ustore(pv + b0, p);
+    I::ustore(mv + b0, m);
+}
+
+inline void levenshtein(const std::uint64_t *peq, std::size_t blocks, const std::uint32_t *col, std::size_t n,
+                        std::uint64_t *pv, std::uint64_t *mv, std::int8_t *carry)
+{
+    std::size_t b = 0;
+    for (; b + I::L <= blocks; b += I::L)
+        levenshtein_group(peq, blocks, b, col, n, pv, mv, carry);
+    for (; b < blocks; ++b)
+        scalar::levenshtein_group(peq, blocks, b, col, n, pv, mv, carry);
+}
+
+inline SimdKernels kernels(const char *name)
+{
+    return {name, &dot, &sum_squares, &downmix, &levenshtein};
+}
@@ -0,0 +1,142 @@
+/*
+speech_pack.h – speech spans packed end to end for the encoder, and back
+
+Introduction
+============
+Whisper encodes 30 s of audio per pass whatever that audio holds. On choppy
+conversational material most of each window is silence or noise between
+short turns, so most of every pass is wasted. The packer lays the speech
+spans found by the VAD end to end, a short silence apart, and whisper
+transcribes the packed audio instead; its timestamps are mapped back to the
+span each one fell in:
+
+    ```cpp
+    #include "speech_pack.h"
+
+    const SpeechLayout layout = pack_speech(vad_speech_spans(db, thr));
+    // write the packed audio: span i of the source at layout.spans[i].at
+    double t = layout.to_source(12.34);          // packed time → source time
+    ```
+
+Spans keep their order and are never cut, so every segment whisper prints
+maps to one place in the source; a segment that runs across a join ends
+where the later span does. Long spans pass through unchanged – the gain is
+all in the short ones. A time in a gap maps to the start of the next span
+(or, for the end of a segment, the end of the previous one).
+
+The packed timeline is continuous rather than padded to 30 s boundaries:
+whisper-cli starts each window at the last timestamp it decoded, not at a
+multiple of 30 s, so padding would only put silence back. Encoder
+utilisation is speech seconds over the 30 s windows the packed audio needs;
+pack_stats() keeps the totals for the run report.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "vad.h"
+
+struct PackedSpan
+{
+    double src_start = 0.0, src_end = 0.0; // in the source
+    double at = 0.0;                       // start on the packed timeline
+    double length() const { return src_end - src_start; }
+};
+
+struct SpeechLayout
+{
+    std::vector<PackedSpan> spans;
+    double duration_sec = 0.0; // of the packed audio
+
+    double speech_sec() const
+    {
+        double sec = 0.0;
+        for (const auto &s : spans)
+            sec += s.length();
+        return sec;
+    }
+
+    /* A packed time in source time; `end` picks the earlier side of a gap. */
+    double to_source(double t, bool end = false) const
+    {
+        if (spans.empty())
+            return t;
+        auto it = std::upper_bound(spans.begin(), spans.end(), t,
+                                   [](double v, const PackedSpan &s) { return v < s.at; });
+        if (it == spans.begin())
+            return spans.front().src_start;
+        const PackedSpan &s = *--it;
+        if (t <= s.at + s.length())
+            return s.src_start + (t - s.at);
+        return end || std::next(it) == spans.end() ? s.src_end : std::next(it)->src_start;
+    }
+};
+
+inline SpeechLayout pack_speech(const std::vector<SpeechSpan> &spans, double gap_sec = 0.5)
+{
+    SpeechLayout layout;
+    for (const auto &s : spans)
+    {
+        if (s.end_sec <= s.start_sec)
+            continue;
+        const double at = layout.spans.empty() ? 0.0 : layout.duration_sec + gap_sec;
+        layout.spans.push_back({s.start_sec, s.end_sec, at});
+        layout.duration_sec = at + (s.end_sec - s.start_sec);
+    }
+    return layout;
+}
+
+/*───────────────────────────────────────────────────────────────
+  Totals over a run – what packing saved
+──────────────────────────────────────────────────────────────*/
+struct PackStats
+{
+    static constexpr double kWindowSec = 30.0;
+
+    std::atomic<std::uint64_t> chunks{0};
+    std::atomic<std::uint64_t> source_ms{0}, speech_ms{0}, packed_ms{0};
+    std::atomic<std::uint64_t> windows{0}, windows_unpacked{0}; // 30 s encoder windows
+
+    void add(double source_sec, const SpeechLayout &layout)
+    {
+        const auto ms = [](double sec) { return std::uint64_t(std::llround(sec * 1000.0)); };
+        const auto win = [](double sec) { return std::uint64_t(std::ceil(sec / kWindowSec - 1e-9)); };
+        chunks.fetch_add(1, std::memory_order_relaxed);
+        source_ms.fetch_add(ms(source_sec), std::memory_order_relaxed);
+        speech_ms.fetch_add(ms(layout.speech_sec()), std::memory_order_relaxed);
+        packed_ms.fetch_add(ms(layout.duration_sec), std::memory_order_relaxed);
+        windows.fetch_add(win(layout.duration_sec), std::memory_order_relaxed);
+        windows_unpacked.fetch_add(win(source_sec), std::memory_order_relaxed);
+    }
+};
+
+inline PackStats &pack_stats()
+{
+    static PackStats stats;
+    return stats;
+}
+
+/* {"chunks":…,"source_sec":…,"speech_sec":…,"packed_sec":…,"windows":…,"windows_unpacked":…,"utilization":…} */
+inline std::string pack_stats_json()
+{
+    const PackStats &s = pack_stats();
+    const auto sec = [](const std::atomic<std::uint64_t> &ms) { return double(ms.load()) / 1000.0; };
+    const std::uint64_t windows = s.windows.load(), unpacked = s.windows_unpacked.load();
+    const double speech = sec(s.speech_ms);
+    char buf[320];
+    std::snprintf(buf, sizeof(buf),
+                  "{\"chunks\":%llu,\"source_sec\":%.3f,\"speech_sec\":%.3f,\"packed_sec\":%.3f,\"windows\":%llu,"
+                  "\"windows_unpacked\":%llu,\"utilization\":%.4f,\"utilization_unpacked\":%.4f}",
+                  static_cast<unsigned long long>(s.chunks.load()), sec(s.source_ms), speech, sec(s.packed_ms),
+                  static_cast<unsigned long long>(windows), static_cast<unsigned long long>(unpacked),
+                  windows ? speech / (double(windows) * PackStats::kWindowSec) : 0.0,
+                  unpacked ? speech / (double(unpacked) * PackStats::kWindowSec) : 0.0);
+    return buf;
+}
@@ -1,17 +1,32 @@
 // transcribe-mp4.cpp – extract audio from an MP4, split, transcribe with whisper.cpp
-// Build: g++ -std=c++17 -O2 transcribe-mp4.cpp -o transcribe-mp4
-// Usage:   ./transcribe-mp4 <path-to-video.mp4> <path-to-whisper-model>
+// Build: g++ -std=c++17 -O2 -pthread transcribe-mp4.cpp -o transcribe-mp4
+// Usage:   ./transcribe-mp4 <path-to-video.mp4> <path-to-whisper-model> [--workers N] [--threads N] [--from T] [--to T]
+//                           [--chunk-len SEC] [--profile PATH]
+//                           [--no-watchdog] [--watchdog-retries N]
+//                           [--retries N] [--fallback-model PATH] [--chunk-timeout SEC] [--progress-fd FD]
+//                           [--report PATH] [--perf-counters] [--backend whisper-cli|mock[:RTF]]
+//                           [--simd scalar|sse4|avx2|avx512|neon] [--pcm-storage s16|f16] [--pack-speech]
+//                           [--adaptive-ctx]
+// --simd PATH forces a DSP kernel path instead of the widest one the CPU supports (see simd.h).
+// --pcm-storage s16|f16 picks the sample format of decoded audio in the PCM pool (see pcm_pool.h).
+// --pack-speech transcribes only VAD speech, packed end to end, with timestamps mapped back (speech_pack.h).
+// --adaptive-ctx sizes whisper-cli's audio context (-ac) to inputs under 30 s (adaptive_audio_ctx).
 
 #include <algorithm>
+#include <chrono>
 #include <cctype>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#define DR_WAV_IMPLEMENTATION
+#include "pipeline.h"
+
 namespace fs = std::filesystem;
 
 static std::string trim(const std::string &s)
@@ -69,146 +84,183 @@ static std::string clean_transcript_line(const std::string &raw_line)
 }
 
 /*───────────────────────────────────────────────────────────────
-  Utility – ASCII progress bar (single-line, 50 chars wide)
-──────────────────────────────────────────────────────────────*/
-static void print_progress(std::size_t current, std::size_t total)
-{
-    constexpr int bar_width = 50;
-    const float ratio = static_cast<float>(current) / total;
-    const int filled = static_cast<int>(ratio * bar_width);
-
-    std::cout << '\r' << '[';
-    for (int i = 0; i < bar_width; ++i)
-        std::cout << (i < filled ? '=' : (i == filled ? '>' : ' '));
-
-    std::cout << "] " << std::setw(3) << static_cast<int>(ratio * 100)
-              << "% (" << current << '/' << total << ")" << std::flush;
-
-    if (current == total)
-        std::cout << std::endl;
-}
-
-/*───────────────────────────────────────────────────────────────
-  Helper – run external command, abort if it fails
+  1. Extract audio from MP4 (stereo mp3) into `dir`, optionally just
+     [from, to) – ffmpeg seeks the container, so nothing outside the
+     range is decoded. An extraction finished by an earlier run is reused.
 ──────────────────────────────────────────────────────────────*/
-static void run_cmd(const std::string &cmd, bool echo = false)
+static std::string extract_audio_mp3(const std::string &video_file,
+                                     double from_sec = 0.0, double to_sec = -1.0, const std::string &dir = ".")
 {
-    if (echo)
-        std::cout << "\n> " << cmd << std::endl;
-    const int ret = std::system(cmd.c_str());
-    if (ret)
+    const std::string audio_file = (fs::path(dir) / "audio.mp3").string();
+    if (fs::exists(audio_file))
     {
-        std::cerr << "\nCommand failed (" << ret << "): " << cmd << std::endl;
-        std::exit(ret);
+        std::cout << "\nReusing " << audio_file << " from an earlier run" << std::endl;
+        return audio_file;
     }
-}
-
-/*───────────────────────────────────────────────────────────────
-  1. Extract audio from MP4 (stereo mp3)
-──────────────────────────────────────────────────────────────*/
-static std::string extract_audio_mp3(const std::string &video_file)
-{
-    const std::string audio_file = "audio.mp3";
+    /* Written under another name and renamed once complete, so an interrupted run is never reused */
+    const std::string part = (fs::path(dir) / "audio.part.mp3").string();
+    std::string seek;
+    if (from_sec > 0.0)
+        seek += "-ss " + std::to_string(from_sec) + " ";
+    if (to_sec > from_sec)
+        seek += "-t " + std::to_string(to_sec - from_sec) + " ";
     const std::string cmd =
-        "ffmpeg -hide_banner -loglevel error -i \"" + video_file +
-        "\" -vn -acodec libmp3lame -ar 44100 -ac 2 \"" + audio_file + "\"";
+        "ffmpeg -hide_banner -loglevel error -y " + seek + "-i \"" + video_file +
+        "\" -vn -acodec libmp3lame -ar 44100 -ac 2 \"" + part + "\"";
     run_cmd(cmd, /*echo=*/true);
+    fs::rename(part, audio_file);
     return audio_file;
 }
 
-/*───────────────────────────────────────────────────────────────
-  2. Split audio into ≤10-min chunks (mp3 copy)
-──────────────────────────────────────────────────────────────*/
-static std::vector<std::string> split_audio(const std::string &audio_file,
-                                            int chunk_len_sec = 600)
-{
-    const std::string cmd =
-        "ffmpeg -hide_banner -loglevel error -i \"" + audio_file +
-        "\" -f segment -segment_time " + std::to_string(chunk_len_sec) +
-        " -c copy chunk_%03d.mp3";
-    run_cmd(cmd, /*echo=*/true);
-
-    std::vector<std::string> chunks;
-    for (auto &p : fs::directory_iterator(fs::current_path()))
-    {
-        const auto name = p.path().filename().string();
-        if (p.path().extension() == ".mp3" && name.rfind("chunk_", 0) == 0)
-            chunks.push_back(p.path().string());
-    }
-    std::sort(chunks.begin(), chunks.end());
-    if (chunks.empty())
-    {
-        std::cerr << "No chunks produced – check ffmpeg output." << std::endl;
-        std::exit(1);
-    }
-    return chunks;
-}
+/* whisper-cli settings and failure policy from the command line (model is set per call) */
+static WhisperOptions whisper_options;
+static RetryPolicy retry_policy;
+static int progress_fd = -1; // --progress-fd: NDJSON progress events
+static int chunk_len_sec = 600; // --chunk-len
 
 /*───────────────────────────────────────────────────────────────
-  3. Transcribe each chunk and concatenate results
+  3. Transcribe each chunk and concatenate results; chunks finished
+     by an earlier run come from the checkpoint, failed ones become
+     marked gaps (counted in `gaps`) instead of ending the run
 ──────────────────────────────────────────────────────────────*/
-static std::string transcribe_chunks(const std::vector<std::string> &chunks,
-                                     const std::string &model_path)
+static std::string transcribe_chunks(const std::vector<AudioChunk> &chunks,
+                                     const std::string &model_path,
+                                     std::size_t workers, bool timestamps,
+                                     const Checkpoint &checkpoint, std::size_t &gaps)
 {
-    std::string transcription;
     const std::size_t total = chunks.size();
-    std::size_t done = 0;
-    print_progress(0, total);
+    std::vector<std::string> parts(total);
+    gaps = 0;
+    std::mutex gaps_mutex;
+    ProgressReporter progress(chunk_durations(chunks), workers, progress_fd);
+
+    run_workers(workers, total, [&](std::size_t worker, std::size_t i) {
+        const AudioChunk &chunk = chunks[i];
+
+        /* Decode this chunk's byte range → WAV (16 kHz mono) in the work
+           directory → whisper.cpp CLI */
+        std::vector<std::string> lines;
+        bool ok = true;
+        WhisperOptions opts = whisper_options;
+        opts.model = model_path;
+        const bool cached = checkpoint.load(chunk, opts, lines);
+        if (!cached)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "chunk_%03zu.wav", chunk.index);
+            const fs::path wav = fs::path(checkpoint.enabled() ? checkpoint.dir() : ".") / name;
+            ok = transcribe_chunk_robust(chunk, wav.string(), opts, retry_policy, lines,
+                                         [&](const char *stage, double at) { progress.update(worker, i, stage, at); });
+            if (ok)
+                checkpoint.save(chunk, opts, lines);
+        }
 
-    for (const auto &chunk : chunks)
-    {
-        /* Convert MP3 → WAV (16 kHz mono) */
-        const std::string wav = fs::path(chunk).stem().string() + ".wav";
-        run_cmd("ffmpeg -hide_banner -loglevel error -i \"" + chunk +
-                "\" -ar 16000 -ac 1 \"" + wav + "\"");
-
-        /* Whisper.cpp CLI */
-        const std::string txt = wav + ".txt";
-        run_cmd("./whisper.cpp/build/bin/whisper-cli -m \"" + model_path +
-                "\" -f \"" + wav + "\" > \"" + txt + "\"");
-
-        /* Append transcript */
-        if (std::ifstream ifs{txt})
+        /* Keep transcript */
+        StageTimer timer(Stage::Postprocess);
+        MemScope mem(Stage::Postprocess);
+        bool wrote_line = false;
+        Segment seg;
+        for (const auto &line : lines)
         {
-            std::string line;
-            bool wrote_line = false;
-            while (std::getline(ifs, line))
+            /* Partial runs keep global timestamps so text can be located; so do gaps */
+            if (parse_segment_line(trim(line), seg) && (timestamps || starts_with(seg.text, "[gap:")))
             {
-                const auto cleaned = clean_transcript_line(line);
-                if (cleaned.empty())
-                    continue;
-
-                transcription += cleaned;
-                transcription += '\n';
+                seg.t0 += chunk.global_start();
+                seg.t1 += chunk.global_start();
+                parts[i] += format_segment_line(seg);
+                parts[i] += '\n';
                 wrote_line = true;
+                continue;
             }
 
-            if (wrote_line)
-                transcription += '\n';
+            const auto cleaned = clean_transcript_line(line);
+            if (cleaned.empty())
+                continue;
+
+            parts[i] += cleaned;
+            parts[i] += '\n';
+            wrote_line = true;
         }
 
+        if (wrote_line)
+            parts[i] += '\n';
+
         /* Clean-up per-chunk artefacts */
-        fs::remove(chunk);
-        fs::remove(wav);
-        fs::remove(txt);
+        release_chunk_source(chunk);
 
-        print_progress(++done, total);
-    }
+        progress.finish(worker, i, cached);
+        std::lock_guard<std::mutex> lock(gaps_mutex);
+        gaps += ok ? 0 : 1;
+    });
+
+    std::string transcription;
+    for (const auto &part : parts)
+        transcription += part;
     return transcription;
 }
 
 /*───────────────────────────────────────────────────────────────*/
-int main(int argc, char *argv[])
+static int run(int argc, char *argv[])
 {
-    if (argc < 3)
+    const auto started = std::chrono::steady_clock::now();
+    CliArgs args = parse_args(argc, argv, {"--no-watchdog", "--perf-counters", "--pack-speech", "--adaptive-ctx"});
+    if (!apply_host_profile(args))
+    {
+        std::cerr << "Could not read host profile " << args.get("--profile") << std::endl;
+        return 1;
+    }
+    double from_sec = 0.0, to_sec = -1.0;
+    if (args.positional.size() < 2 ||
+        (args.has("--from") && !parse_time(args.get("--from"), from_sec)) ||
+        (args.has("--to") && (!parse_time(args.get("--to"), to_sec) || to_sec <= from_sec)))
     {
         std::cerr << "Usage: " << argv[0]
-                  << " <path-to-video.mp4> <path-to-whisper-model>" << std::endl;
+                  << " <path-to-video.mp4> <path-to-whisper-model> [--workers N] [--threads N]"
+                     " [--chunk-len SEC] [--profile PATH]"
+                     " [--from HH:MM:SS] [--to HH:MM:SS] [--no-watchdog] [--watchdog-retries N]"
+                     " [--retries N] [--fallback-model PATH] [--chunk-timeout SEC] [--progress-fd FD]"
+                     " [--report PATH] [--perf-counters] [--backend whisper-cli|mock[:RTF]]"
+                     " [--simd scalar|sse4|avx2|avx512|neon] [--pcm-storage s16|f16] [--pack-speech]"
+                     " [--adaptive-ctx]"
+                  << std::endl;
         return 1;
     }
-
-    const std::string video_path = argv[1];
-    const std::string model_path = argv[2];
+    const bool ranged = args.has("--from") || args.has("--to");
+
+    const std::string video_path = args.positional[0];
+    const std::string model_path = args.positional[1];
+    const auto workers = static_cast<std::size_t>(args.num("--workers", 1));
+    whisper_options.watchdog = !args.has("--no-watchdog");
+    whisper_options.retries = static_cast<int>(args.num("--watchdog-retries", 1));
+    whisper_options.timeout_sec = args.num("--chunk-timeout", 0);
+    whisper_options.threads = static_cast<int>(args.num("--threads", 0));
+    whisper_options.pack_speech = args.has("--pack-speech");
+    whisper_options.adaptive_ctx = args.has("--adaptive-ctx");
+    std::string backend_error;
+    whisper_options.backend = make_inference_backend(args.get("--backend"), backend_error);
+    if (!whisper_options.backend)
+    {
+        std::cerr << backend_error << std::endl;
+        return 1;
+    }
+    if (args.has("--simd") && !simd_force(args.get("--simd"), backend_error))
+    {
+        std::cerr << backend_error << std::endl;
+        return 1;
+    }
+    PcmStorage pcm_storage = PcmStorage::S16;
+    if (args.has("--pcm-storage") && !parse_pcm_storage(args.get("--pcm-storage"), pcm_storage))
+    {
+        std::cerr << "Unknown --pcm-storage " << args.get("--pcm-storage") << " (s16 or f16)" << std::endl;
+        return 1;
+    }
+    pcm_pool().set_storage(pcm_storage);
+    chunk_len_sec = std::max(1, static_cast<int>(args.num("--chunk-len", 600)));
+    retry_policy.retries = static_cast<int>(args.num("--retries", 1));
+    retry_policy.fallback_model = args.get("--fallback-model");
+    progress_fd = static_cast<int>(args.num("--progress-fd", -1));
+    if (args.has("--perf-counters") && !perf_counters_enable())
+        std::cerr << "Hardware counters unavailable, continuing without them" << std::endl;
 
     if (!fs::exists(video_path) || !fs::is_regular_file(video_path))
     {
@@ -216,11 +268,57 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    const std::string audio_file = extract_audio_mp3(video_path);
-    const auto chunks = split_audio(audio_file);
-    const auto script = transcribe_chunks(chunks, model_path);
+    /* The audio and finished chunks survive a failed run, keyed by the video and range */
+    std::error_code ec;
+    const auto size = fs::file_size(video_path, ec);
+    const auto mtime = fs::last_write_time(video_path, ec).time_since_epoch().count();
+    const Checkpoint checkpoint(fs::absolute(video_path).string() + '|' + std::to_string(size) + '|' +
+                                std::to_string(mtime) + '|' + std::to_string(from_sec) + '|' +
+                                std::to_string(to_sec));
+
+    const std::string audio_file =
+        extract_audio_mp3(video_path, from_sec, to_sec, checkpoint.enabled() ? checkpoint.dir() : ".");
+    const auto chunks = split_audio(audio_file, chunk_len_sec, 0.0, -1.0, /*origin_sec=*/from_sec);
+
+    std::size_t gaps = 0;
+    const auto script = transcribe_chunks(chunks, model_path, workers, ranged, checkpoint, gaps);
+
+    if (gaps)
+        /* Keep the audio and finished chunks: a rerun only redoes the gaps */
+        std::cerr << gaps << " of " << chunks.size() << " chunk(s) failed and are marked as gaps; "
+                  << "run the same command again to retry just those (work kept in "
+                  << checkpoint.dir() << ")." << std::endl;
+    else
+    {
+        fs::remove(audio_file);
+        checkpoint.clear();
+    }
 
-    fs::remove(audio_file);
+    if (args.has("--report"))
+    {
+        double audio_sec = 0.0;
+        for (const auto &c : chunks)
+            audio_sec += c.duration();
+        RunReport report;
+        report.add("tool", "transcribe-mp4");
+        report.add("mode", "full");
+        report.add("source", video_path);
+        report.add("model", model_path);
+        report.add("workers", double(workers));
+        report.add("threads", double(whisper_options.threads));
+        report.add("backend", whisper_options.backend->name());
+        report.add("pack_speech", whisper_options.pack_speech ? "on" : "off");
+        report.add("adaptive_ctx", whisper_options.adaptive_ctx ? "on" : "off");
+        report.add("chunks", double(chunks.size()));
+        report.add("audio_sec", audio_sec);
+        report.add("gaps", double(gaps));
+        report.add("wall_sec", std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        report.raw("watchdog", watchdog_json());
+        if (!report.write(args.get("--report")))
+            std::cerr << "Could not write report to " << args.get("--report") << std::endl;
+    }
+    if (whisper_options.watchdog)
+        print_watchdog_stats();
 
     const std::string transcript_filename =
         fs::path(video_path).stem().string() + "_transcript.txt";
@@ -244,3 +342,15 @@ int main(int argc, char *argv[])
     return 0;
 }
 
+int main(int argc, char *argv[])
+{
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const JobError &e)
+    {
+        std::cerr << '\n' << e.what() << std::endl;
+        return e.status;
+    }
+}
@@ -1,157 +1,843 @@
 // transcribe.cpp – download YouTube audio, split, transcribe with whisper.cpp and show a live progress bar
-// Build: g++ -std=c++17 -O2 transcribe.cpp -o transcribe
-// Usage:   ./transcribe <YouTube URL> <path-to-whisper-model>
+// Build: g++ -std=c++17 -O2 -pthread transcribe.cpp -o transcribe
+// Usage:   ./transcribe <YouTube URL> <path-to-whisper-model> [--workers N] [--threads N] [--from T] [--to T]
+//                        [--chunk-len SEC] [--profile PATH]
+//                        [--preview [BUDGET_SEC]] [--preview-window SEC] [--refine <full-model>]
+//                        [--no-watchdog] [--watchdog-retries N]
+//                        [--retries N] [--fallback-model PATH] [--chunk-timeout SEC] [--progress-fd FD]
+//                        [--report PATH] [--perf-counters] [--backend whisper-cli|mock[:RTF[:LOAD]]]
+//                        [--simd scalar|sse4|avx2|avx512|neon] [--pcm-storage s16|f16] [--pack-speech]
+//                        [--adaptive-ctx]
+// --report PATH writes a JSON summary of the run, including per-stage latency percentiles;
+// with --perf-counters it also carries cycles, instructions, LLC and branch misses per stage.
+// The report always includes RSS per stage and peak RSS of the process and of whisper-cli;
+// build with -DTRANSCRIBE_COUNT_ALLOCS to also attribute heap bytes to stages.
+// --daemon <model> [--jobs N] [--metrics-port PORT] [--metrics-file PATH] keeps running:
+//   one job per stdin line ("<URL> [--from T] [--to T] [--id ID]"), one NDJSON result per job
+//   on stdout, Prometheus metrics on http://127.0.0.1:PORT/metrics and/or in a textfile.
+// --backend mock[:RTF[:LOAD]] replaces whisper-cli with synthetic segments at RTF seconds per audio
+//   second (default 0.05), after LOAD seconds of simulated model load per run (default 0); the model
+//   path is then ignored, so the rest of the pipeline runs without a model.
+// --simd PATH forces a DSP kernel path (resampler, downmix, VAD energy); by default the widest the
+//   CPU supports is picked at startup. The report names the path in use under "simd".
+// --pcm-storage s16|f16 picks the sample format of decoded audio held in the PCM pool (pcm_pool.h);
+//   the report shows the format and the pool's peak size under "pcm_pool".
+// --pack-speech sends whisper only the speech the VAD finds in each chunk, spans packed end to end
+//   half a second apart, and maps the timestamps back; the report's "speech_pack" shows how many
+//   30 s encoder windows that took against the unpacked audio.
+// --adaptive-ctx runs whisper-cli with a reduced audio context (-ac) for inputs well under 30 s – a
+//   short last chunk, a preview window, packed speech – sized to the input with a safety margin;
+//   "encoder" in the report gives the share of full-context encoder work actually done.
+// --profile PATH takes --workers, --threads and --chunk-len from a host profile (bench scale --profile).
+// --progress-fd FD writes NDJSON progress events (audio done, speed, ETA, workers) to FD.
+// A failed chunk is retried, then marked as a gap; finished chunks are kept under
+// .transcribe-work/ so running the same command again only redoes the gaps.
+// With --refine, <path-to-whisper-model> is the fast model and stdout is NDJSON only (all
+// other output goes to stderr):
+//   {"type":"segment","id":…}  first text for a segment (fast model)
+//   {"type":"replace","id":…}  the full model's text for that segment
+//   {"type":"refined",…} / {"type":"done"}
 // Example: ./transcribe https://youtu.be/dQw4w9WgXcQ ./whisper.cpp/models/ggml-base.en.bin
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#define DR_WAV_IMPLEMENTATION
+#include "pipeline.h"
+#include "prometheus.h"
+
 namespace fs = std::filesystem;
 
 /*───────────────────────────────────────────────────────────────
-  Utility – ASCII progress bar (single-line, 50 chars wide)
+  1. Download audio from YouTube (Opus/WebM as-is, else mp3 128 kbps)
+     into `dir`. With a time range, only that section is fetched when
+     yt-dlp can; `origin_sec` receives the global time of the file's
+     first sample. A download finished by an earlier run is reused.
 ──────────────────────────────────────────────────────────────*/
-static void print_progress(std::size_t current, std::size_t total)
+static std::string download_audio(const std::string &url, double from_sec, double to_sec,
+                                  double &origin_sec, const std::string &dir = ".")
 {
-    constexpr int bar_width = 50;
-    const float ratio = static_cast<float>(current) / total;
-    const int filled = static_cast<int>(ratio * bar_width);
+    const std::string webm = (fs::path(dir) / "audio.webm").string();
+    const std::string mp3 = (fs::path(dir) / "audio.mp3").string();
+    const std::string record = (fs::path(dir) / "source.txt").string();
+
+    std::string have;
+    if (std::ifstream in{record}; in >> have >> origin_sec && fs::exists(have))
+    {
+        pipeline_counters().download_cache_hits.fetch_add(1, std::memory_order_relaxed);
+        std::cout << "\nReusing " << have << " from an earlier run" << std::endl;
+        return have;
+    }
+    pipeline_counters().download_cache_misses.fetch_add(1, std::memory_order_relaxed);
+    const auto started = std::chrono::steady_clock::now();
+    const auto done = [&](const std::string &file, double origin) {
+        std::error_code ec;
+        const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (const auto bytes = fs::file_size(file, ec); !ec && sec > 0.0)
+            record_stage(Stage::Download, std::uint64_t(double(bytes) / sec));
+        origin_sec = origin;
+        std::ofstream(record) << file << ' ' << origin << '\n';
+        return file;
+    };
+
+    const auto opus_cmd = [&](const std::string &extra) {
+        return "yt-dlp --no-warnings -f \"bestaudio[acodec=opus][ext=webm]\" " + extra +
+               "-o \"" + webm + "\" \"" + url + "\"";
+    };
+    const auto mp3_cmd = [&](const std::string &extra) {
+        return "yt-dlp --no-warnings -x --audio-format mp3 --audio-quality 128 " + extra +
+               "-o \"" + mp3 + "\" \"" + url + "\"";
+    };
+
+    if (from_sec > 0.0 || to_sec > 0.0)
+    {
+        char section[96];
+        std::snprintf(section, sizeof(section), "--download-sections \"*%.3f-%s\" ", from_sec,
+                      to_sec > 0.0 ? std::to_string(to_sec).c_str() : "inf");
+        if (WebmOpusDecoder::available() && try_cmd(opus_cmd(section), /*echo=*/true))
+            return done(webm, from_sec);
+        if (try_cmd(mp3_cmd(section), /*echo=*/true))
+            return done(mp3, from_sec);
+        std::cerr << "Section download failed, fetching the whole file." << std::endl;
+    }
+
+    /* The Opus stream decodes in-process straight to 16 kHz – no transcode */
+    if (WebmOpusDecoder::available() && try_cmd(opus_cmd(""), /*echo=*/true))
+        return done(webm, 0.0);
 
-    std::cout << '\r' << '[';
-    for (int i = 0; i < bar_width; ++i)
-        std::cout << (i < filled ? '=' : (i == filled ? '>' : ' '));
+    /* One retry for transient network errors before giving up */
+    if (!try_cmd(mp3_cmd(""), /*echo=*/true))
+        run_cmd(mp3_cmd(""), /*echo=*/true);
+    return done(mp3, 0.0);
+}
+
+/* whisper-cli settings and failure policy from the command line (model is set per call) */
+static WhisperOptions whisper_options;
+static RetryPolicy retry_policy;
+static int progress_fd = -1; // --progress-fd: NDJSON progress events
+static int chunk_len_sec = 600; // --chunk-len
+static bool progress_bar = true; // off in daemon mode, where jobs run side by side
 
-    std::cout << "] " << std::setw(3) << static_cast<int>(ratio * 100)
-              << "% (" << current << '/' << total << ")" << std::flush;
+/*───────────────────────────────────────────────────────────────
+  3. Transcribe one chunk – whisper-cli output, segment timestamps
+     moved to global time. A chunk that fails every retry comes back
+     as one gap segment and `ok` is cleared.
+──────────────────────────────────────────────────────────────*/
+static std::vector<std::string> whisper_chunk(const AudioChunk &chunk, const std::string &model_path,
+                                              const std::string &work_dir, const char *tag = "chunk",
+                                              bool *ok = nullptr,
+                                              const std::function<void(const char *, double)> &status = {})
+{
+    /* Decode this chunk's byte range → WAV (16 kHz mono) in the job's work
+       directory → whisper.cpp CLI */
+    char name[48];
+    std::snprintf(name, sizeof(name), "%s_%03zu.wav", tag, chunk.index);
+    WhisperOptions opts = whisper_options;
+    opts.model = model_path;
+    std::vector<std::string> lines;
+    const bool done =
+        transcribe_chunk_robust(chunk, (fs::path(work_dir) / name).string(), opts, retry_policy, lines, status);
+    if (ok)
+        *ok = done;
 
-    if (current == total)
-        std::cout << std::endl;
+    StageTimer timer(Stage::Postprocess);
+    MemScope mem(Stage::Postprocess);
+    Segment seg;
+    for (auto &line : lines)
+        if (parse_segment_line(line, seg))
+        {
+            seg.t0 += chunk.global_start();
+            seg.t1 += chunk.global_start();
+            line = format_segment_line(seg);
+        }
+    return lines;
 }
 
 /*───────────────────────────────────────────────────────────────
-  Helper – run external command, abort if it fails
+  4. Transcribe each chunk and concatenate results; chunks finished
+     by an earlier run come from the checkpoint, failed ones become
+     marked gaps (counted in `gaps`) instead of ending the run
 ──────────────────────────────────────────────────────────────*/
-static void run_cmd(const std::string &cmd, bool echo = false)
+static std::string transcribe_chunks(const std::vector<AudioChunk> &chunks,
+                                     const std::string &model_path,
+                                     std::size_t workers, const Checkpoint &checkpoint,
+                                     std::size_t &gaps, const char *tag = "chunk")
 {
-    if (echo)
-        std::cout << "\n> " << cmd << std::endl;
-    const int ret = std::system(cmd.c_str());
-    if (ret)
+    const std::size_t total = chunks.size();
+    std::vector<std::string> parts(total);
+    gaps = 0;
+    std::mutex gaps_mutex;
+    ProgressReporter progress(chunk_durations(chunks), workers, progress_fd, progress_bar);
+
+    run_workers(workers, total, [&](std::size_t worker, std::size_t i) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "chunk_%03zu:\n", chunks[i].index);
+        parts[i] = name;
+
+        std::vector<std::string> lines;
+        bool ok = true;
+        WhisperOptions settings = whisper_options;
+        settings.model = model_path;
+        const bool cached = checkpoint.load(chunks[i], settings, lines);
+        if (!cached)
+        {
+            lines = whisper_chunk(chunks[i], model_path, checkpoint.enabled() ? checkpoint.dir() : ".", tag, &ok,
+                                  [&](const char *stage, double at) { progress.update(worker, i, stage, at); });
+            if (ok)
+                checkpoint.save(chunks[i], settings, lines);
+        }
+        for (const auto &line : lines)
+        {
+            parts[i] += line;
+            parts[i] += '\n';
+        }
+        parts[i] += '\n';
+        release_chunk_source(chunks[i]);
+
+        progress.finish(worker, i, cached);
+        std::lock_guard<std::mutex> lock(gaps_mutex);
+        gaps += ok ? 0 : 1;
+    });
+
+    std::string transcription;
+    for (const auto &part : parts)
+        transcription += part;
+    return transcription;
+}
+
+/*───────────────────────────────────────────────────────────────
+  4b. Preview – transcribe sampled windows until the budget runs
+      out; only timestamped segments are kept, in time order
+──────────────────────────────────────────────────────────────*/
+static std::string transcribe_preview(const PreviewPlan &plan, const std::string &model_path,
+                                      const std::string &work_dir, std::size_t workers,
+                                      std::chrono::steady_clock::time_point deadline)
+{
+    const std::size_t total = plan.windows.size();
+    std::vector<std::vector<Segment>> found(total);
+    ProgressReporter progress(chunk_durations(plan.windows), workers, progress_fd);
+
+    const std::size_t ran = run_workers_until(workers, total, deadline, [&](std::size_t worker, std::size_t i) {
+        Segment seg;
+        const auto status = [&](const char *stage, double at) { progress.update(worker, i, stage, at); };
+        for (const auto &line : whisper_chunk(plan.windows[i], model_path, work_dir, "chunk", nullptr, status))
+            if (parse_segment_line(line, seg) && !seg.text.empty())
+                found[i].push_back(seg);
+        progress.finish(worker, i);
+    });
+    progress.close();
+
+    /* Windows back in time order; a blank line marks each gap */
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < ran; ++i)
+        if (!found[i].empty())
+            order.push_back(i);
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return plan.windows[a].global_start() < plan.windows[b].global_start();
+    });
+
+    const double window_sec = total ? plan.windows[0].range.end_sec - plan.windows[0].range.start_sec : 0.0;
+    std::string out = "Preview: " + std::to_string(ran) + " of " + std::to_string(plan.candidates) +
+                      " windows (" + std::to_string(int(std::lround(window_sec))) +
+                      " s each) sampled across " + format_timestamp(plan.duration_sec) + "\n\n";
+    for (std::size_t i : order)
     {
-        std::cerr << "\nCommand failed (" << ret << "): " << cmd << std::endl;
-        std::exit(ret);
+        for (const auto &seg : found[i])
+            out += format_segment_line(seg) + '\n';
+        out += '\n';
     }
+    return out;
 }
 
 /*───────────────────────────────────────────────────────────────
-  1. Download audio from YouTube (mp3 128 kbps)
+  4c. Progressive refinement – stream the fast model's segments as
+      NDJSON, then `replace` them as the full model finishes each
+      chunk. Segment IDs ("<chunk>.<n>") come from the fast pass and
+      never change.
 ──────────────────────────────────────────────────────────────*/
-static std::string download_audio(const std::string &url)
-{
-    const std::string cmd =
-        "yt-dlp --no-warnings -x --audio-format mp3 --audio-quality 128 "
-        "-o audio.mp3 \"" +
-        url + "\"";
-    run_cmd(cmd, /*echo=*/true);
-    return "audio.mp3";
+static std::vector<Segment> chunk_segments(const AudioChunk &chunk, const std::string &model_path,
+                                           const std::string &work_dir, const char *tag)
+{
+    std::vector<Segment> segs;
+    Segment seg;
+    for (const auto &line : whisper_chunk(chunk, model_path, work_dir, tag))
+        if (parse_segment_line(line, seg) && !seg.text.empty())
+            segs.push_back(seg);
+    return segs;
+}
+
+/* Full-model text for each fast segment: every full segment goes to the fast
+   segment holding its midpoint, or the nearest one when it falls in a gap. */
+static std::vector<std::string> align_segments(const std::vector<Segment> &fast,
+                                               const std::vector<Segment> &full)
+{
+    std::vector<std::string> text(fast.size());
+    for (const auto &f : full)
+    {
+        const double mid = (f.t0 + f.t1) / 2;
+        std::size_t best = 0;
+        double best_dist = 1e300;
+        for (std::size_t k = 0; k < fast.size(); ++k)
+        {
+            const double d = mid < fast[k].t0 ? fast[k].t0 - mid : mid > fast[k].t1 ? mid - fast[k].t1 : 0.0;
+            if (d < best_dist)
+                best = k, best_dist = d;
+        }
+        if (!text[best].empty())
+            text[best] += ' ';
+        text[best] += f.text;
+    }
+    return text;
+}
+
+static std::string segment_event(const char *type, const std::string &id, const Segment &seg,
+                                 const char *model)
+{
+    char times[64];
+    std::snprintf(times, sizeof(times), "\"t0\":%.3f,\"t1\":%.3f,", seg.t0, seg.t1);
+    return std::string("{\"type\":\"") + type + "\",\"id\":" + json_string(id) + "," + times +
+           "\"model\":\"" + model + "\",\"text\":" + json_string(seg.text) + "}";
+}
+
+static void transcribe_refine(const std::vector<AudioChunk> &chunks, const std::string &fast_model,
+                              const std::string &full_model, const std::string &work_dir, std::size_t workers,
+                              FILE *events)
+{
+    struct State
+    {
+        bool fast_done = false, full_done = false;
+        std::vector<Segment> fast, full;
+    };
+    const std::size_t n = chunks.size();
+    std::vector<State> state(n);
+    std::size_t finished = 0;
+    std::mutex m;
+
+    const auto id_of = [](const AudioChunk &c, std::size_t k) {
+        return std::to_string(c.index) + "." + std::to_string(k);
+    };
+    const auto put = [&](const std::string &line) {
+        std::fputs(line.c_str(), events);
+        std::fputc('\n', events);
+    };
+
+    /* Called with `m` held once both passes of a chunk – or just the fast one – are in */
+    const auto emit_fast = [&](std::size_t i) {
+        const State &st = state[i];
+        const auto &segs = st.full_done && !st.full.empty() ? st.full : st.fast;
+        const char *model = st.full_done ? "full" : "fast";
+        for (std::size_t k = 0; k < segs.size(); ++k)
+            put(segment_event("segment", id_of(chunks[i], k), segs[k], model));
+        std::fflush(events);
+    };
+    const auto emit_full = [&](std::size_t i) {
+        const State &st = state[i];
+        if (st.fast.empty())
+        {
+            for (std::size_t k = 0; k < st.full.size(); ++k)
+                put(segment_event("segment", id_of(chunks[i], k), st.full[k], "full"));
+        }
+        else
+        {
+            const auto text = align_segments(st.fast, st.full);
+            for (std::size_t k = 0; k < st.fast.size(); ++k)
+            {
+                Segment seg = st.fast[k];
+                seg.text = text[k];
+                put(segment_event("replace", id_of(chunks[i], k), seg, "full"));
+            }
+        }
+        std::fflush(events);
+    };
+
+    /* Jobs [0, n) are the fast pass, [n, 2n) the full pass – claimed in that order */
+    run_workers(workers, 2 * n, [&](std::size_t, std::size_t j) {
+        const bool full = j >= n;
+        const std::size_t i = full ? j - n : j;
+        auto segs = chunk_segments(chunks[i], full ? full_model : fast_model, work_dir, full ? "full" : "fast");
+
+        std::lock_guard<std::mutex> lock(m);
+        State &st = state[i];
+        if (full)
+        {
+            st.full = std::move(segs);
+            st.full_done = true;
+            if (st.fast_done)
+                emit_full(i);
+        }
+        else
+        {
+            st.fast = std::move(segs);
+            st.fast_done = true;
+            emit_fast(i);
+        }
+        if (st.fast_done && st.full_done)
+        {
+            release_chunk_source(chunks[i]);
+            put("{\"type\":\"refined\",\"chunks\":" + std::to_string(++finished) + ",\"total\":" +
+                std::to_string(n) + "}");
+            std::fflush(events);
+        }
+    });
+    put("{\"type\":\"done\"}");
+    std::fflush(events);
 }
 
 /*───────────────────────────────────────────────────────────────
-  2. Split audio into ≤10-min chunks (mp3 copy)
+  5. One full job – download, split, transcribe. With gaps the
+     audio and finished chunks stay in the work directory so the
+     same job run again only redoes those; otherwise it is removed.
 ──────────────────────────────────────────────────────────────*/
-static std::vector<std::string> split_audio(const std::string &audio_file,
-                                            int chunk_len_sec = 600)
+struct JobResult
+{
+    std::string script;
+    std::size_t chunks = 0, gaps = 0;
+    double audio_sec = 0.0;
+    std::string work_dir; // kept when gaps > 0
+};
+
+static std::string job_key(const std::string &url, double from_sec, double to_sec)
 {
-    const std::string cmd =
-        "ffmpeg -hide_banner -loglevel error -i \"" + audio_file +
-        "\" -f segment -segment_time " + std::to_string(chunk_len_sec) +
-        " -c copy chunk_%03d.mp3";
-    run_cmd(cmd, /*echo=*/true);
+    return url + '|' + std::to_string(from_sec) + '|' + std::to_string(to_sec);
+}
+
+static double audio_sec(const std::vector<AudioChunk> &chunks)
+{
+    double sec = 0.0;
+    for (const auto &c : chunks)
+        sec += c.duration();
+    return sec;
+}
 
-    std::vector<std::string> chunks;
-    for (auto &p : fs::directory_iterator(fs::current_path()))
+static JobResult transcribe_job(const std::string &url, const std::string &model_path, std::size_t workers,
+                                double from_sec, double to_sec, const char *tag = "chunk")
+{
+    /* Work directory for this URL and range – survives a failed run */
+    const Checkpoint checkpoint(job_key(url, from_sec, to_sec));
+    double origin_sec = 0.0;
+    std::string audio_file;
+    try
+    {
+        audio_file = download_audio(url, from_sec, to_sec, origin_sec, checkpoint.enabled() ? checkpoint.dir() : ".");
+    }
+    catch (const JobError &)
     {
-        const auto name = p.path().filename().string();
-        if (p.path().extension() == ".mp3" && name.rfind("chunk_", 0) == 0)
-            chunks.push_back(p.path().string());
+        count_error(Stage::Download);
+        throw;
     }
-    std::sort(chunks.begin(), chunks.end());
-    if (chunks.empty())
+
+    std::vector<AudioChunk> chunks;
+    try
+    {
+        chunks = split_audio(audio_file, chunk_len_sec, from_sec - origin_sec, to_sec > 0.0 ? to_sec - origin_sec : -1.0,
+                             origin_sec);
+    }
+    catch (const JobError &)
+    {
+        count_error(Stage::Segmentation);
+        throw;
+    }
+
+    JobResult r;
+    r.script = transcribe_chunks(chunks, model_path, workers, checkpoint, r.gaps, tag);
+    r.chunks = chunks.size();
+    r.audio_sec = audio_sec(chunks);
+    if (r.gaps)
+        r.work_dir = checkpoint.dir();
+    else
     {
-        std::cerr << "No chunks produced – check ffmpeg output." << std::endl;
-        std::exit(1);
+        fs::remove(audio_file);
+        checkpoint.clear();
     }
-    return chunks;
+    return r;
 }
 
 /*───────────────────────────────────────────────────────────────
-  3. Transcribe each chunk and concatenate results
+  6. Daemon – jobs arrive on stdin, one per line:
+       <URL> [--from T] [--to T] [--id ID]
+     and each result leaves as one NDJSON line on stdout:
+       {"type":"job","id":…,"status":"done","gaps":…,"transcript":…}
+       {"type":"job","id":…,"status":"failed","error":…}
+     Everything else the pipeline prints goes to stderr. Metrics are
+     served on --metrics-port and/or written to --metrics-file.
 ──────────────────────────────────────────────────────────────*/
-static std::string transcribe_chunks(const std::vector<std::string> &chunks,
-                                     const std::string &model_path)
+struct DaemonJob
 {
-    std::string transcription;
-    const std::size_t total = chunks.size();
-    std::size_t done = 0;
-    print_progress(0, total);
+    std::size_t seq = 0; // names the job's temporary files; `id` is the caller's
+    std::string id, url;
+    double from_sec = 0.0, to_sec = -1.0;
+};
 
-    for (const auto &chunk : chunks)
+static bool parse_job_line(const std::string &text, std::size_t seq, DaemonJob &job, std::string &error)
+{
+    std::vector<std::string> words{"job"};
+    std::istringstream in(text);
+    for (std::string w; in >> w;)
+        words.push_back(w);
+    std::vector<char *> argv;
+    for (auto &w : words)
+        argv.push_back(&w[0]);
+    const CliArgs a = parse_args(int(argv.size()), argv.data());
+
+    job = DaemonJob();
+    job.seq = seq;
+    job.id = a.has("--id") ? a.get("--id") : std::to_string(seq);
+    if (a.positional.size() != 1)
+        error = "expected one URL";
+    else if ((a.has("--from") && !parse_time(a.get("--from"), job.from_sec)) ||
+             (a.has("--to") && (!parse_time(a.get("--to"), job.to_sec) || job.to_sec <= job.from_sec)))
+        error = "bad --from/--to";
+    else
+        job.url = a.positional[0];
+    return error.empty();
+}
+
+static int run_daemon(const CliArgs &args)
+{
+    if (args.positional.empty())
     {
-        /* Convert MP3 → WAV (16 kHz mono) */
-        const std::string wav = fs::path(chunk).stem().string() + ".wav";
-        run_cmd("ffmpeg -hide_banner -loglevel error -i \"" + chunk +
-                "\" -ar 16000 -ac 1 \"" + wav + "\"");
+        std::cerr << "Usage: transcribe --daemon <path-to-whisper-model> [--jobs N] [--workers N] [--threads N]"
+                     " [--metrics-port PORT] [--metrics-file PATH]" << std::endl;
+        return 1;
+    }
+    const std::string model_path = args.positional[0];
+    const auto runners = static_cast<std::size_t>(std::max(1.0, args.num("--jobs", 1)));
+    const auto workers = static_cast<std::size_t>(args.num("--workers", 1));
+    const std::string metrics_file = args.get("--metrics-file");
+    progress_bar = false;
 
-        /* Whisper.cpp CLI */
-        const std::string txt = wav + ".txt";
-        run_cmd("./whisper.cpp/build/bin/whisper-cli -m \"" + model_path +
-                "\" -f \"" + wav + "\" > \"" + txt + "\" 2>&1");
+    /* stdout carries results only: yt-dlp, ffmpeg and our own chatter go to stderr */
+    FILE *events = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    std::mutex events_mutex;
+    const auto emit = [&](const std::string &line) {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        std::fputs(line.c_str(), events);
+        std::fputc('\n', events);
+        std::fflush(events);
+    };
 
-        /* Append transcript */
-        if (std::ifstream ifs{txt})
+    MetricsServer server;
+    if (args.has("--metrics-port"))
+    {
+        std::string error;
+        if (!server.start(static_cast<int>(args.num("--metrics-port", 0)), error))
         {
-            transcription += fs::path(txt).stem().string() + ":\n";
-            transcription.append(std::istreambuf_iterator<char>(ifs), {});
-            transcription += '\n';
+            std::cerr << "Metrics endpoint: " << error << std::endl;
+            return 1;
         }
+    }
+
+    PipelineCounters &pc = pipeline_counters();
+    std::deque<DaemonJob> queue;
+    bool input_done = false;
+    std::mutex m;
+    std::condition_variable cv;
+
+    /* Jobs for the same URL and range share a work directory (Checkpoint), and
+       the first to finish clears it – so at most one of them runs at a time */
+    std::set<std::string> active_keys;
+    std::condition_variable key_freed;
+
+    /* Textfile exporter: refreshed every few seconds and after each job, until
+       the runners are done; it has its own wakeup so none of theirs is lost */
+    std::thread exporter;
+    bool stopping = false;
+    std::condition_variable stop_cv;
+    if (!metrics_file.empty())
+        exporter = std::thread([&] {
+            std::unique_lock<std::mutex> lock(m);
+            while (!stop_cv.wait_for(lock, std::chrono::seconds(5), [&] { return stopping; }))
+            {
+                lock.unlock();
+                write_metrics_textfile(metrics_file);
+                lock.lock();
+            }
+        });
 
-        /* Clean-up per-chunk artefacts */
-        fs::remove(chunk);
-        fs::remove(wav);
-        fs::remove(txt);
+    std::vector<std::thread> pool;
+    for (std::size_t r = 0; r < runners; ++r)
+        pool.emplace_back([&] {
+            for (;;)
+            {
+                DaemonJob job;
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    cv.wait(lock, [&] { return input_done || !queue.empty(); });
+                    if (queue.empty())
+                        return;
+                    job = std::move(queue.front());
+                    queue.pop_front();
+                    pc.queue_depth.fetch_sub(1, std::memory_order_relaxed);
+                }
+                const std::string key = job_key(job.url, job.from_sec, job.to_sec);
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    key_freed.wait(lock, [&] { return active_keys.count(key) == 0; });
+                    active_keys.insert(key);
+                }
+                pc.jobs_in_flight.fetch_add(1, std::memory_order_relaxed);
+                const auto t0 = std::chrono::steady_clock::now();
+                std::string event = "{\"type\":\"job\",\"id\":" + json_string(job.id) + ",\"url\":" + json_string(job.url);
+                try
+                {
+                    const std::string tag = "job_" + std::to_string(job.seq);
+                    const JobResult r = transcribe_job(job.url, model_path, workers, job.from_sec, job.to_sec, tag.c_str());
+                    char nums[160];
+                    std::snprintf(nums, sizeof(nums), ",\"status\":\"done\",\"chunks\":%zu,\"gaps\":%zu,\"audio_sec\":%.3f,\"wall_sec\":%.3f",
+                                  r.chunks, r.gaps, r.audio_sec,
+                                  std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+                    event += nums;
+                    event += ",\"transcript\":" + json_string(r.script) + "}";
+                    pc.jobs_done.fetch_add(1, std::memory_order_relaxed);
+                }
+                catch (const JobError &e)
+                {
+                    event += ",\"status\":\"failed\",\"error\":" + json_string(e.what()) + "}";
+                    pc.jobs_failed.fetch_add(1, std::memory_order_relaxed);
+                }
+                pc.jobs_in_flight.fetch_sub(1, std::memory_order_relaxed);
+                {
+                    std::lock_guard<std::mutex> lock(m);
+                    active_keys.erase(key);
+                }
+                key_freed.notify_all();
+                emit(event);
+                if (!metrics_file.empty())
+                    write_metrics_textfile(metrics_file);
+            }
+        });
 
-        print_progress(++done, total);
+    std::size_t seq = 0;
+    for (std::string line; std::getline(std::cin, line);)
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+            continue;
+        DaemonJob job;
+        std::string error;
+        if (!parse_job_line(line, ++seq, job, error))
+        {
+            emit("{\"type\":\"job\",\"id\":" + json_string(job.id) + ",\"status\":\"failed\",\"error\":" +
+                 json_string(error + ": " + line) + "}");
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(m);
+        queue.push_back(std::move(job));
+        pc.queue_depth.fetch_add(1, std::memory_order_relaxed);
+        cv.notify_one();
     }
-    return transcription;
+    {
+        std::lock_guard<std::mutex> lock(m);
+        input_done = true;
+    }
+    cv.notify_all();
+    for (auto &t : pool)
+        t.join();
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    stop_cv.notify_all();
+    if (exporter.joinable())
+        exporter.join();
+    if (!metrics_file.empty())
+        write_metrics_textfile(metrics_file);
+    std::fclose(events);
+    return 0;
 }
 
 /*───────────────────────────────────────────────────────────────*/
-int main(int argc, char *argv[])
+static int run(int argc, char *argv[])
 {
-    if (argc < 3)
+    const auto started = std::chrono::steady_clock::now();
+    CliArgs args = parse_args(argc, argv,
+                              {"--no-watchdog", "--perf-counters", "--daemon", "--pack-speech", "--adaptive-ctx"});
+    if (!apply_host_profile(args))
+    {
+        std::cerr << "Could not read host profile " << args.get("--profile") << std::endl;
+        return 1;
+    }
+    whisper_options.merge_stderr = true;
+    whisper_options.watchdog = !args.has("--no-watchdog");
+    whisper_options.retries = static_cast<int>(args.num("--watchdog-retries", 1));
+    whisper_options.timeout_sec = args.num("--chunk-timeout", 0);
+    whisper_options.threads = static_cast<int>(args.num("--threads", 0));
+    whisper_options.pack_speech = args.has("--pack-speech");
+    whisper_options.adaptive_ctx = args.has("--adaptive-ctx");
+    std::string backend_error;
+    whisper_options.backend = make_inference_backend(args.get("--backend"), backend_error);
+    if (!whisper_options.backend)
+    {
+        std::cerr << backend_error << std::endl;
+        return 1;
+    }
+    if (args.has("--simd") && !simd_force(args.get("--simd"), backend_error))
+    {
+        std::cerr << backend_error << std::endl;
+        return 1;
+    }
+    PcmStorage pcm_storage = PcmStorage::S16;
+    if (args.has("--pcm-storage") && !parse_pcm_storage(args.get("--pcm-storage"), pcm_storage))
+    {
+        std::cerr << "Unknown --pcm-storage " << args.get("--pcm-storage") << " (s16 or f16)" << std::endl;
+        return 1;
+    }
+    pcm_pool().set_storage(pcm_storage);
+    chunk_len_sec = std::max(1, static_cast<int>(args.num("--chunk-len", 600)));
+    retry_policy.retries = static_cast<int>(args.num("--retries", 1));
+    retry_policy.fallback_model = args.get("--fallback-model");
+    progress_fd = static_cast<int>(args.num("--progress-fd", -1));
+    if (args.has("--perf-counters") && !perf_counters_enable())
+        std::cerr << "Hardware counters unavailable, continuing without them" << std::endl;
+    if (args.has("--daemon"))
+        return run_daemon(args);
+
+    double from_sec = 0.0, to_sec = -1.0;
+    if (args.positional.size() < 2 ||
+        (args.has("--from") && !parse_time(args.get("--from"), from_sec)) ||
+        (args.has("--to") && (!parse_time(args.get("--to"), to_sec) || to_sec <= from_sec)))
     {
         std::cerr << "Usage: " << argv[0]
-                  << " <YouTube URL> <path-to-whisper-model>" << std::endl;
+                  << " <YouTube URL> <path-to-whisper-model> [--workers N] [--threads N]"
+                     " [--chunk-len SEC] [--profile PATH]"
+                     " [--from HH:MM:SS] [--to HH:MM:SS]"
+                     " [--preview [BUDGET_SEC]] [--preview-window SEC]"
+                     " [--refine <path-to-full-model>]"
+                     " [--no-watchdog] [--watchdog-retries N]"
+                     " [--retries N] [--fallback-model PATH] [--chunk-timeout SEC]"
+                     " [--progress-fd FD] [--report PATH] [--perf-counters] [--backend whisper-cli|mock[:RTF[:LOAD]]]"
+                     " [--simd scalar|sse4|avx2|avx512|neon] [--pcm-storage s16|f16] [--pack-speech]"
+                     " [--adaptive-ctx]\n"
+                  << "       " << argv[0]
+                  << " --daemon <path-to-whisper-model> [--jobs N] [--workers N] [--threads N]"
+                     " [--metrics-port PORT] [--metrics-file PATH]" << std::endl;
         return 1;
     }
 
-    const std::string url = argv[1];
-    const std::string model_path = argv[2];
+    const std::string url = args.positional[0];
+    const std::string model_path = args.positional[1];
+    const auto workers = static_cast<std::size_t>(args.num("--workers", 1));
+
+    const auto write_report = [&](const char *mode, std::size_t n_chunks, double audio, std::size_t n_gaps) {
+        if (!args.has("--report"))
+            return;
+        RunReport report;
+        report.add("tool", "transcribe");
+        report.add("mode", mode);
+        report.add("source", url);
+        report.add("model", model_path);
+        report.add("workers", double(workers));
+        report.add("threads", double(whisper_options.threads));
+        report.add("backend", whisper_options.backend->name());
+        report.add("pack_speech", whisper_options.pack_speech ? "on" : "off");
+        report.add("adaptive_ctx", whisper_options.adaptive_ctx ? "on" : "off");
+        report.add("chunks", double(n_chunks));
+        report.add("audio_sec", audio);
+        report.add("gaps", double(n_gaps));
+        report.add("wall_sec", std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        report.raw("watchdog", watchdog_json());
+        if (!report.write(args.get("--report")))
+            std::cerr << "Could not write report to " << args.get("--report") << std::endl;
+    };
+
+    std::string script;
+    std::size_t gaps = 0, total_chunks = 0;
+    double total_audio = 0.0;
+    if (args.has("--preview") || args.has("--refine"))
+    {
+        /* --refine: stdout carries NDJSON only; yt-dlp, ffmpeg and our own chatter go to stderr */
+        FILE *events = nullptr;
+        if (args.has("--refine"))
+        {
+            events = fdopen(dup(STDOUT_FILENO), "w");
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+
+        const Checkpoint checkpoint(job_key(url, from_sec, to_sec));
+        const std::string work_dir = checkpoint.enabled() ? checkpoint.dir() : ".";
+        double origin_sec = 0.0;
+        const std::string audio_file = download_audio(url, from_sec, to_sec, origin_sec, work_dir);
+        /* Preview and refine runs leave chunks saved by an interrupted full run alone */
+        const auto discard_download = [&] {
+            std::error_code ec;
+            fs::remove(audio_file, ec);
+            fs::remove(fs::path(checkpoint.dir()) / "source.txt", ec);
+            fs::remove(checkpoint.dir(), ec); // only if nothing else is in it
+        };
 
-    const std::string audio_file = download_audio(url);
-    const auto chunks = split_audio(audio_file);
-    const auto script = transcribe_chunks(chunks, model_path);
+        if (args.has("--refine"))
+        {
+            const auto chunks = split_audio(audio_file, chunk_len_sec, from_sec - origin_sec,
+                                            to_sec > 0.0 ? to_sec - origin_sec : -1.0, origin_sec);
+            transcribe_refine(chunks, model_path, args.get("--refine"), work_dir, workers, events);
+            std::fclose(events);
+            discard_download();
+            write_report("refine", chunks.size(), audio_sec(chunks), 0);
+            if (whisper_options.watchdog)
+                print_watchdog_stats();
+            return 0;
+        }
 
-    fs::remove(audio_file);
+        /* The budget is wall time for the whole run, download included */
+        const double budget = std::max(1.0, args.num("--preview", 60));
+        const auto deadline = started + std::chrono::milliseconds(std::llround(budget * 1000));
+        const auto plan = plan_preview(audio_file, args.num("--preview-window", 20), work_dir, workers, origin_sec);
+        script = transcribe_preview(plan, model_path, work_dir, workers, deadline);
+        discard_download();
+        total_chunks = plan.windows.size();
+        total_audio = audio_sec(plan.windows);
+    }
+    else
+    {
+        const JobResult r = transcribe_job(url, model_path, workers, from_sec, to_sec);
+        script = r.script;
+        gaps = r.gaps;
+        total_chunks = r.chunks;
+        total_audio = r.audio_sec;
+        if (gaps)
+        {
+            /* Keep the audio and finished chunks: a rerun only redoes the gaps */
+            std::cerr << gaps << " of " << total_chunks << " chunk(s) failed and are marked as gaps; "
+                      << "run the same command again to retry just those (work kept in "
+                      << r.work_dir << ")." << std::endl;
+        }
+    }
+
+    if (whisper_options.watchdog)
+        print_watchdog_stats();
+    write_report(args.has("--preview") ? "preview" : "full", total_chunks, total_audio, gaps);
 
     std::cout << "\n----- Transcription Start -----\n"
               << script
               << "----- Transcription End -----" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const JobError &e)
+    {
+        std::cerr << '\n' << e.what() << std::endl;
+        return e.status;
+    }
+}
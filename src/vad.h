@@ -0,0 +1,118 @@
+/*
+vad.h – energy-based voice activity estimate for 16 kHz mono PCM
+
+Introduction
+============
+Cheap enough to run over many candidate windows before any of them is sent to
+whisper: the signal is cut into 30 ms frames and each frame's energy is
+compared with a threshold derived from the noise floor of the material itself.
+
+    ```cpp
+    #include "vad.h"
+
+    std::vector<float> db;
+    vad_frame_energy_db(pcm.data(), pcm.size(), db);
+    const float thr = vad_threshold_db(db);
+    const float density = vad_speech_density(db, thr);   // 0 … 1
+    const auto spans = vad_speech_spans(db, thr);        // [{start_sec, end_sec}, …]
+    ```
+
+Thresholds computed over several windows at once make their densities
+comparable; a per-window threshold only says how busy a window is relative to
+its own quiet parts.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "simd.h"
+
+struct VadParams
+{
+    std::size_t frame = 480;      // samples per frame (30 ms at 16 kHz)
+    float floor_percentile = 0.1f; // quietest share of frames taken as noise
+    float margin_db = 12.0f;       // speech must be this far above the floor
+    float min_db = -55.0f;         // … and never below this (dBFS)
+    std::size_t hangover = 8;      // frames kept active after speech ends
+    std::size_t lead_in = 5;       // frames kept before speech starts (spans only)
+};
+
+struct SpeechSpan
+{
+    double start_sec = 0.0, end_sec = 0.0;
+};
+
+/* Mean-square energy of each full frame, in dBFS. */
+inline void vad_frame_energy_db(const float *pcm, std::size_t count, std::vector<float> &db,
+                                const VadParams &p = VadParams())
+{
+    db.clear();
+    db.reserve(count / p.frame);
+    const SimdKernels &k = simd();
+    for (std::size_t at = 0; at + p.frame <= count; at += p.frame)
+        db.push_back(10.0f * std::log10(k.sum_squares(pcm + at, p.frame) / float(p.frame) + 1e-10f));
+}
+
+inline float vad_threshold_db(const std::vector<float> &db, const VadParams &p = VadParams())
+{
+    if (db.empty())
+        return p.min_db;
+    std::vector<float> sorted(db);
+    const auto k = std::size_t(p.floor_percentile * float(sorted.size() - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + std::ptrdiff_t(k), sorted.end());
+    return std::max(sorted[k] + p.margin_db, p.min_db);
+}
+
+/* Share of frames classified as speech, hangover included. */
+inline float vad_speech_density(const std::vector<float> &db, float threshold_db,
+                                const VadParams &p = VadParams())
+{
+    if (db.empty())
+        return 0.0f;
+    std::size_t active = 0, hold = 0;
+    for (float e : db)
+    {
+        if (e >= threshold_db)
+            hold = p.hangover + 1;
+        if (hold)
+        {
+            ++active;
+            --hold;
+        }
+    }
+    return float(active) / float(db.size());
+}
+
+/* Runs of speech frames, hangover and lead-in included, in seconds from the
+   start of the frames; runs that touch once padded are merged. */
+inline std::vector<SpeechSpan> vad_speech_spans(const std::vector<float> &db, float threshold_db,
+                                                const VadParams &p = VadParams(), double sample_rate = 16000.0)
+{
+    std::vector<SpeechSpan> spans;
+    const double frame_sec = double(p.frame) / sample_rate;
+    std::size_t hold = 0, begin = 0;
+    bool active = false;
+    for (std::size_t i = 0; i <= db.size(); ++i)
+    {
+        if (i < db.size() && db[i] >= threshold_db)
+            hold = p.hangover + 1;
+        const bool on = i < db.size() && hold > 0;
+        if (hold)
+            --hold;
+        if (on && !active)
+            begin = i >= p.lead_in ? i - p.lead_in : 0;
+        else if (!on && active)
+        {
+            if (!spans.empty() && double(begin) * frame_sec <= spans.back().end_sec)
+                spans.back().end_sec = double(i) * frame_sec;
+            else
+                spans.push_back({double(begin) * frame_sec, double(i) * frame_sec});
+        }
+        active = on;
+    }
+    return spans;
+}
@@ -0,0 +1,217 @@
+/*
+watchdog.h – repetition-loop / hallucination detector for streamed segments
+
+Introduction
+============
+Whisper can lock onto one phrase through silence or music and keep emitting
+it until the end of the window – or the end of the chunk. The watchdog sees
+each segment as whisper-cli prints it and says when decoding should be cut
+off:
+
+    ```cpp
+    #include "watchdog.h"
+
+    RepetitionWatchdog dog;
+    while (read_segment(seg))
+        if (dog.feed(seg))
+        {
+            kill_decoder();
+            // [dog.loop_start(), dog.loop_end()) is the runaway span
+            break;
+        }
+    ```
+
+Three signals, any of which trips it:
+
+  * the same text repeated in consecutive segments,
+  * word n-gram repetition over a sliding window of recent words,
+  * compression ratio of the recent text – the signal whisper itself uses
+    for temperature fallback (gzip ratio > 2.4). A greedy LZ77 pass stands
+    in for zlib so no library is needed.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct WatchdogParams
+{
+    std::size_t max_identical = 3;    // consecutive segments with the same text
+    std::size_t ngram = 3;            // words per n-gram
+    std::size_t window_words = 48;    // words considered for n-gram repetition
+    std::size_t min_words = 24;       // … once at least this many are in
+    double max_repeat_ratio = 0.5;    // repeated share of n-grams in the window
+    std::size_t min_chars = 200;      // compression ratio needs this much text
+    double max_compression = 2.4;
+};
+
+/* How often the watchdog fired over a run (all chunks, all workers). */
+struct WatchdogStats
+{
+    std::atomic<std::size_t> fired{0};     // decodes cut off
+    std::atomic<std::size_t> retried{0};   // re-decodes with other parameters
+    std::atomic<std::size_t> recovered{0}; // … that then ran clean
+    std::atomic<std::size_t> skipped{0};   // spans given up on and marked
+    std::atomic<std::int64_t> skipped_ms{0};
+};
+
+inline WatchdogStats &watchdog_stats()
+{
+    static WatchdogStats stats;
+    return stats;
+}
+
+/* Estimated compressed-size ratio of `text` (greedy LZ77, deflate-like costs). */
+inline double lz_compression_ratio(const std::string &text)
+{
+    constexpr std::size_t kMinMatch = 4, kMaxMatch = 258;
+    if (text.size() < kMinMatch)
+        return 1.0;
+
+    std::unordered_map<std::uint32_t, std::size_t> last; // 4-byte prefix → latest position
+    const auto key = [&](std::size_t i) {
+        return std::uint32_t(std::uint8_t(text[i])) | std::uint32_t(std::uint8_t(text[i + 1])) << 8 |
+               std::uint32_t(std::uint8_t(text[i + 2])) << 16 | std::uint32_t(std::uint8_t(text[i + 3])) << 24;
+    };
+
+    std::size_t cost = 0, i = 0;
+    while (i < text.size())
+    {
+        std::size_t len = 0;
+        if (i + kMinMatch <= text.size())
+        {
+            const auto it = last.find(key(i));
+            if (it != last.end())
+                while (i + len < text.size() && len < kMaxMatch && text[it->second + len] == text[i + len])
+                    ++len;
+            last[key(i)] = i;
+        }
+        if (len >= kMinMatch)
+        {
+            for (std::size_t k = i + 1; k < i + len && k + kMinMatch <= text.size(); ++k)
+                last[key(k)] = k;
+            cost += 3; // length + distance codes
+            i += len;
+        }
+        else
+        {
+            cost += 1;
+            ++i;
+        }
+    }
+    return double(text.size()) / double(cost);
+}
+
+class RepetitionWatchdog
+{
+public:
+    explicit RepetitionWatchdog(const WatchdogParams &p = WatchdogParams()) : p_(p) {}
+
+    /* Feed the next segment; true once decoding should be cut off. */
+    template <typename SegmentT>
+    bool feed(const SegmentT &seg)
+    {
+        return feed(seg.t0, seg.t1, seg.text);
+    }
+
+    bool feed(double t0, double t1, const std::string &text)
+    {
+        const std::string norm = normalise(text);
+        if (norm.empty())
+            return false;
+        segs_.push_back({t0, t1, norm});
+        loop_end_ = t1;
+
+        /* 1. Identical consecutive segments */
+        run_ = (segs_.size() > 1 && segs_[segs_.size() - 2].text == norm) ? run_ + 1 : 1;
+        if (run_ >= p_.max_identical)
+            return trip(segs_.size() - run_, "identical segments");
+
+        /* 2. Word n-grams over the recent window */
+        for (std::size_t at = 0, end; at < norm.size(); at = end + 1)
+        {
+            end = std::min(norm.find(' ', at), norm.size());
+            words_.push_back({norm.substr(at, end - at), segs_.size() - 1});
+        }
+        while (words_.size() > p_.window_words)
+            words_.pop_front();
+        if (words_.size() >= p_.min_words && words_.size() >= p_.ngram)
+        {
+            std::map<std::string, std::size_t> first_seen;
+            std::size_t total = 0, repeats = 0, loop_seg = segs_.size() - 1;
+            for (std::size_t i = 0; i + p_.ngram <= words_.size(); ++i)
+            {
+                std::string gram;
+                for (std::size_t k = 0; k < p_.ngram; ++k)
+                    gram += words_[i + k].first + ' ';
+                ++total;
+                const auto ins = first_seen.emplace(gram, words_[i].second);
+                if (!ins.second)
+                {
+                    ++repeats;
+                    loop_seg = std::min(loop_seg, ins.first->second);
+                }
+            }
+            if (double(repeats) > p_.max_repeat_ratio * double(total))
+                return trip(loop_seg, "n-gram repetition");
+        }
+
+        /* 3. Compression ratio of the text behind the same window */
+        const std::size_t from = words_.front().second;
+        std::string recent;
+        for (std::size_t i = from; i < segs_.size(); ++i)
+            recent += segs_[i].text + ' ';
+        if (recent.size() >= p_.min_chars && lz_compression_ratio(recent) > p_.max_compression)
+            return trip(from, "compression ratio");
+        return false;
+    }
+
+    double loop_start() const { return loop_start_; } // first segment of the runaway span
+    double loop_end() const { return loop_end_; }     // end of the last segment seen
+    const char *reason() const { return reason_; }
+
+private:
+    struct Seg
+    {
+        double t0, t1;
+        std::string text;
+    };
+
+    static std::string normalise(const std::string &text)
+    {
+        std::string out;
+        for (unsigned char c : text)
+        {
+            if (std::isalnum(c) || c >= 0x80)
+                out += char(std::tolower(c));
+            else if (!out.empty() && out.back() != ' ')
+                out += ' ';
+        }
+        while (!out.empty() && out.back() == ' ')
+            out.pop_back();
+        return out;
+    }
+
+    bool trip(std::size_t seg, const char *why)
+    {
+        loop_start_ = segs_[seg].t0;
+        reason_ = why;
+        return true;
+    }
+
+    WatchdogParams p_;
+    std::vector<Seg> segs_;
+    std::deque<std::pair<std::string, std::size_t>> words_; // word, segment index
+    std::size_t run_ = 0;
+    double loop_start_ = 0.0, loop_end_ = 0.0;
+    const char *reason_ = "";
+};
@@ -0,0 +1,738 @@
+/*
+webm_opus.h – in-process WebM/Matroska demux + Opus decode (→ 16 kHz mono float)
+
+Introduction
+============
+Single header, no build flags. YouTube's smallest audio format is Opus in a WebM
+container; this header reads that file directly, without ffmpeg:
+
+- The EBML/Matroska container is demuxed natively: Info, Tracks, Clusters,
+  SimpleBlock and BlockGroup/Block with Xiph, EBML and fixed lacing, including
+  unknown-size (live) Segments and Clusters.
+- Opus packets are decoded by the system libopus, loaded at runtime with
+  dlopen(). The decoder is created at 16 kHz with one channel, so libopus
+  emits 16 kHz mono directly – no resampler.
+
+    ```cpp
+    #include "webm_opus.h"
+
+    WebmOpusDecoder dec;                     // 16 kHz mono output by default
+    std::vector<float> pcm;
+    if (dec.open("audio.webm"))
+        while (dec.decode_packet(pcm)) {}    // appends to pcm
+    ```
+
+Pre-skip and output gain from the OpusHead are applied. Timestamp gaps between
+blocks are filled with silence, and a packet libopus rejects is concealed
+(packet loss concealment) for its own duration, so sample positions stay
+aligned with the container timeline; had_errors() reports the concealment. Only single-stream layouts are supported (mapping family 0,
+or family 1 with a stream count of 1); `open()` fails on multistream surround
+and the caller falls back to ffmpeg.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+
+/*───────────────────────────────────────────────────────────────
+  EBML primitives
+──────────────────────────────────────────────────────────────*/
+namespace ebml
+{
+constexpr std::uint32_t kEbml = 0x1A45DFA3;
+constexpr std::uint32_t kSegment = 0x18538067;
+constexpr std::uint32_t kSeekHead = 0x114D9B74;
+constexpr std::uint32_t kInfo = 0x1549A966;
+constexpr std::uint32_t kTimecodeScale = 0x2AD7B1;
+constexpr std::uint32_t kDuration = 0x4489;
+constexpr std::uint32_t kTracks = 0x1654AE6B;
+constexpr std::uint32_t kTrackEntry = 0xAE;
+constexpr std::uint32_t kTrackNumber = 0xD7;
+constexpr std::uint32_t kTrackType = 0x83;
+constexpr std::uint32_t kCodecId = 0x86;
+constexpr std::uint32_t kCodecPrivate = 0x63A2;
+constexpr std::uint32_t kAudio = 0xE1;
+constexpr std::uint32_t kSamplingFrequency = 0xB5;
+constexpr std::uint32_t kChannels = 0x9F;
+constexpr std::uint32_t kCluster = 0x1F43B675;
+constexpr std::uint32_t kTimecode = 0xE7;
+constexpr std::uint32_t kSimpleBlock = 0xA3;
+constexpr std::uint32_t kBlockGroup = 0xA0;
+constexpr std::uint32_t kBlock = 0xA1;
+constexpr std::uint32_t kCues = 0x1C53BB6B;
+constexpr std::uint32_t kTags = 0x1254C367;
+constexpr std::uint32_t kChapters = 0x1043A770;
+constexpr std::uint32_t kAttachments = 0x1941A469;
+
+constexpr std::uint64_t kUnknownSize = ~std::uint64_t(0);
+
+inline bool is_top_level(std::uint32_t id)
+{
+    return id == kCluster || id == kCues || id == kTags || id == kChapters ||
+           id == kAttachments || id == kSeekHead || id == kInfo || id == kTracks;
+}
+
+/* Decode a variable-length integer from memory; returns its length (0 on error). */
+inline int read_vint(const std::uint8_t *p, std::size_t n, std::uint64_t &value, bool keep_marker)
+{
+    if (n == 0 || p[0] == 0)
+        return 0;
+    int len = 1;
+    while (!(p[0] & (0x80 >> (len - 1))))
+        ++len;
+    if (std::size_t(len) > n)
+        return 0;
+
+    std::uint64_t v = keep_marker ? p[0] : (p[0] & (0xFF >> len));
+    bool all_ones = (v == std::uint64_t(0xFF >> len));
+    for (int i = 1; i < len; ++i)
+    {
+        v = (v << 8) | p[i];
+        all_ones = all_ones && p[i] == 0xFF;
+    }
+    value = (!keep_marker && all_ones) ? kUnknownSize : v;
+    return len;
+}
+
+class Reader
+{
+public:
+    bool open(const std::string &path)
+    {
+        in_.open(path, std::ios::binary | std::ios::ate);
+        if (!in_)
+            return false;
+        size_ = std::uint64_t(in_.tellg());
+        in_.seekg(0);
+        return true;
+    }
+
+    std::uint64_t size() const { return size_; }
+    std::uint64_t tell() { return std::uint64_t(in_.tellg()); }
+    void seek(std::uint64_t pos) { in_.clear(), in_.seekg(std::streamoff(pos)); }
+
+    bool read(void *dst, std::size_t n)
+    {
+        in_.read(static_cast<char *>(dst), std::streamsize(n));
+        return std::size_t(in_.gcount()) == n;
+    }
+
+    bool read_vint(std::uint64_t &v, bool keep_marker)
+    {
+        std::uint8_t b[8];
+        if (!read(b, 1) || b[0] == 0)
+            return false;
+        int len = 1;
+        while (!(b[0] & (0x80 >> (len - 1))))
+            ++len;
+        if (len > 1 && !read(b + 1, std::size_t(len - 1)))
+            return false;
+        return ebml::read_vint(b, std::size_t(len), v, keep_marker) == len;
+    }
+
+    /* Element header: ID (marker kept) and payload size. */
+    bool element(std::uint32_t &id, std::uint64_t &size)
+    {
+        std::uint64_t raw = 0;
+        if (!read_vint(raw, true) || !read_vint(size, false))
+            return false;
+        id = std::uint32_t(raw);
+        return true;
+    }
+
+    std::uint64_t read_uint(std::uint64_t size)
+    {
+        std::uint8_t b[8] = {};
+        const std::size_t n = std::size_t(std::min<std::uint64_t>(size, 8));
+        read(b, n);
+        std::uint64_t v = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            v = (v << 8) | b[i];
+        return v;
+    }
+
+    double read_float(std::uint64_t size)
+    {
+        const std::uint64_t bits = read_uint(size);
+        if (size == 4)
+        {
+            std::uint32_t b32 = std::uint32_t(bits);
+            float f;
+            std::memcpy(&f, &b32, 4);
+            return f;
+        }
+        double d;
+        std::memcpy(&d, &bits, 8);
+        return d;
+    }
+
+    std::string read_string(std::uint64_t size)
+    {
+        std::string s(std::size_t(size), '\0');
+        read(&s[0], s.size());
+        return s.substr(0, s.find('\0'));
+    }
+
+private:
+    std::ifstream in_;
+    std::uint64_t size_ = 0;
+};
+} // namespace ebml
+
+/*───────────────────────────────────────────────────────────────
+  WebmDemuxer – first audio track, packet by packet
+──────────────────────────────────────────────────────────────*/
+struct WebmTrack
+{
+    std::uint64_t number = 0;
+    std::string codec;
+    std::vector<std::uint8_t> codec_private;
+    int channels = 0;
+    double sample_rate = 0.0;
+};
+
+struct WebmCluster
+{
+    std::uint64_t offset = 0; // file offset of the Cluster element header
+    std::int64_t pts_ns = 0;
+};
+
+struct WebmPacket
+{
+    std::vector<std::uint8_t> data; // reused across calls
+    std::int64_t pts_ns = 0;
+};
+
+class WebmDemuxer
+{
+public:
+    bool open(const std::string &path)
+    {
+        *this = WebmDemuxer();
+        if (!r_.open(path))
+            return false;
+
+        std::uint32_t id;
+        std::uint64_t size;
+        if (!r_.element(id, size) || id != ebml::kEbml || size == ebml::kUnknownSize)
+            return false;
+        r_.seek(r_.tell() + size);
+
+        if (!r_.element(id, size) || id != ebml::kSegment)
+            return false;
+        segment_end_ = size == ebml::kUnknownSize ? r_.size() : std::min(r_.size(), r_.tell() + size);
+
+        /* Read headers up to the first Cluster. */
+        for (std::uint64_t at = r_.tell(); at < segment_end_ && r_.element(id, size); at = r_.tell())
+        {
+            const std::uint64_t start = r_.tell();
+            if (id == ebml::kCluster)
+            {
+                first_cluster_ = at;
+                stop_ = segment_end_;
+                enter_cluster(start, size);
+                return track_.number != 0;
+            }
+            if (size == ebml::kUnknownSize)
+                return false;
+            if (id == ebml::kInfo)
+                parse_info(start + size);
+            else if (id == ebml::kTracks)
+                parse_tracks(start + size);
+            r_.seek(start + size);
+        }
+        return false;
+    }
+
+    const WebmTrack &track() const { return track_; }
+    double duration_sec() const { return duration_ * double(timecode_scale_) / 1e9; }
+    std::uint64_t first_cluster() const { return first_cluster_; }
+
+    /* One pass over the Segment collecting every Cluster's offset and
+       timestamp. Leaves the demuxer positioned at the first Cluster. */
+    bool index_clusters(std::vector<WebmCluster> &out)
+    {
+        out.clear();
+        std::uint64_t pos = first_cluster_;
+        std::uint32_t id;
+        std::uint64_t size;
+        while (pos < segment_end_)
+        {
+            r_.seek(pos);
+            if (!r_.element(id, size))
+                break;
+            const std::uint64_t start = r_.tell();
+            if (id != ebml::kCluster)
+            {
+                if (size == ebml::kUnknownSize)
+                    break;
+                pos = start + size;
+                continue;
+            }
+
+            WebmCluster c;
+            c.offset = pos;
+            const std::uint64_t end = size == ebml::kUnknownSize ? segment_end_ : start + size;
+            pos = end;
+            std::uint32_t cid;
+            std::uint64_t csize;
+            while (r_.tell() < end)
+            {
+                const std::uint64_t cpos = r_.tell();
+                if (!r_.element(cid, csize))
+                    break;
+                if (ebml::is_top_level(cid))
+                {
+                    pos = cpos; // unknown-size cluster ends at the next top-level element
+                    break;
+                }
+                if (cid == ebml::kTimecode)
+                {
+                    c.pts_ns = std::int64_t(r_.read_uint(csize) * timecode_scale_);
+                    if (size != ebml::kUnknownSize)
+                        break;
+                    continue;
+                }
+                if (csize == ebml::kUnknownSize)
+                    break;
+                r_.seek(r_.tell() + csize);
+            }
+            out.push_back(c);
+        }
+        seek(first_cluster_);
+        return !out.empty();
+    }
+
+    /* Restrict reading to the Clusters in [begin, end). */
+    void seek(std::uint64_t begin, std::uint64_t end = ~std::uint64_t(0))
+    {
+        r_.seek(begin);
+        stop_ = std::min(end, segment_end_);
+        cluster_end_ = 0;
+        lace_sizes_.clear();
+        lace_index_ = 0;
+    }
+
+    /* Next frame of the selected track; false at end of stream. */
+    bool next_packet(WebmPacket &pkt)
+    {
+        for (;;)
+        {
+            if (lace_index_ < lace_sizes_.size())
+            {
+                const std::size_t n = lace_sizes_[lace_index_++];
+                pkt.data.assign(block_.begin() + std::ptrdiff_t(lace_off_),
+                                block_.begin() + std::ptrdiff_t(lace_off_ + n));
+                pkt.pts_ns = block_pts_ns_;
+                lace_off_ += n;
+                return true;
+            }
+            if (!next_block())
+                return false;
+        }
+    }
+
+private:
+    void parse_info(std::uint64_t end)
+    {
+        std::uint32_t id;
+        std::uint64_t size;
+        while (r_.tell() < end && r_.element(id, size))
+        {
+            const std::uint64_t start = r_.tell();
+            if (id == ebml::kTimecodeScale)
+                timecode_scale_ = r_.read_uint(size);
+            else if (id == ebml::kDuration)
+                duration_ = r_.read_float(size);
+            r_.seek(start + size);
+        }
+    }
+
+    void parse_tracks(std::uint64_t end)
+    {
+        std::uint32_t id;
+        std::uint64_t size;
+        while (r_.tell() < end && r_.element(id, size))
+        {
+            const std::uint64_t start = r_.tell();
+            if (id == ebml::kTrackEntry && track_.number == 0)
+            {
+                WebmTrack t;
+                std::uint64_t type = 0;
+                std::uint32_t cid;
+                std::uint64_t csize;
+                while (r_.tell() < start + size && r_.element(cid, csize))
+                {
+                    const std::uint64_t cstart = r_.tell();
+                    if (cid == ebml::kTrackNumber)
+                        t.number = r_.read_uint(csize);
+                    else if (cid == ebml::kTrackType)
+                        type = r_.read_uint(csize);
+                    else if (cid == ebml::kCodecId)
+                        t.codec = r_.read_string(csize);
+                    else if (cid == ebml::kCodecPrivate)
+                    {
+                        t.codec_private.resize(std::size_t(csize));
+                        r_.read(t.codec_private.data(), t.codec_private.size());
+                    }
+                    else if (cid == ebml::kAudio)
+                        continue; // descend: its children follow inline
+                    else if (cid == ebml::kSamplingFrequency)
+                        t.sample_rate = r_.read_float(csize);
+                    else if (cid == ebml::kChannels)
+                        t.channels = int(r_.read_uint(csize));
+                    r_.seek(cstart + csize);
+                }
+                if (type == 2)
+                    track_ = t;
+            }
+            r_.seek(start + size);
+        }
+    }
+
+    void enter_cluster(std::uint64_t start, std::uint64_t size)
+    {
+        cluster_end_ = size == ebml::kUnknownSize ? segment_end_ : std::min(segment_end_, start + size);
+        cluster_tc_ = 0;
+    }
+
+    /* Advance to the next Block of our track and split its lacing. */
+    bool next_block()
+    {
+        std::uint32_t id;
+        std::uint64_t size;
+        for (;;)
+        {
+            const std::uint64_t pos = r_.tell();
+            if (pos >= stop_ || !r_.element(id, size))
+                return false;
+            const std::uint64_t start = r_.tell();
+
+            if (id == ebml::kCluster)
+            {
+                enter_cluster(start, size);
+                continue;
+            }
+            if (pos >= cluster_end_ || ebml::is_top_level(id))
+            {
+                /* Between clusters: skip Cues, Tags, … */
+                if (size == ebml::kUnknownSize)
+                    return false;
+                cluster_end_ = 0;
+                r_.seek(start + size);
+                continue;
+            }
+
+            if (id == ebml::kTimecode)
+                cluster_tc_ = r_.read_uint(size);
+            else if (id == ebml::kBlockGroup)
+                continue; // descend: the Block follows inline
+            else if ((id == ebml::kSimpleBlock || id == ebml::kBlock) && size != ebml::kUnknownSize)
+            {
+                block_.resize(std::size_t(size));
+                if (!r_.read(block_.data(), block_.size()))
+                    return false;
+                if (parse_block())
+                    return true;
+                continue;
+            }
+            if (size == ebml::kUnknownSize)
+                return false;
+            r_.seek(start + size);
+        }
+    }
+
+    bool parse_block()
+    {
+        const std::uint8_t *p = block_.data();
+        const std::size_t n = block_.size();
+        std::uint64_t track = 0;
+        const int tl = ebml::read_vint(p, n, track, false);
+        if (tl == 0 || std::size_t(tl) + 3 > n || track != track_.number)
+            return false;
+
+        const std::int16_t rel = std::int16_t((p[tl] << 8) | p[tl + 1]);
+        const std::uint8_t flags = p[tl + 2];
+        block_pts_ns_ = (std::int64_t(cluster_tc_) + rel) * std::int64_t(timecode_scale_);
+
+        std::size_t off = std::size_t(tl) + 3;
+        lace_sizes_.clear();
+        lace_index_ = 0;
+
+        const int lacing = (flags >> 1) & 3;
+        if (lacing == 0)
+        {
+            lace_sizes_.push_back(n - off);
+            lace_off_ = off;
+            return true;
+        }
+
+        if (off >= n)
+            return false;
+        const std::size_t frames = std::size_t(p[off++]) + 1;
+        std::size_t used = 0;
+        if (lacing == 1) // Xiph
+        {
+            for (std::size_t i = 0; i + 1 < frames; ++i)
+            {
+                std::size_t sz = 0;
+                while (off < n && p[off] == 0xFF)
+                    sz += p[off++];
+                if (off >= n)
+                    return false;
+                sz += p[off++];
+                lace_sizes_.push_back(sz);
+                used += sz;
+            }
+        }
+        else if (lacing == 3) // EBML
+        {
+            std::uint64_t first = 0;
+            int l = ebml::read_vint(p + off, n - off, first, false);
+            if (l == 0)
+                return false;
+            off += std::size_t(l);
+            std::int64_t sz = std::int64_t(first);
+            lace_sizes_.push_back(std::size_t(sz));
+            used = std::size_t(sz);
+            for (std::size_t i = 1; i + 1 < frames; ++i)
+            {
+                std::uint64_t raw = 0;
+                l = ebml::read_vint(p + off, n - off, raw, false);
+                if (l == 0)
+                    return false;
+                off += std::size_t(l);
+                const std::int64_t bias = (std::int64_t(1) << (7 * l - 1)) - 1;
+                sz += std::int64_t(raw) - bias;
+                if (sz < 0)
+                    return false;
+                lace_sizes_.push_back(std::size_t(sz));
+                used += std::size_t(sz);
+            }
+        }
+        else // fixed
+        {
+            const std::size_t each = (n - off) / frames;
+            lace_sizes_.assign(frames - 1, each);
+            used = each * (frames - 1);
+        }
+
+        if (off + used > n)
+            return false;
+        lace_sizes_.push_back(n - off - used);
+        lace_off_ = off;
+        return true;
+    }
+
+    ebml::Reader r_;
+    WebmTrack track_;
+    std::uint64_t timecode_scale_ = 1000000;
+    double duration_ = 0.0;
+    std::uint64_t segment_end_ = 0, cluster_end_ = 0, cluster_tc_ = 0;
+    std::uint64_t first_cluster_ = 0, stop_ = 0;
+
+    std::vector<std::uint8_t> block_;
+    std::vector<std::size_t> lace_sizes_;
+    std::size_t lace_index_ = 0, lace_off_ = 0;
+    std::int64_t block_pts_ns_ = 0;
+};
+
+/*───────────────────────────────────────────────────────────────
+  libopus – resolved at runtime
+──────────────────────────────────────────────────────────────*/
+struct OpusApi
+{
+    using decoder = void;
+    decoder *(*create)(std::int32_t, int, int *) = nullptr;
+    void (*destroy)(decoder *) = nullptr;
+    int (*decode_float)(decoder *, const unsigned char *, std::int32_t, float *, int, int) = nullptr;
+    int (*packet_samples)(const unsigned char *, std::int32_t, std::int32_t) = nullptr; // optional
+    bool ok = false;
+
+    static const OpusApi &get()
+    {
+        static const OpusApi api = load();
+        return api;
+    }
+
+private:
+    static OpusApi load()
+    {
+        OpusApi a;
+        static const char *const names[] = {
+            "libopus.so.0", "libopus.so", "libopus.0.dylib", "libopus.dylib",
+            "/opt/homebrew/lib/libopus.dylib", "/usr/local/lib/libopus.dylib"};
+        void *lib = nullptr;
+        for (const char *n : names)
+            if ((lib = dlopen(n, RTLD_NOW | RTLD_LOCAL)))
+                break;
+        if (!lib)
+            return a;
+
+        a.create = reinterpret_cast<decltype(a.create)>(dlsym(lib, "opus_decoder_create"));
+        a.destroy = reinterpret_cast<decltype(a.destroy)>(dlsym(lib, "opus_decoder_destroy"));
+        a.decode_float = reinterpret_cast<decltype(a.decode_float)>(dlsym(lib, "opus_decode_float"));
+        a.packet_samples = reinterpret_cast<decltype(a.packet_samples)>(dlsym(lib, "opus_packet_get_nb_samples"));
+        a.ok = a.create && a.destroy && a.decode_float;
+        return a;
+    }
+};
+
+/*───────────────────────────────────────────────────────────────
+  WebmOpusDecoder – demux + decode, packet by packet
+──────────────────────────────────────────────────────────────*/
+class WebmOpusDecoder
+{
+public:
+    /* Opus decodes natively at 8, 12, 16, 24 or 48 kHz. */
+    explicit WebmOpusDecoder(int out_rate = 16000) : out_rate_(out_rate) {}
+    ~WebmOpusDecoder() { close(); }
+
+    WebmOpusDecoder(const WebmOpusDecoder &) = delete;
+    WebmOpusDecoder &operator=(const WebmOpusDecoder &) = delete;
+
+    static bool available() { return OpusApi::get().ok; }
+
+    /* Open `path`, optionally restricted to the Clusters in [begin, end) as
+       listed by WebmDemuxer::index_clusters(). Decoding from a mid-stream
+       Cluster starts cold; callers pre-roll one Cluster and drop its output. */
+    bool open(const std::string &path, std::uint64_t begin = 0, std::uint64_t end = ~std::uint64_t(0))
+    {
+        close();
+        const auto &api = OpusApi::get();
+        if (!api.ok || !demux_.open(path))
+            return false;
+        const bool from_start = begin <= demux_.first_cluster();
+        if (!from_start || end != ~std::uint64_t(0))
+            demux_.seek(std::max(begin, demux_.first_cluster()), end);
+
+        const WebmTrack &t = demux_.track();
+        const auto &head = t.codec_private;
+        if (t.codec != "A_OPUS" || head.size() < 19 || std::memcmp(head.data(), "OpusHead", 8) != 0)
+            return false;
+        // A plain opus_decoder handles exactly one (possibly coupled) stream:
+        // mapping family 0, or family 1 when its table lists a single stream.
+        // Surround layouts go to the ffmpeg fallback.
+        const int family = head[18];
+        if (family != 0 && !(family == 1 && head.size() >= 21u + head[9] && head[19] == 1))
+            return false;
+
+        const int pre_skip = head[10] | (head[11] << 8);
+        const std::int16_t gain_q8 = std::int16_t(head[16] | (head[17] << 8));
+        gain_ = float(std::pow(10.0, gain_q8 / (20.0 * 256.0)));
+        skip_ = from_start ? std::int64_t(pre_skip) * out_rate_ / 48000 : 0;
+
+        int err = 0;
+        dec_ = api.create(out_rate_, 1, &err);
+        if (!dec_ || err != 0)
+            return false;
+
+        emitted_ = skip_consumed_ = 0;
+        first_pts_ns_ = -1;
+        last_frame_ = out_rate_ / 50;
+        failed_ = false;
+        return true;
+    }
+
+    void close()
+    {
+        if (dec_)
+            OpusApi::get().destroy(dec_);
+        dec_ = nullptr;
+    }
+
+    /* Decode one packet and append its mono samples to `out`.
+       Returns false at end of stream. */
+    bool decode_packet(std::vector<float> &out)
+    {
+        if (!dec_ || !demux_.next_packet(pkt_))
+            return false;
+
+        /* Keep the sample clock on the container timeline across gaps. */
+        if (first_pts_ns_ < 0)
+            first_pts_ns_ = pkt_.pts_ns;
+        const std::int64_t expected = emitted_ + skip_consumed_;
+        const std::int64_t at = (pkt_.pts_ns - first_pts_ns_) * out_rate_ / 1000000000;
+        if (at > expected + out_rate_ / 25) // > 40 ms hole
+        {
+            const std::int64_t gap = at - expected;
+            out.insert(out.end(), std::size_t(gap), 0.0f);
+            emitted_ += gap;
+        }
+
+        const auto &api = OpusApi::get();
+        const auto *data = pkt_.data.data();
+        const auto bytes = std::int32_t(pkt_.data.size());
+        int n = api.decode_float(dec_, data, bytes, pcm_, kMaxFrame, 0);
+        if (n < 0)
+        {
+            /* A packet that does not decode still covers its span of the
+               timeline: have libopus conceal it (PLC) for the duration its
+               TOC byte claims – or the previous packet's – so later audio
+               does not drift earlier by a frame per lost packet. */
+            failed_ = true;
+            const int claimed = api.packet_samples && bytes > 0 ? api.packet_samples(data, bytes, out_rate_) : -1;
+            const int frame = claimed > 0 && claimed <= kMaxFrame ? claimed : last_frame_;
+            n = api.decode_float(dec_, nullptr, 0, pcm_, frame, 0);
+            if (n < 0)
+            {
+                n = frame;
+                std::fill(pcm_, pcm_ + n, 0.0f);
+            }
+        }
+        else
+            last_frame_ = std::max(1, n);
+
+        int first = 0;
+        if (skip_ > 0)
+        {
+            first = int(std::min<std::int64_t>(skip_, n));
+            skip_ -= first;
+            skip_consumed_ += first;
+        }
+        for (int i = first; i < n; ++i)
+            out.push_back(pcm_[i] * gain_);
+        emitted_ += n - first;
+        return true;
+    }
+
+    double duration_sec() const { return demux_.duration_sec(); }
+    /* True once a packet failed to decode and was concealed. */
+    bool had_errors() const { return failed_; }
+
+private:
+    static constexpr int kMaxFrame = 5760; // 120 ms at 48 kHz
+
+    int out_rate_;
+    void *dec_ = nullptr;
+    WebmDemuxer demux_;
+    WebmPacket pkt_;
+    float pcm_[kMaxFrame];
+    float gain_ = 1.0f;
+    std::int64_t skip_ = 0, skip_consumed_ = 0, emitted_ = 0, first_pts_ns_ = -1;
+    int last_frame_ = 320; // samples in the last good packet; the PLC length when a TOC is unreadable
+    bool failed_ = false;
+};
+
+/* Decode a whole WebM/Opus file to mono float at `out_rate`. False if a
+   packet had to be concealed; `pcm` is complete and on time either way. */
+inline bool webm_decode_file(const std::string &path, std::vector<float> &pcm, int out_rate = 16000)
+{
+    WebmOpusDecoder dec(out_rate);
+    if (!dec.open(path))
+        return false;
+    pcm.clear();
+    while (dec.decode_packet(pcm))
+    {
+    }
+    return !dec.had_errors();
+}
@@ -0,0 +1,182 @@
+/*
+wer.h – word and character error rate with a bit-parallel edit distance
+
+Introduction
+============
+Every speed mode trades some accuracy, so a benchmark that only reports
+throughput cannot tell a win from a regression. The transcript of a run is
+aligned with a reference and scored as edits per reference token:
+
+    ```cpp
+    #include "wer.h"
+
+    const ErrorRate wer = word_error_rate(hypothesis, reference);
+    const ErrorRate cer = char_error_rate(hypothesis, reference);
+    std::printf("WER %.2f%% (%zu / %zu)\n", 100.0 * wer.rate(), wer.edits, wer.ref_tokens);
+    ```
+
+Both sides are normalised first: lower case, punctuation dropped (apostrophes
+kept), bracketed annotations such as "[MUSIC]" or a "[gap: …]" marker
+removed, whitespace collapsed. Segment lines "[00:00:01.000 --> …]  text" are
+reduced to their text, so whisper output can be scored as printed.
+
+The distance is Levenshtein over token ids, computed with Myers' bit-vector
+algorithm in Hyyrö's blocked form: the reference is cut into 64-token blocks
+and each hypothesis token updates a whole block with a dozen word operations,
+O(⌈m/64⌉·n) instead of O(m·n). The block updates are simd.h's `levenshtein`
+kernel, which advances 2–8 blocks per step on a vector path. A one-hour
+reference (~10 k words, ~55 k characters) against its hypothesis takes a few
+milliseconds for WER and well under a second for CER.
+*/
+
+#pragma once
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "simd.h"
+
+struct ErrorRate
+{
+    std::size_t edits = 0;      // substitutions + deletions + insertions
+    std::size_t ref_tokens = 0; // words or characters in the reference
+    std::size_t hyp_tokens = 0;
+
+    double rate() const { return ref_tokens ? double(edits) / double(ref_tokens) : (hyp_tokens ? 1.0 : 0.0); }
+
+    void add(const ErrorRate &o)
+    {
+        edits += o.edits;
+        ref_tokens += o.ref_tokens;
+        hyp_tokens += o.hyp_tokens;
+    }
+};
+
+/* Levenshtein distance between two token sequences (unit costs). */
+inline std::size_t edit_distance(const std::vector<std::uint32_t> &hyp, const std::vector<std::uint32_t> &ref)
+{
+    const std::size_t m = ref.size();
+    if (m == 0)
+        return hyp.size();
+    if (hyp.empty())
+        return m;
+
+    /* Reference tokens → dense ids; peq[id * blocks + b] has bit i set where ref[b*64+i] is that token */
+    constexpr std::size_t W = 64;
+    const std::size_t blocks = (m + W - 1) / W;
+    std::unordered_map<std::uint32_t, std::size_t> ids;
+    for (std::uint32_t t : ref)
+        ids.emplace(t, ids.size());
+    std::vector<std::uint64_t> peq((ids.size() + 1) * blocks, 0); // last row: tokens not in ref
+    for (std::size_t i = 0; i < m; ++i)
+        peq[ids[ref[i]] * blocks + i / W] |= std::uint64_t(1) << (i % W);
+    const std::size_t absent = ids.size();
+
+    /* Hypothesis tokens → peq rows; the blocks run through simd.h's levenshtein */
+    std::vector<std::uint32_t> col(hyp.size());
+    for (std::size_t j = 0; j < hyp.size(); ++j)
+    {
+        const auto found = ids.find(hyp[j]);
+        col[j] = std::uint32_t(found == ids.end() ? absent : found->second);
+    }
+    std::vector<std::uint64_t> pv(blocks, ~std::uint64_t(0)), mv(blocks, 0);
+    std::vector<std::int8_t> carry(hyp.size(), 1); // row 0 is D[0][j] = j: every column adds one
+    simd().levenshtein(peq.data(), blocks, col.data(), col.size(), pv.data(), mv.data(), carry.data());
+
+    std::size_t score = blocks * W; // D[rows][0] with the last block padded to 64 rows
+    for (std::int8_t h : carry)
+        score = std::size_t(std::ptrdiff_t(score) + h);
+
+    /* Walk back up through the padding rows of the last block to row m */
+    for (std::size_t i = blocks * W; i-- > m;)
+    {
+        const std::uint64_t bit = std::uint64_t(1) << (i % W);
+        if (pv[blocks - 1] & bit)
+            --score;
+        else if (mv[blocks - 1] & bit)
+            ++score;
+    }
+    return score;
+}
+
+namespace wer_detail
+{
+/* Segment lines lose their timestamps; bracketed annotations, punctuation and case go. */
+inline std::string normalize(const std::string &text)
+{
+    std::string out;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);)
+    {
+        std::size_t at = 0;
+        if (line.rfind('[', 0) == 0 && line.find(" --> ") != std::string::npos)
+            at = line.find(']') + 1;
+        int depth = 0;
+        for (; at < line.size(); ++at)
+        {
+            const unsigned char c = static_cast<unsigned char>(line[at]);
+            if (c == '[' || c == '(')
+                ++depth;
+            else if ((c == ']' || c == ')') && depth > 0)
+                --depth;
+            else if (depth > 0)
+                continue;
+            else if (c >= 0x80 || std::isalnum(c) || c == '\'')
+                out += char(c >= 0x80 ? c : std::tolower(c));
+            else if (!out.empty() && out.back() != ' ')
+                out += ' ';
+        }
+        if (!out.empty() && out.back() != ' ')
+            out += ' ';
+    }
+    while (!out.empty() && out.back() == ' ')
+        out.pop_back();
+    return out;
+}
+
+inline std::vector<std::uint32_t> words(const std::string &norm, std::unordered_map<std::string, std::uint32_t> &vocab)
+{
+    std::vector<std::uint32_t> out;
+    std::istringstream in(norm);
+    for (std::string w; in >> w;)
+        out.push_back(vocab.emplace(w, std::uint32_t(vocab.size())).first->second);
+    return out;
+}
+
+/* UTF-8 code points; a stray continuation byte counts as its own character. */
+inline std::vector<std::uint32_t> chars(const std::string &norm)
+{
+    std::vector<std::uint32_t> out;
+    for (std::size_t i = 0; i < norm.size();)
+    {
+        const unsigned char c = static_cast<unsigned char>(norm[i]);
+        const std::size_t len = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3 : (c >> 3) == 30 ? 4 : 1;
+        std::uint32_t cp = len == 1 ? c : c & (0x7F >> len);
+        for (std::size_t k = 1; k < len && i + k < norm.size(); ++k)
+            cp = (cp << 6) | (static_cast<unsigned char>(norm[i + k]) & 0x3F);
+        out.push_back(cp);
+        i += len;
+    }
+    return out;
+}
+} // namespace wer_detail
+
+inline ErrorRate word_error_rate(const std::string &hypothesis, const std::string &reference)
+{
+    std::unordered_map<std::string, std::uint32_t> vocab;
+    const auto ref = wer_detail::words(wer_detail::normalize(reference), vocab);
+    const auto hyp = wer_detail::words(wer_detail::normalize(hypothesis), vocab);
+    return {edit_distance(hyp, ref), ref.size(), hyp.size()};
+}
+
+inline ErrorRate char_error_rate(const std::string &hypothesis, const std::string &reference)
+{
+    const auto ref = wer_detail::chars(wer_detail::normalize(reference));
+    const auto hyp = wer_detail::chars(wer_detail::normalize(hypothesis));
+    return {edit_distance(hyp, ref), ref.size(), hyp.size()};
+}
@@ -27,6 +27,8 @@ const YTDLP_BIN = process.env.YTDLP_BIN || "yt-dlp"; // path to yt-dlp binary
 const TRANSCRIBE_BIN = process.env.TRANSCRIBE_BIN || "./src/transcribe";
 const WHISPER_MODEL_PATH =
   process.env.WHISPER_MODEL_PATH || "./whisper.cpp/models/ggml-base.en.bin";
+const REFINE_MODEL_PATH = process.env.REFINE_MODEL_PATH || ""; // full model; WHISPER_MODEL_PATH is then the fast pass
+const PREVIEW_BUDGET_SEC = process.env.PREVIEW_BUDGET_SEC || "60"; // wall-clock limit for --preview
 
 // ────────────────────────────────────────────────────────────────
 // 2. Caption retrieval (uses yt-dlp directly – no Invidious needed)
@@ -119,11 +121,144 @@ const getVideoId = (url: string) => {
 // 4. Whisper fallback (same as before)
 // ────────────────────────────────────────────────────────────────
 
-async function fetchOrTranscribe(audioUrl: string): Promise<string> {
+async function forEachLine(
+  stream: ReadableStream<Uint8Array>,
+  onLine: (line: string) => void
+): Promise<void> {
+  const decoder = new TextDecoder();
+  let pending = "";
+  for await (const bytes of stream) {
+    pending += decoder.decode(bytes, { stream: true });
+    const lines = pending.split("\n");
+    pending = lines.pop() ?? "";
+    lines.forEach(onLine);
+  }
+  if (pending) onLine(pending);
+}
+
+const clock = (sec: number) =>
+  sec < 0 ? "--:--" : new Date(sec * 1000).toISOString().slice(11, 19);
+
+// Progress events arrive as NDJSON on the transcriber's stderr
+// (--progress-fd 2); anything else there is passed through.
+function onTranscriberStderr(line: string): void {
+  let ev;
+  try {
+    ev = line.startsWith("{") ? JSON.parse(line) : null;
+  } catch {
+    ev = null;
+  }
+  if (!ev || typeof ev !== "object") {
+    if (line.trim()) console.error(line);
+    return;
+  }
+  const pct = ev.audio_total > 0 ? Math.floor((100 * ev.audio_done) / ev.audio_total) : 0;
+  process.stdout.write(
+    ev.type === "done"
+      ? `\rTranscribed ${clock(ev.audio_total)} of audio in ${clock(ev.elapsed)}${" ".repeat(20)}\n`
+      : `\rTranscribing ${pct}% (${ev.items_done}/${ev.items_total} chunks, ${ev.speed.toFixed(1)}x realtime, ETA ${clock(ev.eta)})  `
+  );
+}
+
+// Resource accounting: every transcriber run writes a --report JSON, kept as
+// a row in `jobs` – CPU time for billing, realtime factor and peak memory for
+// capacity planning.
+interface TranscribeJob {
+  db: Database;
+  contentId: string;
+}
+
+async function newReportPath(): Promise<string> {
+  await $`mkdir -p ./tmp`.quiet();
+  return path.join("./tmp", `transcribe-${process.pid}-${Date.now()}.json`);
+}
+
+async function recordJob(job: TranscribeJob | undefined, reportPath: string): Promise<void> {
+  const file = Bun.file(reportPath);
+  if (!(await file.exists())) return;
+  try {
+    if (job) {
+      const r = await file.json();
+      job.db.run(
+        `INSERT INTO jobs (content_id, host, model, mode, workers, threads, audio_sec, wall_sec,
+                           cpu_sec, peak_rss_mb, child_peak_rss_mb, chunks, gaps, report)
+         VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)`,
+        [
+          job.contentId,
+          r.host,
+          r.model,
+          r.mode,
+          r.workers,
+          r.threads,
+          r.audio_sec,
+          r.wall_sec,
+          r.cpu_sec,
+          r.memory?.peak_rss_mb ?? null,
+          r.memory?.children_peak_rss_mb ?? null,
+          r.chunks,
+          r.gaps,
+          JSON.stringify(r),
+        ]
+      );
+    }
+  } catch (err) {
+    console.error("Could not record transcription resources:", err);
+  } finally {
+    await file.delete();
+  }
+}
+
+// Progressive refinement: the transcriber streams fast-model segments as
+// NDJSON and later replaces each by ID with the full model's text.
+async function fetchRefined(audioUrl: string, job?: TranscribeJob): Promise<string> {
+  const report = await newReportPath();
+  const proc = Bun.spawn(
+    [TRANSCRIBE_BIN, audioUrl, WHISPER_MODEL_PATH, "--refine", REFINE_MODEL_PATH, "--report", report],
+    { stdout: "pipe", stderr: "inherit" }
+  );
+  const segments = new Map<string, { t0: number; text: string }>();
+  await forEachLine(proc.stdout, (line) => {
+    let ev;
+    try {
+      ev = JSON.parse(line);
+    } catch {
+      ev = null;
+    }
+    if (!ev || typeof ev !== "object") {
+      if (line.trim()) console.error(line); // not an event: pass it through like stderr
+      return;
+    }
+    if (ev.type === "segment" || ev.type === "replace") {
+      if (ev.type === "segment" && segments.size === 0)
+        console.log("Fast transcript streaming, refining in background...");
+      segments.set(ev.id, { t0: ev.t0, text: ev.text });
+    } else if (ev.type === "refined") {
+      console.log(`Refined ${ev.chunks}/${ev.total} chunks`);
+    }
+  });
+  const code = await proc.exited;
+  await recordJob(job, report);
+  if (code !== 0) throw new Error(`Transcriber exited with code ${code}`);
+  return [...segments.values()]
+    .sort((a, b) => a.t0 - b.t0)
+    .map((s) => s.text)
+    .join(" ");
+}
+
+async function fetchOrTranscribe(audioUrl: string, job?: TranscribeJob): Promise<string> {
   try {
-    const { stdout } =
-      await $`${TRANSCRIBE_BIN} ${audioUrl} ${WHISPER_MODEL_PATH}`;
-    return stdout.toString().trim();
+    if (REFINE_MODEL_PATH) return await fetchRefined(audioUrl, job);
+    const report = await newReportPath();
+    const proc = Bun.spawn(
+      [TRANSCRIBE_BIN, audioUrl, WHISPER_MODEL_PATH, "--progress-fd", "2", "--report", report],
+      { stdout: "pipe", stderr: "pipe" }
+    );
+    const stdout = new Response(proc.stdout).text();
+    await forEachLine(proc.stderr, onTranscriberStderr);
+    const code = await proc.exited;
+    await recordJob(job, report);
+    if (code !== 0) throw new Error(`Transcriber exited with code ${code}`);
+    return (await stdout).trim();
   } catch (err) {
     console.error("Transcription failed:", err);
     throw new Error(
@@ -132,6 +267,18 @@ async function fetchOrTranscribe(audioUrl: string): Promise<string> {
   }
 }
 
+// Sparse transcript of evenly sampled windows, produced within the budget.
+// Only the text between the transcriber's markers is returned.
+async function previewTranscript(audioUrl: string): Promise<string> {
+  const { stdout } =
+    await $`${TRANSCRIBE_BIN} ${audioUrl} ${WHISPER_MODEL_PATH} --preview ${PREVIEW_BUDGET_SEC}`;
+  const out = stdout.toString();
+  const start = out.indexOf("----- Transcription Start -----");
+  const end = out.lastIndexOf("----- Transcription End -----");
+  if (start < 0 || end < start) return out.trim();
+  return out.slice(start + "----- Transcription Start -----".length, end).trim();
+}
+
 // ────────────────────────────────────────────────────────────────
 // 5. LLM & embedding setup (using Gemini)
 // ────────────────────────────────────────────────────────────────
@@ -171,6 +318,26 @@ async function initDb(): Promise<Database> {
       created_at  DATETIME DEFAULT CURRENT_TIMESTAMP,
       FOREIGN KEY (content_id) REFERENCES content(content_id)
     );
+
+    -- one row per whisper run, kept when content is deleted (billing history)
+    CREATE TABLE IF NOT EXISTS jobs (
+      id                INTEGER PRIMARY KEY AUTOINCREMENT,
+      content_id        TEXT NOT NULL,
+      host              TEXT,
+      model             TEXT,
+      mode              TEXT,
+      workers           INTEGER,
+      threads           INTEGER,
+      audio_sec         REAL,
+      wall_sec          REAL,
+      cpu_sec           REAL,
+      peak_rss_mb       REAL,
+      child_peak_rss_mb REAL,
+      chunks            INTEGER,
+      gaps              INTEGER,
+      report            TEXT,
+      created_at        DATETIME DEFAULT CURRENT_TIMESTAMP
+    );
   `);
   /* turn on incremental auto-vacuum (first run triggers a VACUUM) */
   // db.exec(`
@@ -233,7 +400,7 @@ async function getOrCreateTranscript(
     let transcript = await fetchCaptionsWithYtDlp(url, videoId);
 
     // 2️⃣ Fallback to Whisper transcription
-    if (!transcript) transcript = await fetchOrTranscribe(url);
+    if (!transcript) transcript = await fetchOrTranscribe(url, { db, contentId: videoId });
 
     // Cleanup tmp VTT file
     await cleanupTmpFiles(videoId);
@@ -346,7 +513,7 @@ async function getOrCreateTranscript(
   };
 
   let transcript = await transcriptFromRSS(info.podcastId, info.episodeId);
-  if (!transcript) transcript = await fetchOrTranscribe(info.audioUrl);
+  if (!transcript) transcript = await fetchOrTranscribe(info.audioUrl, { db, contentId });
 
   const summary = await summarize(transcript);
   db.run(
@@ -659,6 +826,42 @@ async function exportQA(
   }
 }
 
+function printJobsReport(db: Database): void {
+  const rows = db
+    .query(
+      `SELECT model, host, COUNT(*) AS jobs, SUM(audio_sec) AS audio_sec, SUM(wall_sec) AS wall_sec,
+              SUM(cpu_sec) AS cpu_sec, MAX(peak_rss_mb) AS peak_rss_mb,
+              MAX(child_peak_rss_mb) AS child_peak_rss_mb
+       FROM jobs WHERE audio_sec > 0 GROUP BY model, host ORDER BY model, host`
+    )
+    .all() as {
+      model: string;
+      host: string;
+      jobs: number;
+      audio_sec: number;
+      wall_sec: number;
+      cpu_sec: number;
+      peak_rss_mb: number | null;
+      child_peak_rss_mb: number | null;
+    }[];
+  if (rows.length === 0) {
+    console.log("No transcription jobs recorded yet.");
+    return;
+  }
+  console.table(
+    rows.map((r) => ({
+      model: path.basename(r.model ?? ""),
+      host: r.host,
+      jobs: r.jobs,
+      "audio h": +(r.audio_sec / 3600).toFixed(2),
+      "wall / audio": +(r.wall_sec / r.audio_sec).toFixed(3),
+      "CPU s / audio s": +(r.cpu_sec / r.audio_sec).toFixed(3),
+      "peak RSS MB": r.peak_rss_mb,
+      "whisper RSS MB": r.child_peak_rss_mb,
+    }))
+  );
+}
+
 // ────────────────────────────────────────────────────────────────
 // 10. CLI interaction loop
 // ────────────────────────────────────────────────────────────────
@@ -674,6 +877,8 @@ async function main() {
       url: { type: "string", short: "u" },
       find: { type: "string", short: "f" },
       delete: { type: "string", short: "d" },
+      preview: { type: "string", short: "p" },
+      "jobs-report": { type: "boolean" },
       help: { type: "boolean", short: "h" },
     },
     allowPositionals: true,
@@ -687,6 +892,10 @@ Options:
   -u, --url <url>      Process a YouTube or podcast URL directly (non-interactive)
   -f, --find <text>    Find a session by fuzzy matching description
   -d, --delete <url>   Delete a video/podcast and its Q&A from the database
+  -p, --preview <url>  Quick gist of a YouTube video from sampled windows
+                       (not stored; budget via PREVIEW_BUDGET_SEC, default 60)
+  --jobs-report        Realtime factor, CPU time and peak memory of past
+                       transcriptions, by model and host
   -h, --help           Show this help message
 
 Interactive mode (default):
@@ -738,6 +947,12 @@ Interactive mode (default):
       return;
     }
 
+    // Non-interactive: --jobs-report flag
+    if (values["jobs-report"]) {
+      printJobsReport(db);
+      return;
+    }
+
     // Non-interactive: --url flag
     if (values.url) {
       data = await getOrCreateTranscript(db, values.url.trim());
@@ -747,6 +962,19 @@ Interactive mode (default):
       return;
     }
 
+    // Non-interactive: --preview flag (sampled transcript, nothing stored)
+    if (values.preview) {
+      const url = values.preview.trim();
+      const videoId = getVideoId(url);
+      const [title, transcript] = await Promise.all([
+        videoId ? fetchYoutubeTitleOEmbed(videoId).catch(() => url) : url,
+        previewTranscript(url),
+      ]);
+      console.log(`\nPreview: ${title}\n\n${transcript}\n`);
+      console.log(`\nSummary (preview):\n${await summarize(transcript)}\n`);
+      return;
+    }
+
     // Non-interactive: --find flag (fuzzy search using embeddings)
     if (values.find) {
       console.log(`Searching for: "${values.find}"...`);